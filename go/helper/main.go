@@ -520,6 +520,65 @@ func GHBuildEnvIsFileIncluded(cpath *C.char) bool {
 	return match
 }
 
+// Same as GHBuildEnvIsFileIncluded, but for every .go file in a directory
+// at once. Returns the names of the included files, separated by newlines.
+//
+//export GHBuildEnvListIncludedFiles
+func GHBuildEnvListIncludedFiles(cdir *C.char, ok *bool) *C.char {
+	if !buildenv.Ok {
+		*ok = false
+		return nil
+	}
+
+	dir := C.GoString(cdir)
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		*ok = false
+		return nil
+	}
+
+	names := []string{}
+	for _, ent := range entries {
+		if ent.IsDir() || !strings.HasSuffix(ent.Name(), ".go") {
+			continue
+		}
+		match, err := buildenv.Context.MatchFile(dir, ent.Name())
+		if err != nil {
+			log.Printf("%v", err)
+			continue
+		}
+		if match {
+			names = append(names, ent.Name())
+		}
+	}
+
+	*ok = true
+	return C.CString(strings.Join(names, "\n"))
+}
+
+// Everything about the build context that decides which files are
+// included, so callers can tell when cached results are stale.
+//
+//export GHBuildEnvGetTags
+func GHBuildEnvGetTags() *C.char {
+	if !buildenv.Ok {
+		return nil
+	}
+
+	ctx := &buildenv.Context
+	s := fmt.Sprintf(
+		"%s/%s cgo=%v compiler=%s tags=%s release=%s tool=%s",
+		ctx.GOOS,
+		ctx.GOARCH,
+		ctx.CgoEnabled,
+		ctx.Compiler,
+		strings.Join(ctx.BuildTags, ","),
+		strings.Join(ctx.ReleaseTags, ","),
+		strings.Join(ctx.ToolTags, ","),
+	)
+	return C.CString(s)
+}
+
 //export GHBuildEnvGoVersionSupported
 func GHBuildEnvGoVersionSupported() bool {
 	if !buildenv.Ok {
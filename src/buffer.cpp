@@ -1,6 +1,7 @@
 #include "buffer.hpp"
 #include "common.hpp"
-#include "world.hpp"
+#include "core.hpp"
+#include "settings.hpp"
 #include "unicode.hpp"
 #include "diff.hpp"
 #include "defer.hpp"
@@ -35,7 +36,7 @@ int Bytecounts_Tree::internal_offset_to_line(Treap *t, int limit, int *rem) {
 }
 
 void Bytecounts_Tree::insert(int idx, int val) {
-    auto node = world.treap_fridge.alloc();
+    auto node = core.treap_fridge.alloc();
     node->val = val;
     node->size = 1;
     node->sum = val;
@@ -913,87 +914,14 @@ void Buffer::update_tree() {
 void Buffer::apply_edit_to_trees(cur2 start, cur2 oldend, cur2 newend) {
     apply_edit_avl_tree(mark_tree, start, oldend, newend);
 
-    do {
-        if (!search_tree) break;
+    if (search_tree) {
         apply_edit_avl_tree(search_tree, start, oldend, newend);
-
-        auto &wnd = world.wnd_local_search;
-        if (!wnd.query[0]) break;
-
-        cur2 lookbehind = start;
-        cur2 lookahead = newend;
-        if (wnd.use_regex) {
-            lookbehind.x = 0;
-            lookbehind.y = relu_sub(lookbehind.y, 200);
-            lookahead.x = 0;
-            lookahead.y = min(lines.len-1, lookahead.y + 200 + 1);
-        } else {
-            int newlines = 0;
-            for (auto p = wnd.query; *p; p++)
-                if (*p == '\n')
-                    newlines++;
-            lookbehind.x = 0;
-            lookbehind.y = relu_sub(lookahead.y, newlines);
-            lookahead.x = 0;
-            lookahead.y = min(lines.len-1, lookahead.y + newlines + 1);
-        }
-
-        // clear out everything between lookbehind and lookahead
-        auto node = search_tree->find_node(search_tree->root, lookbehind);
-        if (node && node->pos < lookbehind)
-            node = search_tree->successor(node);
-        while (node && node->pos < lookahead) {
-            auto next = search_tree->successor(node);
-            cur2 pos = next ? next->pos : NULL_CUR;
-
-            search_tree->delete_node(node->pos);
-
-            if (pos == NULL_CUR) break;
-            node = search_tree->find_node(search_tree->root, pos);
-        }
-
-        Search_Session sess; ptr0(&sess);
-        sess.case_sensitive = wnd.case_sensitive;
-        sess.literal = !wnd.use_regex;
-        sess.query = wnd.query;
-        sess.qlen = strlen(wnd.query);
-        if (!sess.init()) return;
-
-        int len = 0;
-        auto chars = get_text(lookbehind, lookahead, &len);
-        auto matches = new_list(Search_Match);
-        sess.search(chars, len, matches, -1);
-
-        auto starting_offset = cur_to_offset(lookbehind);
-
-        For (matches) {
-            auto start = offset_to_cur(it.start + starting_offset);
-            auto end = offset_to_cur(it.end + starting_offset);
-
-            auto convert_groups = [&](List<int> *arr) -> List<cur2> * {
-                if (!arr) return NULL;
-
-                List<cur2> *ret;
-                {
-                    SCOPED_MEM(&search_mem);
-                    ret = new_list(cur2);
-                }
-                For (arr) ret->append(offset_to_cur(it + starting_offset));
-                return ret;
-            };
-
-            auto node = search_tree->insert_node(start);
-            node->search_result.end = end;
-            node->search_result.group_starts = convert_groups(it.group_starts);
-            node->search_result.group_ends = convert_groups(it.group_ends);
-
-            search_tree->check_tree_integrity();
-        }
-    } while (0);
+        update_search_results_after_edit(this, start, newend);
+    }
 }
 
 Change* Buffer::hist_alloc() {
-    auto ret = world.change_fridge.alloc();
+    auto ret = core.change_fridge.alloc();
     ret->old_text.init(LIST_CHUNK, CHUNK0);
     ret->new_text.init(LIST_CHUNK, CHUNK0);
     return ret;
@@ -1006,7 +934,7 @@ void Buffer::hist_free(int i) {
 
         change->old_text.cleanup();
         change->new_text.cleanup();
-        world.change_fridge.free(change);
+        core.change_fridge.free(change);
 
         change = next;
     }
@@ -1372,7 +1300,7 @@ void Avl_Tree::cleanup() {
             }
         }
 
-        world.avl_node_fridge.free(node);
+        core.avl_node_fridge.free(node);
     };
 
     helper(root);
@@ -1419,7 +1347,7 @@ Avl_Node *Avl_Tree::insert_node(cur2 pos) {
     if (node && node->pos == pos)
         return node;
 
-    node = world.avl_node_fridge.alloc();
+    node = core.avl_node_fridge.alloc();
     node->pos = pos;
     root = internal_insert_node(root, pos, node);
 
@@ -1429,10 +1357,10 @@ Avl_Node *Avl_Tree::insert_node(cur2 pos) {
 }
 
 Mark *Buffer::insert_mark(Mark_Type type, cur2 pos) {
-    world.global_mark_tree_lock.enter();
-    defer { world.global_mark_tree_lock.leave(); };
+    core.global_mark_tree_lock.enter();
+    defer { core.global_mark_tree_lock.leave(); };
 
-    auto mark = world.mark_fridge.alloc();
+    auto mark = core.mark_fridge.alloc();
     mark->type = type;
     mark->buf = this;
     mark->valid = true;
@@ -1554,8 +1482,8 @@ Avl_Node *Avl_Tree::internal_insert_node(Avl_Node *root, cur2 pos, Avl_Node *nod
 }
 
 void Buffer::internal_delete_mark(Mark *mark) {
-    world.global_mark_tree_lock.enter();
-    defer { world.global_mark_tree_lock.leave(); };
+    core.global_mark_tree_lock.enter();
+    defer { core.global_mark_tree_lock.leave(); };
 
     auto node = mark->node;
     bool found = false;
@@ -1622,7 +1550,7 @@ Avl_Node *Avl_Tree::internal_delete_node(Avl_Node *root, cur2 pos) {
                 ret->isleft = root->isleft;
             }
 
-            world.avl_node_fridge.free(root);
+            core.avl_node_fridge.free(root);
             return ret;
         }
 
@@ -1669,8 +1597,8 @@ Avl_Node *Avl_Tree::internal_delete_node(Avl_Node *root, cur2 pos) {
 }
 
 void Buffer::apply_edit_avl_tree(Avl_Tree *tree, cur2 start, cur2 old_end, cur2 new_end) {
-    world.global_mark_tree_lock.enter();
-    defer { world.global_mark_tree_lock.leave(); };
+    core.global_mark_tree_lock.enter();
+    defer { core.global_mark_tree_lock.leave(); };
 
     if (start == old_end && old_end == new_end)
         return;
@@ -1847,7 +1775,7 @@ void Mark::cleanup() {
     // root cause. Here we just zero out the mark to encourage errors to
     // surface right away.
     ptr0(this);
-    world.mark_fridge.free(this);
+    core.mark_fridge.free(this);
 }
 
 bool is_mark_valid(Mark *mark) {
@@ -1920,14 +1848,14 @@ void treap_free(Treap *t) {
 
     treap_free(t->left);
     treap_free(t->right);
-    world.treap_fridge.free(t);
+    core.treap_fridge.free(t);
 }
 
 Treap *treap_delete(Treap *t, int idx, int add) {
     int curr = add + treap_node_size(t->left);
     if (idx == curr) {
         auto ret = treap_merge(t->left, t->right);
-        world.treap_fridge.free(t);
+        core.treap_fridge.free(t);
         return ret;
     }
 
@@ -7,5 +7,4 @@
 
 #include "tree-sitter/lib/src/lib.c"
 #include "cwalk.c"
-#include "glew.c"
 #include "mtwist.c"
@@ -1,7 +1,7 @@
 #include "defer.hpp"
 #include "common.hpp"
 #include "os.hpp"
-#include "world.hpp"
+#include "core.hpp"
 #include "utils.hpp"
 
 #include <stdio.h>
@@ -16,11 +16,66 @@ List<ccstr> *copy_string_list(List<ccstr> *arr) {
     return new_arr;
 }
 
+// Only copies this node; children still point at the original lists.
 Call_Hier_Node* Call_Hier_Node::copy() {
     auto ret = clone(this);
     ret->decl = copy_object(decl);
     ret->ref = copy_object(ref);
-    ret->children = copy_list(children);
+    ret->callers_key = cp_strdup(callers_key);
+    return ret;
+}
+
+// Keeps the lists shared the way they were, instead of copying a list each
+// time it's reached (which, with cycles, would never finish).
+List<Call_Hier_Node> *copy_call_hierarchy(List<Call_Hier_Node> *nodes) {
+    auto copies = new_table(List<Call_Hier_Node>*);
+    auto queue = new_list(List<Call_Hier_Node>*);
+
+    auto get_copy = [&](List<Call_Hier_Node> *list) -> List<Call_Hier_Node>* {
+        if (!list) return NULL;
+
+        auto key = cp_sprintf("%p", list);
+
+        bool found = false;
+        auto ret = copies->get(key, &found);
+        if (!found) {
+            ret = new_list(Call_Hier_Node, max(list->len, 1));
+            copies->set(key, ret);
+            queue->append(list);
+        }
+        return ret;
+    };
+
+    auto ret = get_copy(nodes);
+
+    for (int i = 0; i < queue->len; i++) {
+        auto list = queue->at(i);
+        auto copy = get_copy(list);
+
+        For (list) {
+            auto node = it.copy();
+            node->children = get_copy(it.children);
+            copy->append(node);
+        }
+    }
+
+    return ret;
+}
+
+Caller_Map *Caller_Map::copy() {
+    auto ret = new_object(Caller_Map);
+    ret->table.init();
+    ret->incomplete = incomplete;
+
+    For (table.entries()) {
+        auto edges = new_list(Caller_Edge, max(it->value->len, 1));
+        For (it->value) {
+            auto edge = edges->append(&it);
+            edge->import_path = cp_strdup(it.import_path);
+            edge->filename = cp_strdup(it.filename);
+        }
+        ret->table.set(cp_strdup(it->name), edges);
+    }
     return ret;
 }
 
@@ -95,9 +150,9 @@ AC_Result *AC_Result::copy() {
 Godecl *Godecl::copy() {
     auto ret = clone(this);
 
-    ret->name = cp_strdup(name);
+    ret->name = copy_go_string(name);
     if (type == GODECL_IMPORT) {
-        ret->import_path = cp_strdup(import_path);
+        ret->import_path = copy_go_string(import_path);
     } else {
         ret->gotype = copy_object(gotype);
         switch (type) {
@@ -131,9 +186,9 @@ Go_Reference *Go_Reference::copy() {
     auto ret = clone(this);
     if (is_sel) {
         ret->x = copy_object(x);
-        ret->sel = cp_strdup(sel);
+        ret->sel = copy_go_string(sel);
     } else {
-        ret->name = cp_strdup(name);
+        ret->name = copy_go_string(name);
     }
     return ret;
 }
@@ -168,11 +223,11 @@ Gotype *Gotype::copy() {
         ret->constraint_underlying_base = copy_object(constraint_underlying_base);
         break;
     case GOTYPE_ID:
-        ret->id_name = cp_strdup(id_name);
+        ret->id_name = copy_go_string(id_name);
         break;
     case GOTYPE_SEL:
-        ret->sel_name = cp_strdup(sel_name);
-        ret->sel_sel = cp_strdup(sel_sel);
+        ret->sel_name = copy_go_string(sel_name);
+        ret->sel_sel = copy_go_string(sel_sel);
         break;
     case GOTYPE_MAP:
         ret->map_key = copy_object(map_key);
@@ -226,11 +281,11 @@ Gotype *Gotype::copy() {
         ret->lazy_arrow_base = copy_object(lazy_arrow_base);
         break;
     case GOTYPE_LAZY_ID:
-        ret->lazy_id_name = cp_strdup(lazy_id_name);
+        ret->lazy_id_name = copy_go_string(lazy_id_name);
         break;
     case GOTYPE_LAZY_SEL:
         ret->lazy_sel_base = copy_object(lazy_sel_base);
-        ret->lazy_sel_sel = cp_strdup(lazy_sel_sel);
+        ret->lazy_sel_sel = copy_go_string(lazy_sel_sel);
         break;
     case GOTYPE_LAZY_ONE_OF_MULTI:
         ret->lazy_one_of_multi_base = copy_object(lazy_one_of_multi_base);
@@ -246,11 +301,23 @@ Go_Package *Go_Package::copy() {
     auto ret = clone(this);
 
     auto do_copy = [&]() {
-        ret->import_path = cp_strdup(import_path);
-        ret->package_name = cp_strdup(package_name);
+        ret->import_path = copy_go_string(import_path);
+        ret->package_name = copy_go_string(package_name);
         ret->files = copy_list(files);
+        ret->reference_names = copy_list(reference_names);
+        ret->method_sets = copy_list(method_sets);
+        ret->method_postings = copy_list(method_postings);
+        ret->call_edges = copy_list(call_edges);
+        ret->symbols = copy_list(symbols);
+        ret->decl_table = copy_list(decl_table);
     };
 
+    ret->reference_names_pool = NULL;
+    ret->method_sets_pool = NULL;
+    ret->call_edges_pool = NULL;
+    ret->symbols_pool = NULL;
+    ret->decl_table_pool = NULL;
+
     if (use_pool) {
         ret->pool = new_object(Pool);
         ret->pool->init("go_package");
@@ -265,12 +332,59 @@ Go_Package *Go_Package::copy() {
 
 Go_Import *Go_Import::copy() {
     auto ret = clone(this);
-    ret->package_name = cp_strdup(package_name);
-    ret->import_path = cp_strdup(import_path);
+    ret->package_name = copy_go_string(package_name);
+    ret->import_path = copy_go_string(import_path);
     ret->decl = copy_object(decl);
     return ret;
 }
 
+Go_Reference_Posting *Go_Reference_Posting::copy() {
+    auto ret = clone(this);
+    ret->name = go_intern(name);
+    return ret;
+}
+
+Go_Reference_Name *Go_Reference_Name::copy() {
+    auto ret = clone(this);
+    ret->name = go_intern(name);
+    return ret;
+}
+
+Go_Method_Set *Go_Method_Set::copy() {
+    auto ret = clone(this);
+    ret->type_name = go_intern(type_name);
+    return ret;
+}
+
+Go_Method_Posting *Go_Method_Posting::copy() {
+    return clone(this);
+}
+
+Go_Decl_Slot *Go_Decl_Slot::copy() {
+    auto ret = clone(this);
+    ret->name = go_intern(name);
+    return ret;
+}
+
+Go_Symbol_Entry *Go_Symbol_Entry::copy() {
+    auto ret = clone(this);
+    ret->name = go_intern(name);
+    ret->filename = go_intern(filename);
+    ret->import_path = go_intern(import_path);
+    ret->package_name = go_intern(package_name);
+    ret->package_path = go_intern(package_path);
+    return ret;
+}
+
+Go_Call_Edge *Go_Call_Edge::copy() {
+    auto ret = clone(this);
+    ret->filename = go_intern(filename);
+    ret->callee_import_path = go_intern(callee_import_path);
+    ret->callee_recv = go_intern(callee_recv);
+    ret->callee_name = go_intern(callee_name);
+    return ret;
+}
+
 Go_Scope_Op *Go_Scope_Op::copy() {
     auto ret = clone(this);
     if (type == GSOP_DECL)
@@ -287,6 +401,7 @@ Go_File *Go_File::copy() {
         ret->decls = copy_list(decls);
         ret->imports = copy_list(imports);
         ret->references = copy_list(references);
+        ret->reference_postings = copy_list(reference_postings);
     };
 
     if (use_pool) {
@@ -0,0 +1,48 @@
+#include "core.hpp"
+#include "defer.hpp"
+
+int gargc = 0;
+char **gargv = NULL;
+
+void World_Core::init_core() {
+    workspace_mem_1.init("workspace_mem_1");
+    workspace_mem_2.init("workspace_mem_2");
+
+    init_treesitter_go_trie();
+
+    global_mark_tree_lock.init();
+
+    mark_fridge.init(512);
+    avl_node_fridge.init(512);
+    change_fridge.init(512);
+    treap_fridge.init(512);
+
+    chunk0_fridge.init(512);
+    chunk1_fridge.init(256);
+    chunk2_fridge.init(128);
+    chunk3_fridge.init(64);
+    chunk4_fridge.init(32);
+    chunk5_fridge.init(16);
+    chunk6_fridge.init(8);
+    chunk7_fridge.init(8);
+
+    {
+        auto tmp = GHGetConfigDir();
+        if (!tmp) cp_panic("couldn't get config dir");
+        defer { GHFree(tmp); };
+
+        cp_strcpy_fixed(configdir, tmp);
+    }
+
+    {
+        auto go_binary_path = GHGetGoBinaryPath();
+        if (!go_binary_path) {
+            cp_exit("Unable to find a go binary.\n\nUsually, CodePerfect searches for go by running `which go` inside `bash`, but we did that and couldn't find anything.\n\nPlease visit docs.codeperfect95.com to see how to manually tell CodePerfect where go is.");
+        }
+
+        defer { GHFree(go_binary_path); };
+        cp_strcpy_fixed(this->go_binary_path, go_binary_path);
+    }
+
+    message_queue.init();
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "common.hpp"
+#include "mem.hpp"
+#include "utils.hpp"
+#include "os.hpp"
+#include "buffer.hpp"
+#include "go.hpp"
+
+// The part of `world` that doesn't need a window: allocators, the indexer and
+// the folder it's indexing. buffer.cpp, mem.cpp, os.cpp and go.cpp only go
+// through `core`, so they build without GL or the UI, which is what the
+// headless index_bench target does (see index_bench.cpp).
+
+struct Editor;
+
+enum Main_Thread_Message_Type {
+    MTM_GOTO_FILEPOS,
+    /**/
+    MTM_FILETREE_DELETE,
+    MTM_FILETREE_CREATE,
+    /**/
+    MTM_TELL_USER,
+    /**/
+    MTM_RELOAD_EDITOR,
+    MTM_EXIT,
+    MTM_FOCUS_APP_DEBUGGER,
+    /**/
+    MTM_WRITE_LAST_FOLDER,
+    /**/
+    // for tests
+    MTM_TEST_MOVE_CURSOR,
+    MTM_RESET_AFTER_DEFOCUS,
+};
+
+struct Main_Thread_Message {
+    Main_Thread_Message_Type type;
+
+    union {
+        int focus_app_debugger_pid;
+        u32 reload_editor_id;
+        struct {
+            ccstr goto_file;
+            cur2 goto_pos;
+        };
+        struct {
+            ccstr tell_user_text;
+            ccstr tell_user_title;
+        };
+        struct {
+            ccstr exit_message;
+            int exit_code;
+        };
+        ccstr debugger_stdout_line;
+        cur2 test_move_cursor;
+        List<Mark*> *search_marks;
+    };
+};
+
+#define INDEX_LOG_CAP 64 // 512
+#define INDEX_LOG_MAXLEN 256
+
+struct World_Core {
+    Pool workspace_mem_1;
+    Pool workspace_mem_2;
+    bool which_workspace_mem;
+    Go_Workspace *workspace;
+
+    Fridge<Mark> mark_fridge;
+    Fridge<Avl_Node> avl_node_fridge;
+    Fridge<Treap> treap_fridge;
+    Fridge<Change> change_fridge;
+    Fridge<Chunk0> chunk0_fridge;
+    Fridge<Chunk1> chunk1_fridge;
+    Fridge<Chunk2> chunk2_fridge;
+    Fridge<Chunk3> chunk3_fridge;
+    Fridge<Chunk4> chunk4_fridge;
+    Fridge<Chunk5> chunk5_fridge;
+    Fridge<Chunk6> chunk6_fridge;
+    Fridge<Chunk7> chunk7_fridge;
+
+    Lock global_mark_tree_lock;
+
+    char configdir[MAX_PATH];
+    char go_binary_path[MAX_PATH];
+    char current_path[MAX_PATH];
+
+    Message_Queue<Main_Thread_Message> message_queue;
+
+    Go_Indexer indexer;
+
+    // ring buffer, shown in the Index Log window
+    struct {
+        char buf[INDEX_LOG_CAP][INDEX_LOG_MAXLEN];
+        int start;
+        int len;
+        bool cmd_scroll_to_end;
+    } index_log;
+
+    // nobody's looking at the Index Log window, so index_print() prints
+    bool print_index_log;
+
+    // Doesn't touch current_path, or init the indexer, since that needs
+    // current_path.
+    void init_core();
+};
+
+// In the IDE this is `world`; index_bench.cpp has its own.
+extern World_Core &core;
+
+extern int gargc;
+extern char **gargv;
+
+// The UI implements these; the headless index_bench build has no editors.
+List<Editor*> *get_all_editors();
+Editor* get_current_editor();
+Editor* find_editor_by_filepath(ccstr filepath); // this is fairly expensive -- it does a stat lookup, not just string based comparison
+void update_search_results_after_edit(Buffer *buf, cur2 start, cur2 newend);
@@ -1271,10 +1271,13 @@ void Pane::set_current_editor(u32 idx) {
 }
 
 Editor *Pane::focus_editor_by_index(u32 idx, cur2 pos, bool pos_in_byte_format) {
-    if (current_editor != idx)
+    bool switching = (current_editor != idx);
+    if (switching)
         reset_everything_when_switching_editors(get_current_editor());
 
     set_current_editor(idx);
+    if (switching)
+        world.indexer.editors_changed();
 
     auto &editor = editors[idx];
 
@@ -1741,10 +1744,6 @@ void Editor::trigger_autocomplete(bool triggered_by_dot, bool triggered_by_typin
     return;
 }
 
-bool is_goident_empty(ccstr name) {
-    return (!name || name[0] == '\0' || streq(name, "_"));
-}
-
 void Editor::trigger_parameter_hint() {
     if (!is_modifiable()) return;
     if (lang != LANG_GO) return;
@@ -6501,6 +6500,85 @@ void Editor::trigger_file_search(int limit_start, int limit_end) {
     }
 }
 
+// Buffer::apply_edit_to_trees() calls this after moving the buffer's search
+// results, to search again around the edit.
+void update_search_results_after_edit(Buffer *buf, cur2 start, cur2 newend) {
+    auto &wnd = world.wnd_local_search;
+    if (!wnd.query[0]) return;
+
+    auto search_tree = buf->search_tree;
+
+    cur2 lookbehind = start;
+    cur2 lookahead = newend;
+    if (wnd.use_regex) {
+        lookbehind.x = 0;
+        lookbehind.y = relu_sub(lookbehind.y, 200);
+        lookahead.x = 0;
+        lookahead.y = min(buf->lines.len-1, lookahead.y + 200 + 1);
+    } else {
+        int newlines = 0;
+        for (auto p = wnd.query; *p; p++)
+            if (*p == '\n')
+                newlines++;
+        lookbehind.x = 0;
+        lookbehind.y = relu_sub(lookahead.y, newlines);
+        lookahead.x = 0;
+        lookahead.y = min(buf->lines.len-1, lookahead.y + newlines + 1);
+    }
+
+    // clear out everything between lookbehind and lookahead
+    auto node = search_tree->find_node(search_tree->root, lookbehind);
+    if (node && node->pos < lookbehind)
+        node = search_tree->successor(node);
+    while (node && node->pos < lookahead) {
+        auto next = search_tree->successor(node);
+        cur2 pos = next ? next->pos : NULL_CUR;
+
+        search_tree->delete_node(node->pos);
+
+        if (pos == NULL_CUR) break;
+        node = search_tree->find_node(search_tree->root, pos);
+    }
+
+    Search_Session sess; ptr0(&sess);
+    sess.case_sensitive = wnd.case_sensitive;
+    sess.literal = !wnd.use_regex;
+    sess.query = wnd.query;
+    sess.qlen = strlen(wnd.query);
+    if (!sess.init()) return;
+
+    int len = 0;
+    auto chars = buf->get_text(lookbehind, lookahead, &len);
+    auto matches = new_list(Search_Match);
+    sess.search(chars, len, matches, -1);
+
+    auto starting_offset = buf->cur_to_offset(lookbehind);
+
+    For (matches) {
+        auto start = buf->offset_to_cur(it.start + starting_offset);
+        auto end = buf->offset_to_cur(it.end + starting_offset);
+
+        auto convert_groups = [&](List<int> *arr) -> List<cur2> * {
+            if (!arr) return NULL;
+
+            List<cur2> *ret;
+            {
+                SCOPED_MEM(&buf->search_mem);
+                ret = new_list(cur2);
+            }
+            For (arr) ret->append(buf->offset_to_cur(it + starting_offset));
+            return ret;
+        };
+
+        auto node = search_tree->insert_node(start);
+        node->search_result.end = end;
+        node->search_result.group_starts = convert_groups(it.group_starts);
+        node->search_result.group_ends = convert_groups(it.group_ends);
+
+        search_tree->check_tree_integrity();
+    }
+}
+
 int Editor::move_file_search_result(bool forward, int count) {
     auto tree = buf->search_tree;
 
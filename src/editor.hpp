@@ -471,8 +471,6 @@ struct Pane {
 
 bool check_file_dimensions(ccstr path);
 
-bool is_goident_empty(ccstr name);
-
 enum Gr_Type {
     GR_SPACE,
     GR_IDENT,
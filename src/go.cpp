@@ -1,6 +1,6 @@
 #include "go.hpp"
 #include "utils.hpp"
-#include "world.hpp"
+#include "core.hpp"
 #include "mem.hpp"
 #include "os.hpp"
 #include "set.hpp"
@@ -9,13 +9,14 @@
 #include <stdlib.h>
 #include "defer.hpp"
 #include "unicode.hpp"
-#include "enums.hpp"
 #include "copy.hpp"
+#include "settings.hpp"
 #include <dlfcn.h>
 
 #define GO_DEBUG 0
 
 #if GO_DEBUG
+#include "enums.hpp" // for indexer_status_str(), but it pulls in the UI headers
 #define go_print(fmt, ...) print("[go] " fmt, ##__VA_ARGS__)
 #else
 #define go_print(fmt, ...)
@@ -30,31 +31,154 @@ void index_print(ccstr fmt, ...) {
     auto msg = cp_vsprintf(fmt, args);
 
     {
-        auto &wnd = world.wnd_index_log;
+        auto &index_log = core.index_log;
 
         int index = -1;
-        if (wnd.len < INDEX_LOG_CAP) {
-            index = wnd.len++;
+        if (index_log.len < INDEX_LOG_CAP) {
+            index = index_log.len++;
         } else {
-            index = wnd.start;
-            wnd.start = (wnd.start + 1) % INDEX_LOG_CAP;
+            index = index_log.start;
+            index_log.start = (index_log.start + 1) % INDEX_LOG_CAP;
         }
 
-        char *dest = wnd.buf[index];
+        char *dest = index_log.buf[index];
         if (strlen(msg) > INDEX_LOG_MAXLEN - 1)
             msg = cp_sprintf("%.*s...", INDEX_LOG_MAXLEN - 1 - 3, msg);
         cp_strcpy(dest, INDEX_LOG_MAXLEN, msg);
 
-        wnd.cmd_scroll_to_end = true;
+        index_log.cmd_scroll_to_end = true;
     }
 
-    go_print("%s", msg);
+    if (core.print_index_log)
+        print("%s", msg);
+    else
+        go_print("%s", msg);
+}
+
+void Go_Atom_Table::init() {
+    ptr0(this);
+
+    for (int i = 0; i < GO_ATOM_SHARDS; i++) {
+        auto &shard = shards[i];
+        shard.lock.init();
+        shard.mem.init("atoms");
+
+        SCOPED_MEM(&shard.mem);
+        shard.lookup.init();
+    }
+
+    pages_lock.init();
+    count = 1;
+}
+
+void Go_Atom_Table::cleanup() {
+    for (int i = 0; i < GO_ATOM_SHARDS; i++) {
+        auto &shard = shards[i];
+        shard.lookup.cleanup();
+        shard.mem.cleanup();
+        shard.lock.cleanup();
+    }
+
+    for (int i = 0; i < GO_ATOM_MAX_PAGES && pages[i]; i++)
+        cp_free(pages[i]);
+
+    pages_lock.cleanup();
+}
+
+Go_Atom Go_Atom_Table::atom(ccstr s) {
+    if (!s) return 0;
+
+    auto &shard = shards[hash64((void*)s, strlen(s)) % GO_ATOM_SHARDS];
+    SCOPED_LOCK(&shard.lock);
+
+    bool found = false;
+    auto ret = shard.lookup.get(s, &found);
+    if (found) return ret;
+
+    ccstr copy = NULL;
+    {
+        SCOPED_MEM(&shard.mem);
+        copy = cp_strdup(s);
+    }
+
+    {
+        SCOPED_LOCK(&pages_lock);
+
+        ret = count;
+        auto page_idx = ret / GO_ATOM_PAGE_SIZE;
+        if (page_idx >= GO_ATOM_MAX_PAGES)
+            cp_panic("ran out of atoms");
+
+        auto &page = pages[page_idx];
+        if (!page) {
+            page = (ccstr*)cp_malloc(sizeof(ccstr) * GO_ATOM_PAGE_SIZE);
+            mem0(page, sizeof(ccstr) * GO_ATOM_PAGE_SIZE);
+        }
+
+        page[ret % GO_ATOM_PAGE_SIZE] = copy;
+        count++;
+    }
+
+    shard.lookup.set(copy, ret);
+    return ret;
+}
+
+ccstr Go_Atom_Table::str(Go_Atom atom) {
+    if (!atom) return NULL;
+    return pages[atom / GO_ATOM_PAGE_SIZE][atom % GO_ATOM_PAGE_SIZE];
+}
+
+ccstr go_intern(ccstr s) {
+    return core.indexer.atoms.intern(s);
+}
+
+thread_local bool copy_into_index = false;
+
+ccstr copy_go_string(ccstr s) {
+    return copy_into_index ? go_intern(s) : cp_strdup(s);
+}
+
+void Go_Atom_Map::init() {
+    ptr0(this);
+    to_atom.init(LIST_MALLOC, 1024);
+    to_file.init(LIST_MALLOC, 1024);
+    to_atom.append((Go_Atom)0); // file id 0 is NULL
+    written = 1;
+}
+
+void Go_Atom_Map::cleanup() {
+    to_atom.cleanup();
+    to_file.cleanup();
+}
+
+void Go_Atom_Map::copy_from(Go_Atom_Map *other) {
+    to_atom.len = 0;
+    to_atom.concat(&other->to_atom);
+    to_file.len = 0;
+    to_file.concat(&other->to_file);
+    last_chunk = other->last_chunk;
+    chunk_bytes = other->chunk_bytes;
+    written = other->written;
+}
+
+u32 Go_Atom_Map::file_id(Go_Atom atom) {
+    if (!atom) return 0;
+
+    while (to_file.len <= atom)
+        to_file.append((u32)0);
+
+    auto &ret = to_file[atom];
+    if (!ret) {
+        ret = to_atom.len;
+        to_atom.append(atom);
+    }
+    return ret;
 }
 
 s32 num_index_stream_opens = 0;
 s32 num_index_stream_closes = 0;
 
-bool Index_Stream::open(ccstr _path, bool write) {
+bool Index_Stream::open(ccstr _path, bool write, bool append) {
     ptr0(this);
 
     path = _path;
@@ -63,10 +187,14 @@ bool Index_Stream::open(ccstr _path, bool write) {
 
     File_Mapping_Opts opts; ptr0(&opts);
     opts.write = write;
-    if (write) opts.initial_size = 1024;
+    opts.append = append;
+    if (write && !append) opts.initial_size = 1024;
 
     fm = map_file_into_memory(path, &opts);
-    return fm != NULL;
+    if (!fm) return false;
+
+    if (append) offset = fm->len;
+    return true;
 }
 
 void Index_Stream::cleanup() {
@@ -75,9 +203,13 @@ void Index_Stream::cleanup() {
 }
 
 bool Index_Stream::writen(void *buf, int n) {
-    if (offset + n > fm->len)
-        if (!fm->resize(fm->len * 2))
+    // package files get copied over whole, so this can be more than double
+    while (offset + n > fm->len) {
+        if (!fm->resize(fm->len * 2)) {
+            ok = false;
             return false;
+        }
+    }
 
     memcpy(&fm->data[offset], buf, n);
     offset += n;
@@ -87,8 +219,12 @@ bool Index_Stream::writen(void *buf, int n) {
 bool Index_Stream::write1(i8 x) { return writen(&x, 1); }
 bool Index_Stream::write2(i16 x) { return writen(&x, 2); }
 bool Index_Stream::write4(i32 x) { return writen(&x, 4); }
+bool Index_Stream::write8(i64 x) { return writen(&x, 8); }
 
 bool Index_Stream::writestr(ccstr s) {
+    if (atom_map)
+        return write4(atom_map->file_id(core.indexer.atoms.atom(s)));
+
     if (!s) return write2(0);
     auto len = strlen(s);
     if (!write2(len)) return false;
@@ -96,6 +232,19 @@ bool Index_Stream::writestr(ccstr s) {
     return true;
 }
 
+// Nearly every position fits in 20 bits of row and 11 of col, so they go in
+// one u32. The rest are GOTYPE_POS_ESCAPE followed by x and y.
+#define GOTYPE_POS_ESCAPE 0x80000000
+
+bool Index_Stream::writepos(cur2 pos) {
+    if (pos.x >= 0 && pos.x < (1 << 11) && pos.y >= 0 && pos.y < (1 << 20))
+        return write4((i32)(((u32)pos.y << 11) | (u32)pos.x));
+
+    if (!write4((i32)GOTYPE_POS_ESCAPE)) return false;
+    if (!write4(pos.x)) return false;
+    return write4(pos.y);
+}
+
 void Index_Stream::finish_writing() {
     fm->finish_writing(offset);
 }
@@ -129,7 +278,27 @@ i32 Index_Stream::read4() {
     return ok ? *(i32*)buf : 0;
 }
 
+i64 Index_Stream::read8() {
+    char buf[8];
+    readn(buf, 8);
+    return ok ? *(i64*)buf : 0;
+}
+
 ccstr Index_Stream::readstr() {
+    if (atom_map) {
+        auto id = (u32)read4();
+        if (!ok) return NULL;
+
+        if (id >= atom_map->to_atom.len) {
+            ok = false;
+            return NULL;
+        }
+
+        // NULL has always come back as an empty string
+        if (!id) return go_intern("");
+        return core.indexer.atoms.str(atom_map->to_atom[id]);
+    }
+
     Frame frame;
 
     auto size = (u32)read2();
@@ -147,6 +316,92 @@ ccstr Index_Stream::readstr() {
     return s;
 }
 
+cur2 Index_Stream::readpos() {
+    auto val = (u32)read4();
+    if (val != GOTYPE_POS_ESCAPE)
+        return new_cur2(val & ((1 << 11) - 1), val >> 11);
+
+    auto x = read4();
+    auto y = read4();
+    return new_cur2(x, y);
+}
+
+// ---
+
+void Gotype_Handles::Map::init() {
+    cap = 64;
+    len = 0;
+    slots = (Slot*)cp_malloc(sizeof(Slot) * cap);
+    mem0(slots, sizeof(Slot) * cap);
+}
+
+void Gotype_Handles::Map::cleanup() {
+    cp_free(slots);
+}
+
+Gotype_Handles::Slot *Gotype_Handles::Map::find(u64 hash, List<char> *keys, char *key, u32 key_len) {
+    for (u32 i = hash & (cap - 1);; i = (i + 1) & (cap - 1)) {
+        auto slot = &slots[i];
+        if (!slot->handle) return slot;
+        if (slot->hash != hash) continue;
+        if (!key) return slot;
+        if (slot->key_len == key_len && !memcmp(keys->items + slot->key_start, key, key_len))
+            return slot;
+    }
+}
+
+Gotype_Handles::Slot *Gotype_Handles::Map::insert(u64 hash) {
+    // callers only insert what they didn't find, so the first empty slot
+    // is where it goes even if the hash collides
+    auto empty_slot = [&](u64 hash) -> Slot* {
+        for (u32 i = hash & (cap - 1);; i = (i + 1) & (cap - 1))
+            if (!slots[i].handle)
+                return &slots[i];
+    };
+
+    if ((len + 1) * 4 > cap * 3) {
+        auto old_slots = slots;
+        auto old_cap = cap;
+
+        cap *= 2;
+        slots = (Slot*)cp_malloc(sizeof(Slot) * cap);
+        mem0(slots, sizeof(Slot) * cap);
+
+        for (u32 i = 0; i < old_cap; i++)
+            if (old_slots[i].handle)
+                memcpy(empty_slot(old_slots[i].hash), &old_slots[i], sizeof(Slot));
+        cp_free(old_slots);
+    }
+
+    auto slot = empty_slot(hash);
+    slot->hash = hash;
+    len++;
+    return slot;
+}
+
+void Gotype_Handles::init() {
+    ptr0(this);
+    gotypes.init(LIST_MALLOC, 64);
+    by_ptr.init();
+    by_key.init();
+    keys.init(LIST_MALLOC, 1024);
+    key.init(LIST_MALLOC, 64);
+}
+
+void Gotype_Handles::cleanup() {
+    gotypes.cleanup();
+    by_ptr.cleanup();
+    by_key.cleanup();
+    keys.cleanup();
+    key.cleanup();
+}
+
+Go_Package_Lazy_Files *new_lazy_files() {
+    auto ret = (Go_Package_Lazy_Files*)cp_malloc(sizeof(Go_Package_Lazy_Files));
+    ptr0(ret);
+    return ret;
+}
+
 Go_Index *Index_Stream::read_index() {
     auto magic_number = read4();
     if (!ok) {
@@ -172,15 +427,253 @@ Go_Index *Index_Stream::read_index() {
         return NULL;
     }
 
-    return read_object<Go_Index>(this);
+    auto trailer_offset = read8();
+    if (!ok) {
+        go_print("unable to read trailer offset");
+        return NULL;
+    }
+
+    if (trailer_offset < GO_INDEX_HEADER_SIZE || trailer_offset + 16 > fm->len) {
+        go_print("trailer offset out of bounds");
+        ok = false;
+        return NULL;
+    }
+
+    offset = trailer_offset;
+    auto directory_offset = read8();
+    auto last_chunk = read8();
+    if (!ok) {
+        go_print("unable to read trailer");
+        return NULL;
+    }
+
+    if (directory_offset < GO_INDEX_HEADER_SIZE || directory_offset >= trailer_offset) {
+        go_print("directory offset out of bounds");
+        ok = false;
+        return NULL;
+    }
+
+    // the directory's strings are atoms too, so these go first
+    cp_assert(atom_map);
+    if (!read_atoms(last_chunk, trailer_offset)) {
+        go_print("unable to read strings");
+        return NULL;
+    }
+
+    offset = directory_offset;
+
+    auto ret = read_object<Go_Index>(this);
+    if (!ok || !ret) {
+        ok = false;
+        return NULL;
+    }
+
+    // Files aren't read here. The directory is followed by where each
+    // package's files are, and Go_Indexer::load_package_files() reads them
+    // when they're needed.
+    live_bytes = GO_INDEX_HEADER_SIZE;
+    For (ret->packages) {
+        it.files = NULL;
+        it.disk_offset = read8();
+        it.disk_len = read8();
+        if (!ok) return NULL;
+
+        if (it.disk_offset < GO_INDEX_HEADER_SIZE || it.disk_offset + it.disk_len > directory_offset) {
+            go_print("package files out of bounds");
+            ok = false;
+            return NULL;
+        }
+
+        it.lazy_files = new_lazy_files();
+        it.lazy_files->offset = it.disk_offset;
+        it.lazy_files->len = it.disk_len;
+
+        live_bytes += it.disk_len;
+    }
+    live_bytes += offset - directory_offset;
+    live_bytes += atom_map->chunk_bytes + 16;
+
+    return ret;
+}
+
+// Reads the chunks of strings, starting with last_chunk and following each
+// one back to the one before it, into atom_map (which should be empty).
+bool Index_Stream::read_atoms(i64 last_chunk, i64 limit) {
+    SCOPED_FRAME();
+
+    List<i64> chunks;
+    chunks.init();
+
+    for (auto chunk = last_chunk; chunk;) {
+        // chunks only ever point backwards, so this can't loop forever
+        auto prev_limit = chunks.len ? *chunks.last() : limit;
+        if (chunk < GO_INDEX_HEADER_SIZE || chunk >= prev_limit) {
+            ok = false;
+            return false;
+        }
+
+        chunks.append(chunk);
+        offset = chunk;
+        chunk = read8();
+        if (!ok) return false;
+    }
+
+    for (int i = chunks.len - 1; i >= 0; i--) {
+        auto start = chunks[i];
+        offset = start + 8;
+
+        auto first = (u32)read4();
+        auto count = (u32)read4();
+        if (!ok) return false;
+
+        if (first != atom_map->to_atom.len) {
+            ok = false;
+            return false;
+        }
+
+        for (u32 j = 0; j < count; j++) {
+            auto len = (u16)read2();
+            if (!ok) return false;
+            if (offset + len > limit) {
+                ok = false;
+                return false;
+            }
+
+            SCOPED_FRAME();
+            auto str = new_array(char, len + 1);
+            readn(str, len);
+            if (!ok) return false;
+            str[len] = '\0';
+
+            auto atom = core.indexer.atoms.atom(str);
+            while (atom_map->to_file.len <= atom)
+                atom_map->to_file.append((u32)0);
+            atom_map->to_file[atom] = atom_map->to_atom.len;
+            atom_map->to_atom.append(atom);
+        }
+
+        atom_map->chunk_bytes += offset - start;
+    }
+
+    atom_map->last_chunk = last_chunk;
+    atom_map->written = atom_map->to_atom.len;
+    return true;
+}
+
+// Writes out the strings that got file ids since the last chunk.
+bool Index_Stream::write_atoms() {
+    auto first = atom_map->written;
+    auto count = atom_map->to_atom.len - first;
+    if (!count) return ok;
+
+    auto start = offset;
+    write8(atom_map->last_chunk);
+    write4(first);
+    write4(count);
+
+    for (u32 i = first; i < atom_map->to_atom.len; i++) {
+        auto str = core.indexer.atoms.str(atom_map->to_atom[i]);
+        auto len = strlen(str);
+        write2(len);
+        writen((void*)str, len);
+    }
+
+    if (!ok) return false;
+
+    atom_map->last_chunk = start;
+    atom_map->chunk_bytes += offset - start;
+    atom_map->written = atom_map->to_atom.len;
+    return true;
 }
 
-void Index_Stream::write_index(Go_Index *index) {
-    write4(GO_INDEX_MAGIC_NUMBER);
-    write4(GO_INDEX_VERSION);
+// Appending leaves whatever it replaced behind, so once more than half the
+// file is dead it gets rewritten.
+bool index_file_needs_compaction(i64 file_len, i64 live_bytes) {
+    return file_len > live_bytes * 2;
+}
+
+// The header points at a trailer with the offsets of the directory (the
+// Go_Index without files) and the newest chunk of strings (see Go_Atom_Map).
+// The directory is followed by where each package's files are. The files
+// themselves are somewhere before the directory.
+//
+// If the stream was opened to append to an existing index, packages whose
+// files haven't changed since it was written are left where they are, and
+// only changed packages and a new directory go on the end. The header isn't
+// pointed at the new directory until everything else is flushed, so if we
+// crash halfway the old index is still intact. Otherwise everything gets
+// written, with files that were never read in copied over from lazy_source.
+//
+// offsets and lens get where each package's files ended up.
+bool Index_Stream::write_index(Go_Index *index, Index_Stream *lazy_source, i64 *offsets, i64 *lens) {
+    bool append = fm->opts.append;
+    auto start = offset;
+
+    if (append) {
+        if (fm->len < GO_INDEX_HEADER_SIZE) return false;
+        if (*(i32*)&fm->data[0] != GO_INDEX_MAGIC_NUMBER) return false;
+        if (*(i32*)&fm->data[4] != GO_INDEX_VERSION) return false;
+    } else {
+        write4(GO_INDEX_MAGIC_NUMBER);
+        write4(GO_INDEX_VERSION);
+        write8(0);
+    }
+
+    // A rewrite puts every string in the file in one new chunk. The ids stay
+    // the same, since files copied over from lazy_source still use them.
+    cp_assert(atom_map);
+    if (!append) {
+        atom_map->last_chunk = 0;
+        atom_map->chunk_bytes = 0;
+        atom_map->written = 1;
+    }
+
+    live_bytes = GO_INDEX_HEADER_SIZE;
+
+    Fori (index->packages) {
+        if (append && it.disk_offset) {
+            offsets[i] = it.disk_offset;
+            lens[i] = it.disk_len;
+        } else if (it.needs_loading() && !it.lazy_files->files) {
+            cp_assert(lazy_source);
+            offsets[i] = offset;
+            lens[i] = it.lazy_files->len;
+            writen(&lazy_source->fm->data[it.lazy_files->offset], (int)it.lazy_files->len);
+        } else {
+            offsets[i] = offset;
+            write_list(it.loaded_files(), this);
+            lens[i] = offset - offsets[i];
+        }
+        live_bytes += lens[i];
+    }
+
+    auto directory_offset = offset;
     write_object<Go_Index>(index, this);
+    Fori (index->packages) {
+        write8(offsets[i]);
+        write8(lens[i]);
+    }
+    live_bytes += offset - directory_offset;
+
+    // after everything else, so it has every string that got an id
+    if (!write_atoms()) return false;
 
+    auto trailer_offset = offset;
+    write8(directory_offset);
+    write8(atom_map->last_chunk);
+    live_bytes += atom_map->chunk_bytes + 16;
+
+    if (!ok) return false;
+    if (!fm->flush(offset)) return false;
+
+    auto end = offset;
+    offset = 8;
+    write8(trailer_offset);
+    offset = end;
+
+    bytes_written = end - start;
     finish_writing();
+    return ok;
 }
 
 void Type_Renderer::write_type(Gotype *t, Type_Renderer_Handler custom_handler, bool omit_func_keyword) {
@@ -363,6 +856,7 @@ void Module_Resolver::init(ccstr root_filepath, ccstr _gomodcache) {
     ptr0(this);
 
     mem.init("module_resolver_mem");
+    cache.init();
     {
         SCOPED_MEM(&mem);
         gomodcache = cp_strdup(_gomodcache);
@@ -413,14 +907,14 @@ void Module_Resolver::init(ccstr root_filepath, ccstr _gomodcache) {
     };
 
     do {
-        auto gowork_path = GHGetGoWork(world.current_path);
+        auto gowork_path = GHGetGoWork(core.current_path);
         if (!gowork_path) break;
         defer { GHFree(gowork_path); };
 
         auto pf = parse_file(gowork_path, LANG_GOWORK, false);
         if (!pf) break;
 
-        if (are_filepaths_same_file(world.current_path, cp_dirname(gowork_path)))
+        if (are_filepaths_same_file(core.current_path, cp_dirname(gowork_path)))
             workspace.flag = GWS_GOWORK_AT_ROOT;
         else
             workspace.flag = GWS_GOWORK_SOMEWHERE_ELSE;
@@ -458,7 +952,7 @@ void Module_Resolver::init(ccstr root_filepath, ccstr _gomodcache) {
         proc->init();
         proc->dir = root_filepath;
         proc->skip_shell = true;
-        if (!proc->run(cp_sprintf("%s list -m all", world.go_binary_path))) return NULL;
+        if (!proc->run(cp_sprintf("%s list -m all", core.go_binary_path))) return NULL;
 
         auto start = current_time_milli();
 
@@ -545,14 +1039,154 @@ void Module_Resolver::init(ccstr root_filepath, ccstr _gomodcache) {
         For (inferred_modules)
             workspace.modules->append(it.copy());
 
-    world.which_workspace_mem ^= 1;
-    auto mem = world.which_workspace_mem ? &world.workspace_mem_1 : &world.workspace_mem_2;
+    core.which_workspace_mem ^= 1;
+    auto mem = core.which_workspace_mem ? &core.workspace_mem_1 : &core.workspace_mem_2;
     mem->reset();
     {
         SCOPED_MEM(mem);
         auto newobj = workspace.copy();
-        world.workspace = newobj;
+        core.workspace = newobj;
+    }
+}
+
+void Module_Resolver::Cache::init() {
+    ptr0(this);
+    lock.init();
+    mem.init("module_resolver_cache");
+
+    SCOPED_MEM(&mem);
+    import_to_resolved.init();
+    resolved_to_import.init();
+}
+
+void Module_Resolver::Cache::cleanup() {
+    mem.cleanup();
+    lock.cleanup();
+}
+
+// Caller holds lock.
+void Module_Resolver::Cache::reset() {
+    // everything's in mem
+    import_to_resolved.lookup = NULL;
+    resolved_to_import.lookup = NULL;
+    mem.reset();
+    len = 0;
+
+    SCOPED_MEM(&mem);
+    import_to_resolved.init();
+    resolved_to_import.init();
+}
+
+// name is lowercased already.
+Module_Resolver::Trie_Node *Module_Resolver::goto_child(Trie_Node *node, ccstr name, int len, bool create_if_not_found) {
+    Trie_Node *ret = NULL;
+    HASH_FIND(hh, node->children, name, len, ret);
+    if (ret || !create_if_not_found) return ret;
+
+    SCOPED_MEM(&mem);
+
+    ret = new_object(Trie_Node);
+    ret->name = cp_strncpy(name, len);
+    HASH_ADD_KEYPTR(hh, node->children, ret->name, len, ret);
+    return ret;
+}
+
+// Calls cb on each part of path, lowercased, with where the part ends.
+// Stops when cb returns false.
+static void walk_path_parts(ccstr path, fn<bool(ccstr, int, int)> cb) {
+    auto len = strlen(path);
+    auto buf = new_array(char, len + 1);
+
+    for (u32 start = 0; start < len;) {
+        u32 end = start;
+        while (end < len && !is_sep(path[end])) {
+            buf[end - start] = tolower((uchar)path[end]);
+            end++;
+        }
+        buf[end - start] = '\0';
+
+        if (!cb(buf, end - start, end)) return;
+        start = end + 1;
+    }
+}
+
+void Module_Resolver::add_path(ccstr import_path, ccstr resolved_path) {
+    resolved_path = normalize_path_sep(cp_strdup(resolved_path));
+
+    auto add_to_root = [&](Trie_Node *root, ccstr key, ccstr value) {
+        auto curr = root;
+        walk_path_parts(key, [&](ccstr part, int len, int) {
+            curr = goto_child(curr, part, len, true);
+            return true;
+        });
+        curr->value = value;
+    };
+
+    add_to_root(root_import_to_resolved, import_path, resolved_path);
+    add_to_root(root_resolved_to_import, resolved_path, import_path);
+}
+
+ccstr Module_Resolver::convert_path(Trie_Node *root, ccstr path, char sep) {
+    if (!root) return NULL;
+
+    Frame frame;
+
+    auto curr = root;
+    ccstr last_value = NULL;
+    int last_end = 0;
+
+    walk_path_parts(path, [&](ccstr part, int len, int end) {
+        curr = goto_child(curr, part, len, false);
+        if (!curr) return false;
+
+        if (curr->value) {
+            last_value = curr->value;
+            last_end = end;
+        }
+        return true;
+    });
+
+    if (!last_value) return NULL;
+
+    // whatever's after the longest match gets tacked on, minus separators at
+    // the end, same as if it had been split up and joined back together
+    auto rest = path + last_end;
+    auto restlen = strlen(rest);
+    while (restlen > 0 && is_sep(rest[restlen-1])) restlen--;
+
+    frame.restore();
+
+    auto valuelen = strlen(last_value);
+    auto ret = new_array(char, valuelen + restlen + 1);
+    memcpy(ret, last_value, valuelen);
+    memcpy(ret + valuelen, rest, restlen);
+    ret[valuelen + restlen] = '\0';
+
+    for (auto p = ret; *p; p++)
+        if (is_sep(*p))
+            *p = sep;
+    return ret;
+}
+
+ccstr Module_Resolver::cached_convert_path(Table<ccstr> *table, Trie_Node *root, ccstr path, char sep) {
+    {
+        SCOPED_LOCK(&cache.lock);
+
+        bool found = false;
+        auto ret = table->get(path, &found);
+        if (found) return ret ? cp_strdup(ret) : NULL;
     }
+
+    auto ret = convert_path(root, path, sep);
+
+    SCOPED_LOCK(&cache.lock);
+    if (cache.len >= RESOLVER_CACHE_MAX)
+        cache.reset();
+
+    SCOPED_MEM(&cache.mem);
+    table->set(cp_strdup(path), ret ? cp_strdup(ret) : NULL);
+    cache.len++;
+    return ret;
 }
 
 // -----
@@ -576,6 +1210,10 @@ bool is_name_special_function(ccstr name) {
     return false;
 }
 
+bool is_goident_empty(ccstr name) {
+    return (!name || name[0] == '\0' || streq(name, "_"));
+}
+
 bool is_name_private(ccstr name) {
     if (!isupper(name[0]))
         return true;
@@ -584,42 +1222,6 @@ bool is_name_private(ccstr name) {
     return false;
 }
 
-struct Parser_Input {
-    Parser_It *it;
-    char buf[128];
-};
-
-const char* read_from_parser_input(void *p, uint32_t off, TSPoint pos, uint32_t *read) {
-    Parser_Input *input = (Parser_Input*)p;
-    Parser_It *it = input->it;
-    auto buf = input->buf;
-    auto bufsize = _countof(input->buf);
-    u32 n = 0;
-
-    if (it->type == IT_MMAP)
-        it->set_pos(new_cur2(off, -1));
-    else if (it->type == IT_BUFFER)
-        it->set_pos(tspoint_to_cur(pos));
-
-    while (!it->eof()) {
-        auto uch = it->next();
-        if (!uch) break;
-
-        if (it->type == IT_MMAP) {
-            if (n + 2 > bufsize) break;
-            buf[n++] = (char)uch;
-        } else if (it->type == IT_BUFFER) {
-            auto size = uchar_size(uch);
-            if (n + size + 1 > bufsize) break;
-            n += uchar_to_cstr(uch, &buf[n]);
-        }
-    }
-
-    *read = n;
-    buf[n] = '\0';
-    return buf;
-}
-
 bool isident(int c) {
     return c == '_' || uni_isalpha(c) || uni_isdigit(c);
 }
@@ -627,6 +1229,17 @@ bool isident(int c) {
 Goresult *Goresult::wrap(Godecl *new_decl) { return make_goresult(new_decl, ctx); }
 Goresult *Goresult::wrap(Gotype *new_gotype) { return make_goresult(new_gotype, ctx); }
 
+// Set on whichever thread holds write_lock, so that it works on `index`
+// while everyone else reads the snapshot.
+static thread_local bool owns_working_index = false;
+
+// The snapshot a reader pinned in acquire_lock(IND_READING). Readers look
+// only at this, never at `snapshot`, which the bg thread can swap out from
+// under them at any point; what it points to stays alive until the last
+// reader lets go. `pinned_depth` counts nested read locks on this thread.
+static thread_local Index_Snapshot *pinned_snapshot = NULL;
+static thread_local int pinned_depth = 0;
+
 Pool *Go_Indexer::get_package_pool(Go_Package *pkg) {
     return pkg->use_pool ? pkg->pool : &final_mem;
 }
@@ -636,29 +1249,57 @@ Pool *Go_Indexer::get_file_pool(Go_Package *pkg, Go_File *file) {
 }
 
 // @Write
+// The package's files might be in a snapshot somebody's reading, so nothing
+// already there gets touched: the file goes into a fresh copy of the list,
+// with a fresh pool, and the old one is retired.
 Go_File *Go_Indexer::get_ready_file_in_package(Go_Package *pkg, ccstr filename) {
-    auto file = pkg->files->find([&](auto it) { return streq(filename, it->filename); });
-    if (!file) {
-        file = pkg->files->append();
-        file->use_pool = !pkg->use_pool;
-        if (file->use_pool) {
-            SCOPED_MEM(&final_mem);
-            file->pool = new_object(Pool);
-        }
+    load_package_files(pkg);
+
+    // what's on disk is about to be out of date
+    pkg->disk_offset = 0;
+    pkg->disk_len = 0;
+    invalidate_decl_table(pkg);
+    bump_package_generation(pkg);
+
+    // the file's call edges get redone by the caller once it's processed,
+    // see update_call_edges()
+
+    auto old_files = pkg->files;
+    {
+        SCOPED_MEM(get_package_pool(pkg));
+        pkg->files = new_list(Go_File, old_files->len + 1);
     }
 
-    if (file->use_pool) {
-        file->pool->cleanup();
-        file->pool->init("go_file");
-        file->pool->disable_alignment = true;
+    Go_File *file = NULL;
+    For (old_files) {
+        if (!streq(filename, it.filename)) {
+            pkg->files->append(&it);
+            continue;
+        }
+
+        // otherwise it goes along with the rest of lazy_files
+        if (it.use_pool)
+            if (!pkg->lazy_files || !pkg->lazy_files->owns(&it))
+                retire_pool(it.pool);
+
+        file = pkg->files->append();
     }
 
-    SCOPED_MEM(get_file_pool(pkg, file));
-    file->filename = cp_strdup(filename);
-    file->scope_ops = new_list(Go_Scope_Op);
+    if (!file) file = pkg->files->append();
+
+    file->use_pool = !pkg->use_pool;
+    if (file->use_pool)
+        file->pool = new_index_pool("go_file");
+
+    snapshot_dirty = true;
+
+    SCOPED_MEM(get_file_pool(pkg, file));
+    file->filename = cp_strdup(filename);
+    file->scope_ops = pkg->use_pool ? NULL : new_list(Go_Scope_Op);
     file->decls = new_list(Godecl);
     file->imports = new_list(Go_Import);
     file->references = new_list(Go_Reference);
+    file->reference_postings = new_list(Go_Reference_Posting);
     return file;
 }
 
@@ -670,7 +1311,20 @@ either:
         - honestly, wouldn't this slow things down?
 */
 
+// @Write
 void Go_Indexer::reload_single_file(ccstr filepath) {
+    if (!owns_working_index) {
+        if (!wait_for_write_lock(EDITOR_RELOAD_WAIT_MILLI)) {
+            index_print("Indexer busy, couldn't reload %s.", filepath);
+            return;
+        }
+        defer { leave_write_lock(); };
+
+        reload_single_file(filepath);
+        if (snapshot_dirty) publish_snapshot();
+        return;
+    }
+
     auto import_path = filepath_to_import_path(cp_dirname(filepath));
     auto pkg = find_package_in_index(import_path);
     if (!pkg) return;
@@ -686,9 +1340,31 @@ void Go_Indexer::reload_single_file(ccstr filepath) {
     process_tree_into_gofile(file, pf->root, filepath, &package_name, get_file_pool(pkg, file));
     if (!str_ends_with(filepath, "_test.go"))
         replace_package_name(pkg, package_name);
+    add_reference_names(pkg, file);
+    add_method_sets(pkg, file);
+    rebuild_symbols(pkg);
+    rebuild_decl_table(pkg);
+    update_call_edges(pkg, file->filename);
 }
 
+// @Write
+// Editors get pushed into `index` like any other change. If the background
+// thread has write_lock, this waits a little for it (see
+// wait_for_write_lock()); if it still can't get in, the editor stays dirty
+// and gets picked up next time.
 void Go_Indexer::reload_editor(void *editor) {
+    if (!owns_working_index) {
+        if (!wait_for_write_lock(EDITOR_RELOAD_WAIT_MILLI)) {
+            index_print("Indexer busy, couldn't reload %s.", ((Editor*)editor)->filepath);
+            return;
+        }
+        defer { leave_write_lock(); };
+
+        reload_editor(editor);
+        if (snapshot_dirty) publish_snapshot();
+        return;
+    }
+
     auto it = (Editor*)editor;
 
     SCOPED_FRAME();
@@ -716,6 +1392,11 @@ void Go_Indexer::reload_editor(void *editor) {
     process_tree_into_gofile(file, root_node, it->filepath, &package_name, get_file_pool(pkg, file));
     if (!str_ends_with(it->filepath, "_test.go"))
         replace_package_name(pkg, package_name);
+    add_reference_names(pkg, file);
+    add_method_sets(pkg, file);
+    rebuild_symbols(pkg);
+    rebuild_decl_table(pkg);
+    update_call_edges(pkg, file->filename);
 
     t.log("process tree");
 
@@ -726,9 +1407,21 @@ void Go_Indexer::reload_editor(void *editor) {
 void Go_Indexer::reload_all_editors(bool force) {
     cp_assert(is_main_thread);
 
+    if (!wait_for_write_lock(EDITOR_RELOAD_WAIT_MILLI)) {
+        index_print("Indexer busy, couldn't reload open editors.");
+        editor_reload_skipped = true;
+        return;
+    }
+    defer { leave_write_lock(); };
+
+    editor_reload_skipped = false;
+
     For (get_all_editors())
         if (it->buf->tree_dirty || force)
             reload_editor(it);
+
+    // so the caller sees them
+    if (snapshot_dirty) publish_snapshot();
 }
 
 
@@ -753,8 +1446,367 @@ void Go_Indexer::replace_package_name(Go_Package *pkg, ccstr package_name) {
         if (streq(pkg->package_name, package_name))
             return;
 
+    pkg->package_name = go_intern(package_name);
+}
+
+bool Go_Package::has_reference_to(ccstr name) {
+    if (!reference_names) return false;
+
+    int lo = 0, hi = reference_names->len;
+    while (lo < hi) {
+        auto mid = (lo + hi) / 2;
+        auto cmp = strcmp(reference_names->at(mid).name, name);
+        if (!cmp) return true;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return false;
+}
+
+// Index of the first posting for name, or -1.
+static int find_reference_posting(List<Go_Reference_Posting> *postings, ccstr name) {
+    if (!postings) return -1;
+
+    int lo = 0, hi = postings->len;
+    while (lo < hi) {
+        auto mid = (lo + hi) / 2;
+        if (strcmp(postings->at(mid).name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < postings->len && streq(postings->at(lo).name, name))
+        return lo;
+    return -1;
+}
+
+// @Write
+// From scratch, for a package whose files all just got processed.
+void Go_Indexer::rebuild_reference_names(Go_Package *pkg) {
+    retire_pool(pkg->reference_names_pool);
+    pkg->reference_names_pool = NULL;
+
+    SCOPED_FRAME();
+
+    auto names = new_list(ccstr);
+    For (pkg->files) {
+        ccstr last = NULL;
+        For (it.reference_postings) {
+            if (it.name == last) continue;
+            names->append(it.name);
+            last = it.name;
+        }
+    }
+
+    names->sort([&](auto a, auto b) { return strcmp(*a, *b); });
+
+    SCOPED_MEM(get_package_pool(pkg));
+    pkg->reference_names = new_list(Go_Reference_Name, max(names->len, 1));
+    For (names) {
+        if (pkg->reference_names->len && pkg->reference_names->last()->name == it)
+            continue;
+        pkg->reference_names->append()->name = it;
+    }
+}
+
+// @Write
+// For a file that just got processed on its own. This gets called a lot as
+// editors change, so it only makes a new list (in its own pool, so the old
+// one can actually be freed) when there's a name that wasn't there before.
+void Go_Indexer::add_reference_names(Go_Package *pkg, Go_File *file) {
+    SCOPED_FRAME();
+
+    auto added = new_list(ccstr);
+    {
+        ccstr last = NULL;
+        For (file->reference_postings) {
+            if (it.name == last) continue;
+            last = it.name;
+            if (!pkg->has_reference_to(it.name))
+                added->append(it.name);
+        }
+    }
+
+    if (!added->len) return;
+
+    auto names = new_list(ccstr);
+    if (pkg->reference_names)
+        For (pkg->reference_names)
+            names->append(it.name);
+    names->concat(added);
+    names->sort([&](auto a, auto b) { return strcmp(*a, *b); });
+
+    auto old_pool = pkg->reference_names_pool;
+    auto pool = new_index_pool("go_package_reference_names");
+
+    {
+        SCOPED_MEM(pool);
+        pkg->reference_names = new_list(Go_Reference_Name, names->len);
+        For (names) pkg->reference_names->append()->name = it;
+    }
+
+    pkg->reference_names_pool = pool;
+    retire_pool(old_pool);
+    snapshot_dirty = true;
+}
+
+int Go_Package::find_method_set(ccstr type_name) {
+    if (!method_sets) return -1;
+
+    int lo = 0, hi = method_sets->len;
+    while (lo < hi) {
+        auto mid = (lo + hi) / 2;
+        auto cmp = strcmp(method_sets->at(mid).type_name, type_name);
+        if (!cmp) return mid;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+// Index of the first posting for hash, or method_postings->len.
+static int find_method_posting(List<Go_Method_Posting> *postings, u64 hash, int set = 0) {
+    int lo = 0, hi = postings->len;
+    while (lo < hi) {
+        auto mid = (lo + hi) / 2;
+        auto &it = postings->at(mid);
+        if (it.hash < hash || (it.hash == hash && it.set < set))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bool Go_Package::has_method(int set, u64 hash) {
+    if (!method_postings) return false;
+
+    auto i = find_method_posting(method_postings, hash, set);
+    if (i == method_postings->len) return false;
+
+    auto &it = method_postings->at(i);
+    return it.hash == hash && it.set == set;
+}
+
+// Only the name and arity, are_gotypes_equal() has to resolve everything
+// else. Param counts are reliable because each name in `a, b int` gets its
+// own Godecl.
+static u64 hash_method(ccstr name, Gotype *gotype) {
+    if (!name) return 0;
+
+    s32 arity[2] = {-1, -1};
+    if (gotype && gotype->type == GOTYPE_FUNC) {
+        auto &sig = gotype->func_sig;
+        arity[0] = sig.params ? sig.params->len : 0;
+        arity[1] = sig.result ? sig.result->len : 0;
+    }
+    return hash64((void*)name, strlen(name)) ^ (hash64(arity, sizeof(arity)) * 31);
+}
+
+struct Method_Set_Item {
+    ccstr type_name;
+    u64 hash;
+    bool has_hash;
+    bool is_interface;
+    bool has_embeds;
+};
+
+static void list_method_set_items(Go_File *file, List<Method_Set_Item> *out) {
+    if (!file->decls) return;
+
+    For (file->decls) {
+        if (!it.name) continue;
+
+        if (it.type == GODECL_TYPE) {
+            auto item = out->append();
+            item->type_name = it.name;
+
+            auto gotype = it.gotype;
+            if (!gotype || gotype->type != GOTYPE_INTERFACE) continue;
+
+            item->is_interface = true;
+
+            // not a pointer, out can grow
+            auto type_name = it.name;
+            bool has_embeds = false;
+
+            if (gotype->interface_specs) {
+                For (gotype->interface_specs) {
+                    auto method = it.field;
+                    if (!method || method->field_is_embedded || !method->gotype || method->gotype->type != GOTYPE_FUNC) {
+                        has_embeds = true;
+                        continue;
+                    }
+
+                    auto meth = out->append();
+                    meth->type_name = type_name;
+                    meth->hash = hash_method(method->name, method->gotype);
+                    meth->has_hash = true;
+                }
+            }
+
+            if (has_embeds) {
+                auto flag = out->append();
+                flag->type_name = type_name;
+                flag->is_interface = true;
+                flag->has_embeds = true;
+            }
+            continue;
+        }
+
+        if (it.type != GODECL_FUNC) continue;
+
+        auto gotype = it.gotype;
+        if (!gotype || gotype->type != GOTYPE_FUNC) continue;
+        if (!gotype->func_recv) continue;
+
+        auto recv = gotype->func_recv;
+        while (recv && recv->type == GOTYPE_POINTER)
+            recv = recv->pointer_base;
+        if (recv && recv->type == GOTYPE_GENERIC) recv = recv->base;
+        if (!recv || recv->type != GOTYPE_ID) continue;
+
+        auto item = out->append();
+        item->type_name = recv->id_name;
+        item->hash = hash_method(it.name, gotype);
+        item->has_hash = true;
+    }
+}
+
+static void list_method_set_items(Go_Package *pkg, List<Method_Set_Item> *out) {
+    if (!pkg->method_sets) return;
+
+    Fori (pkg->method_sets) {
+        auto item = out->append();
+        item->type_name = it.type_name;
+        item->is_interface = it.is_interface;
+        item->has_embeds = it.has_embeds;
+    }
+
+    if (pkg->method_postings) {
+        For (pkg->method_postings) {
+            auto item = out->append();
+            item->type_name = pkg->method_sets->at(it.set).type_name;
+            item->hash = it.hash;
+            item->has_hash = true;
+        }
+    }
+}
+
+// Puts the lists in the current MEM. Type names are interned, so items for
+// the same type end up next to each other.
+static void build_method_sets(Go_Package *pkg, List<Method_Set_Item> *items) {
+    items->sort([&](auto a, auto b) {
+        auto cmp = strcmp(a->type_name, b->type_name);
+        if (cmp) return cmp;
+        if (a->hash != b->hash) return a->hash < b->hash ? -1 : 1;
+        return 0;
+    });
+
+    int nsets = 0;
+    Fori (items)
+        if (!i || items->at(i-1).type_name != it.type_name)
+            nsets++;
+
+    auto sets = new_list(Go_Method_Set, max(nsets, 1));
+    auto postings = new_list(Go_Method_Posting, max(items->len, 1));
+
+    Fori (items) {
+        if (!i || items->at(i-1).type_name != it.type_name) {
+            auto set = sets->append();
+            set->type_name = it.type_name;
+        }
+
+        auto set = sets->last();
+        if (it.is_interface) set->is_interface = true;
+        if (it.has_embeds) set->has_embeds = true;
+        if (!it.has_hash) continue;
+
+        auto setidx = sets->len - 1;
+        if (postings->len) {
+            auto last = postings->last();
+            if (last->set == setidx && last->hash == it.hash)
+                continue;
+        }
+
+        auto posting = postings->append();
+        posting->hash = it.hash;
+        posting->set = setidx;
+        set->methods++;
+    }
+
+    postings->sort([&](auto a, auto b) {
+        if (a->hash != b->hash) return a->hash < b->hash ? -1 : 1;
+        return a->set - b->set;
+    });
+
+    pkg->method_sets = sets;
+    pkg->method_postings = postings;
+}
+
+// @Write
+// From scratch, like rebuild_reference_names().
+void Go_Indexer::rebuild_method_sets(Go_Package *pkg) {
+    retire_pool(pkg->method_sets_pool);
+    pkg->method_sets_pool = NULL;
+
+    SCOPED_FRAME();
+
+    auto items = new_list(Method_Set_Item);
+    For (pkg->files) list_method_set_items(&it, items);
+
     SCOPED_MEM(get_package_pool(pkg));
-    pkg->package_name = cp_strdup(package_name);
+    build_method_sets(pkg, items);
+}
+
+// @Write
+// Like add_reference_names(), only makes new lists when the file has a type
+// or method that isn't in them already.
+void Go_Indexer::add_method_sets(Go_Package *pkg, Go_File *file) {
+    SCOPED_FRAME();
+
+    auto items = new_list(Method_Set_Item);
+    list_method_set_items(file, items);
+
+    auto is_new = [&](Method_Set_Item *it) {
+        auto set = pkg->find_method_set(it->type_name);
+        if (set == -1) return true;
+
+        auto &info = pkg->method_sets->at(set);
+        if (it->is_interface && !info.is_interface) return true;
+        if (it->has_embeds && !info.has_embeds) return true;
+        if (it->has_hash && !pkg->has_method(set, it->hash)) return true;
+        return false;
+    };
+
+    bool changed = false;
+    For (items) {
+        if (is_new(&it)) {
+            changed = true;
+            break;
+        }
+    }
+
+    if (!changed) return;
+
+    list_method_set_items(pkg, items);
+
+    auto old_pool = pkg->method_sets_pool;
+    auto pool = new_index_pool("go_package_method_sets");
+
+    {
+        SCOPED_MEM(pool);
+        build_method_sets(pkg, items);
+    }
+
+    pkg->method_sets_pool = pool;
+    retire_pool(old_pool);
+    snapshot_dirty = true;
 }
 
 void Go_Indexer::init_builtins(Go_Package *pkg) {
@@ -776,7 +1828,7 @@ void Go_Indexer::init_builtins(Go_Package *pkg) {
         auto decl = f->decls->append();
         decl->is_toplevel = true;
         decl->type = decl_type;
-        decl->name = cp_strdup(name);
+        decl->name = go_intern(name);
         decl->gotype = gotype;
 
         return gotype;
@@ -814,7 +1866,7 @@ void Go_Indexer::init_builtins(Go_Package *pkg) {
         auto decl = f->decls->append();
         decl->type = GODECL_VAR; // TODO: special godecl_type for builtin values?
         decl->is_toplevel = true;
-        decl->name = cp_strdup(name);
+        decl->name = go_intern(name);
         decl->gotype = new_gotype(GOTYPE_BUILTIN);
         decl->gotype->builtin_type = type;
     };
@@ -1020,6 +2072,80 @@ void Go_Indexer::init_builtins(Go_Package *pkg) {
     }
 }
 
+void Package_Queue::init() {
+    ptr0(this);
+    for (int i = 0; i < _PKGPRI_COUNT_; i++)
+        buckets[i].init();
+    enqueued.init();
+}
+
+// import_path has to live as long as the queue.
+void Package_Queue::push(ccstr import_path, Package_Priority priority) {
+    if (enqueued.has(import_path)) return;
+
+    buckets[priority].append(import_path);
+    enqueued.add(import_path);
+    len++;
+}
+
+ccstr Package_Queue::pop() {
+    for (int i = 0; i < _PKGPRI_COUNT_; i++) {
+        auto &bucket = buckets[i];
+        if (!bucket.len) continue;
+
+        auto ret = bucket.pop();
+        enqueued.remove(ret);
+        len--;
+        return ret;
+    }
+    return NULL;
+}
+
+void Package_Queue::clear() {
+    for (int i = 0; i < _PKGPRI_COUNT_; i++)
+        buckets[i].len = 0;
+    enqueued.clear();
+    len = 0;
+}
+
+void Package_Queue::rerank(fn<Package_Priority(ccstr)> get_priority) {
+    if (!len) return;
+
+    List<ccstr> all;
+    all.init(LIST_MALLOC, len);
+    defer { all.cleanup(); };
+
+    // the order within each bucket is kept, so LIFO still means something
+    for (int i = _PKGPRI_COUNT_ - 1; i >= 0; i--) {
+        all.concat(&buckets[i]);
+        buckets[i].len = 0;
+    }
+
+    For (&all) buckets[get_priority(it)].append(it);
+}
+
+// Tells the indexer which editors are open, so it can get to their
+// packages first, see Package_Priority.
+void Go_Indexer::editors_changed() {
+    cp_assert(is_main_thread);
+
+    auto current = get_current_editor();
+
+    message_queue.add([&](auto msg) {
+        msg->type = GOMSG_EDITORS_CHANGED;
+        msg->editor_filepaths = new_list(ccstr);
+
+        if (current && str_ends_with(current->filepath, ".go"))
+            msg->editor_filepaths->append(cp_strdup(current->filepath));
+
+        For (get_all_editors()) {
+            if (it == current) continue;
+            if (!str_ends_with(it->filepath, ".go")) continue;
+            msg->editor_filepaths->append(cp_strdup(it->filepath));
+        }
+    });
+}
+
 // @Write
 void Go_Indexer::background_thread() {
     // initialize stuff
@@ -1029,11 +2155,28 @@ void Go_Indexer::background_thread() {
     thread_mem.init("thread_mem");
     defer { thread_mem.cleanup(); };
 
+    Pool editors_mem;
+    editors_mem.init("editors_mem");
+    defer { editors_mem.cleanup(); };
+
     SCOPED_MEM(&mem);
     use_pool_for_tree_sitter = true;
 
-    List<ccstr> package_queue;
-    String_Set already_enqueued_packages;
+    // let go of it only while waiting for work or writing to disk, see
+    // wait_for_work and "write index to disk" below
+    enter_write_lock();
+
+    Package_Queue package_queue;
+
+    // from the last GOMSG_EDITORS_CHANGED, in editors_mem
+    ccstr current_editor_package = NULL;
+    String_Set editor_packages;
+    String_Set editor_imports;
+
+    // packages handed off to workers and not yet published, and the subset
+    // of those that changed on disk in the meantime
+    String_Set packages_in_flight;
+    String_Set packages_dirtied_in_flight;
 
     index_print("Looking up dependency tree.");
 
@@ -1042,10 +2185,18 @@ void Go_Indexer::background_thread() {
         {
             start_writing();
             defer { stop_writing(); };
-            module_resolver.init(world.current_path, gomodcache);
+            module_resolver.init(core.current_path, gomodcache);
         }
         package_queue.init();
-        already_enqueued_packages.init();
+        packages_in_flight.init();
+        packages_dirtied_in_flight.init();
+    }
+
+    {
+        // leave a core for the main thread
+        auto num_workers = min(max(get_cpu_count() - 1, 1), 64);
+        workers.init(this, num_workers);
+        index_print("Started %d indexer workers.", workers.threads.len);
     }
 
     {
@@ -1053,30 +2204,96 @@ void Go_Indexer::background_thread() {
         package_lookup.init();
     }
 
+    {
+        SCOPED_MEM(&editors_mem);
+        editor_packages.init();
+        editor_imports.init();
+    }
+
     // now that we successfully initialized in the current folder,
     // instruct the main thread to write it out to .last_folder
-    world.message_queue.add([&](auto msg) {
+    core.message_queue.add([&](auto msg) {
         msg->type = MTM_WRITE_LAST_FOLDER;
     });
 
     // utility functions
     // ===
 
+    auto get_package_priority = [&](ccstr import_path) -> Package_Priority {
+        if (current_editor_package && streq(import_path, current_editor_package))
+            return PKGPRI_CURRENT_EDITOR;
+        if (editor_packages.has(import_path))
+            return PKGPRI_OPEN_EDITOR;
+        if (editor_imports.has(import_path))
+            return PKGPRI_EDITOR_IMPORT;
+        if (index_has_module_containing(import_path))
+            return PKGPRI_WORKSPACE;
+        return PKGPRI_OTHER;
+    };
+
     auto enqueue_package = [&](ccstr import_path) {
         // TODO: periodically clean up thread_mem
         SCOPED_MEM(&thread_mem);
 
-        if (already_enqueued_packages.has(import_path))
+        if (package_queue.has(import_path))
             return;
 
-        package_queue.append(cp_strdup(import_path));
-        already_enqueued_packages.add(import_path);
+        // callers' strings don't necessarily outlive the queue
+        import_path = cp_strdup(import_path);
+        package_queue.push(import_path, get_package_priority(import_path));
+    };
+
+    // An open editor's package got (re)processed, or the editors changed.
+    auto add_editor_imports = [&](Go_Package *pkg) {
+        load_package_files(pkg);
+        if (!pkg->files) return;
+
+        SCOPED_MEM(&editors_mem);
+        For (pkg->files) {
+            if (!it.imports) continue;
+            For (it.imports)
+                if (it.import_path && !editor_imports.has(it.import_path))
+                    editor_imports.add(cp_strdup(it.import_path));
+        }
+    };
+
+    auto set_editor_filepaths = [&](List<ccstr> *filepaths) {
+        editors_mem.reset();
+        SCOPED_MEM(&editors_mem);
+
+        current_editor_package = NULL;
+        editor_packages.init();
+        editor_imports.init();
+
+        Fori (filepaths) {
+            auto import_path = filepath_to_import_path(cp_dirname(it));
+            if (!import_path) continue;
+
+            if (!i) current_editor_package = import_path;
+            if (editor_packages.has(import_path)) continue;
+            editor_packages.add(import_path);
+
+            auto pkg = find_package_in_index(import_path);
+            if (pkg) add_editor_imports(pkg);
+        }
+
+        package_queue.rerank(get_package_priority);
     };
 
     auto mark_package_for_reprocessing = [&](ccstr import_path) {
         auto pkg = find_package_in_index(import_path);
-        if (pkg)
+        if (pkg) {
             pkg->status = GPS_OUTDATED;
+            snapshot_dirty = true;
+        }
+
+        // the worker might have read the old files already, so process it
+        // again once its current job is published
+        if (packages_in_flight.has(import_path)) {
+            SCOPED_MEM(&thread_mem);
+            packages_dirtied_in_flight.add(cp_strdup(import_path));
+        }
+
         enqueue_package(import_path);
     };
 
@@ -1084,7 +2301,7 @@ void Go_Indexer::background_thread() {
         if (!file->imports) return;
         For (file->imports) {
             if (!it.import_path) continue;
-            if (already_enqueued_packages.has(it.import_path)) continue;
+            if (package_queue.has(it.import_path)) continue;
 
             auto pkg = find_package_in_index(it.import_path);
             if (pkg && pkg->status == GPS_READY) continue;
@@ -1105,17 +2322,89 @@ void Go_Indexer::background_thread() {
     };
 
     auto is_go_package = [&](ccstr path) -> bool {
-        bool ret = false;
-        list_directory(path, [&](auto it) {
-            if (it->type == DIRENT_FILE)
-                if (str_ends_with(it->name, ".go"))
-                    if (is_file_included_in_build(path_join(path, it->name))) {
-                        ret = true;
-                        return false;
-                    }
+        return !isempty(list_included_files(path));
+    };
+
+    // Reprocesses a single changed (or deleted) file in place instead of the
+    // whole package, and updates the package hash by swapping out the file's
+    // old hash for its new one. Only handles the common case of a file we
+    // already have in a ready package; returns false if the caller should
+    // fall back to mark_package_for_reprocessing().
+    auto reindex_single_file = [&](ccstr filepath) -> bool {
+        auto import_path = filepath_to_import_path(cp_dirname(filepath));
+        if (!import_path) return false;
+
+        auto pkg = find_package_in_index(import_path);
+        if (!pkg || pkg->status != GPS_READY) return false;
+        if (packages_in_flight.has(import_path)) return false;
+
+        load_package_files(pkg);
+        if (!pkg->files) return false;
+
+        auto filename = cp_basename(filepath);
+        auto file = pkg->files->find([&](auto it) { return streq(it->filename, filename); });
+        if (!file) return false;
+
+        Timer t; t.init();
+
+        // fast path for the hash scan, same as with a full reprocess
+        pkg->fingerprint = fingerprint_package(cp_dirname(filepath));
+
+        if (check_path(filepath) != CPR_FILE) {
+            pkg->hash ^= file->hash;
+
+            // same as get_ready_file_in_package(), leave the old list alone
+            auto old_files = pkg->files;
+            {
+                SCOPED_MEM(get_package_pool(pkg));
+                pkg->files = new_list(Go_File, old_files->len);
+            }
+            For (old_files)
+                if (&it != file)
+                    pkg->files->append(&it);
+
+            if (file->use_pool)
+                if (!pkg->lazy_files || !pkg->lazy_files->owns(file))
+                    retire_pool(file->pool);
+
+            pkg->disk_offset = 0;
+            pkg->disk_len = 0;
+            invalidate_decl_table(pkg);
+            rebuild_symbols(pkg);
+            update_call_edges(pkg, filename);
+            bump_package_generation(pkg);
+            snapshot_dirty = true;
+            index_print("Removed %s from %s.", filename, import_path);
             return true;
-        });
-        return ret;
+        }
+
+        // build constraints might have changed, let the package sort it out
+        if (!is_file_included_in_build(filepath)) return false;
+
+        auto old_hash = file->hash;
+        if (hash_file(filepath) == old_hash) return true;
+
+        auto pf = parse_file(filepath, LANG_GO);
+        if (!pf) return false;
+        defer { free_parsed_file(pf); };
+
+        file = get_ready_file_in_package(pkg, filename);
+
+        ccstr package_name = NULL;
+        process_tree_into_gofile(file, pf->root, filepath, &package_name, get_file_pool(pkg, file));
+        if (!str_ends_with(filename, "_test.go"))
+            replace_package_name(pkg, package_name);
+        add_reference_names(pkg, file);
+        add_method_sets(pkg, file);
+        rebuild_symbols(pkg);
+        rebuild_decl_table(pkg);
+        update_call_edges(pkg, filename);
+
+        pkg->hash ^= old_hash ^ file->hash;
+        enqueue_imports_from_file(file);
+
+        index_print("Reprocessed %s in %s in %dms.", filename, import_path, t.read_total() / 1000000);
+        return true;
     };
 
     auto rebuild_package_lookup = [&]() {
@@ -1155,10 +2444,11 @@ void Go_Indexer::background_thread() {
         start_writing();
         defer { stop_writing(); };
 
-        pkg->cleanup();
+        retire_package(pkg);
         index.packages->remove(pkg);
 
         rebuild_package_lookup();
+        snapshot_dirty = true;
     };
 
     // random shit
@@ -1166,18 +2456,28 @@ void Go_Indexer::background_thread() {
     // try to read in index from disk
     // ===
 
+    // size of the .cpdb, and how much of it the current directory points to;
+    // the rest is left over from earlier appends
+    i64 index_file_len = 0;
+    i64 index_live_bytes = 0;
+
+    if (build_cache.read(path_join(core.current_path, ".cpdb.build")))
+        index_print("Read build constraint cache.");
+
     do {
         index_print("Reading existing database...");
 
-        auto index_file = path_join(world.current_path, ".cpdb");
+        auto index_file = path_join(core.current_path, ".cpdb");
 
-        Index_Stream s;
+        auto &s = index_source;
         if (!s.open(index_file)) {
             index_print("No database found (or couldn't open).");
             break;
         }
 
-        defer { s.cleanup(); };
+        // stays open for load_package_files() if everything goes well
+        index_source_open = true;
+        s.atom_map = &index_atom_map;
 
         {
             SCOPED_MEM(&final_mem);
@@ -1185,6 +2485,7 @@ void Go_Indexer::background_thread() {
             auto obj = s.read_index();
             if (!s.ok) {
                 index_print("Unable to read database file.");
+                close_index_source();
                 delete_file(index_file);
                 break;
             }
@@ -1192,8 +2493,14 @@ void Go_Indexer::background_thread() {
             memcpy(&index, obj, sizeof(Go_Index));
         }
 
+        index_file_len = s.fm->len;
+        index_live_bytes = s.live_bytes;
+
         check_duplicate_packages();
 
+        // generations aren't saved, they only mean anything to eval_cache
+        For (index.packages) bump_package_generation(&it);
+
 #ifdef DEBUG_BUILD
         index_print("Successfully read database from disk, final_mem.size = %d", final_mem.mem_allocated);
 #else
@@ -1243,18 +2550,37 @@ void Go_Indexer::background_thread() {
     init_index(false);
     rebuild_package_lookup();
 
-    auto rescan_gomod = [&](bool force_reset_index) {
-        start_writing();
-        defer { stop_writing(); };
+    // readers can start now
+    publish_snapshot();
 
+    // Caller is in enter_exclusive(), since module_resolver and the
+    // workspace get replaced out from under readers.
+    auto reset_module_resolver = [&](bool force_reset_index) {
         module_resolver.cleanup();
-        module_resolver.init(world.current_path, gomodcache);
+        module_resolver.init(core.current_path, gomodcache);
         init_index(force_reset_index);
+        rebuild_package_lookup();
     };
 
-    auto rescan_everything = [&]() {
-        package_queue.len = 0;
-        already_enqueued_packages.clear();
+    auto rescan_gomod = [&](bool force_reset_index) {
+        start_writing();
+        defer { stop_writing(); };
+
+        enter_exclusive();
+        defer { leave_exclusive(); };
+
+        reset_module_resolver(force_reset_index);
+    };
+
+    // find_up_to_date_package() reads in the package's files, which we don't
+    // need just to check whether it's there
+    auto is_package_up_to_date = [&](ccstr import_path) {
+        auto pkg = find_package_in_index(import_path);
+        return pkg && pkg->status != GPS_OUTDATED;
+    };
+
+    auto rescan_everything = [&]() {
+        package_queue.clear();
 
         // make sure workspace is in index or queue
         // ===
@@ -1273,16 +2599,14 @@ void Go_Indexer::background_thread() {
                 auto import_path = import_paths_queue->pop();
                 auto resolved_path = resolved_paths_queue->pop();
 
-                bool already_in_index = (find_up_to_date_package(import_path));
-                bool is_go_package = false;
+                bool already_in_index = is_package_up_to_date(import_path);
+                bool has_go_files = false;
 
                 list_directory(resolved_path, [&](Dir_Entry *ent) {
                     do {
                         if (ent->type == DIRENT_FILE) {
-                            if (!already_in_index && !is_go_package)
-                                if (str_ends_with(ent->name, ".go") || streq(ent->name, "go.mod"))
-                                    if (is_file_included_in_build(path_join(resolved_path, ent->name)))
-                                        is_go_package = true;
+                            if (str_ends_with(ent->name, ".go"))
+                                has_go_files = true;
                             break;
                         }
 
@@ -1296,15 +2620,16 @@ void Go_Indexer::background_thread() {
                     return true;
                 });
 
-                if (!already_in_index && is_go_package)
-                    enqueue_package(import_path);
+                if (!already_in_index && has_go_files)
+                    if (is_go_package(resolved_path))
+                        enqueue_package(import_path);
             }
         }
 
         // queue up builtins
         // ===
 
-        if (!find_up_to_date_package("@builtin"))
+        if (!is_package_up_to_date("@builtin"))
             enqueue_package("@builtin");
 
         // if we have any ready packages, see if they have any imports that were missed
@@ -1321,6 +2646,8 @@ void Go_Indexer::background_thread() {
                     continue;
                 }
 
+                // packages that haven't been read in yet had all their
+                // imports processed before the index was written
                 if (pkg.files)
                     For (pkg.files)
                         enqueue_imports_from_file(&it);
@@ -1334,11 +2661,19 @@ void Go_Indexer::background_thread() {
 
     rescan_everything(); // kick off rescan
 
-    auto handle_fsevent = [&](ccstr filepath) {
-        filepath = path_join(world.current_path, filepath);
+    // Set while processing messages, and handled after, since these wait on
+    // readers and we don't want to hold up the message queue.
+    bool rescan_this_time = false;
+    bool obliterate_this_time = false;
+
+    // returns whether a file was reindexed in place
+    auto handle_fsevent = [&](ccstr filepath) -> bool {
+        filepath = path_join(core.current_path, filepath);
 
         auto import_path = filepath_to_import_path(filepath);
-        if (!import_path) return;
+        if (!import_path) return false;
+
+        bool reindexed = false;
 
         switch (check_path(filepath)) {
         case CPR_DIRECTORY:
@@ -1350,11 +2685,13 @@ void Go_Indexer::background_thread() {
         case CPR_FILE: {
             if (is_go_package(cp_dirname(filepath)) && str_ends_with(filepath, ".go")) {
                 start_writing(true);
-                mark_package_for_reprocessing(cp_dirname(import_path));
+                reindexed = reindex_single_file(filepath);
+                if (!reindexed)
+                    mark_package_for_reprocessing(cp_dirname(import_path));
             }
 
             auto workspace_changed = [&]() {
-                if (are_filepaths_equal(filepath, path_join(world.current_path, "go.work")))
+                if (are_filepaths_equal(filepath, path_join(core.current_path, "go.work")))
                     return true;
                 For (index.workspace->modules)
                     if (streq(filepath, path_join(it.resolved_path, "go.mod")))
@@ -1362,11 +2699,8 @@ void Go_Indexer::background_thread() {
                 return false;
             };
 
-            if (status == IND_READY && workspace_changed()) {
-                start_writing();
-                rescan_gomod(false);
-                rescan_everything();
-            }
+            if (workspace_changed())
+                rescan_this_time = true;
             break;
         }
         case CPR_NONEXISTENT: {
@@ -1379,11 +2713,15 @@ void Go_Indexer::background_thread() {
             pkg = find_package_in_index(cp_dirname(import_path));
             if (pkg) {
                 start_writing(true);
-                mark_package_for_reprocessing(pkg->import_path);
+                reindexed = reindex_single_file(filepath);
+                if (!reindexed)
+                    mark_package_for_reprocessing(pkg->import_path);
             }
             break;
         }
         }
+
+        return reindexed;
     };
 
     // main loop
@@ -1394,11 +2732,192 @@ void Go_Indexer::background_thread() {
     int packages_processed_since_last_write = 0;
     ccstr last_package_processed = NULL;
     u64 last_hash_check = MAX_U64;
+    u64 batch_start_time = 0;
+    int batch_packages_processed = 0;
+
+    // Swaps the worker's result into the index. Everything expensive already
+    // happened on the worker, this is just moving pointers around.
+    auto publish_job = [&](Index_Job *job) {
+        packages_in_flight.remove(job->import_path);
+
+        auto pkg = find_package_in_index(job->import_path);
+
+        if (job->empty) {
+            if (pkg) remove_package(pkg);
+            packages_dirtied_in_flight.remove(job->import_path);
+            return;
+        }
+
+        check_duplicate_packages();
+
+        if (pkg) {
+            retire_package(pkg);
+        } else {
+            auto idx = index.packages->len;
+            pkg = index.packages->append();
+
+            SCOPED_MEM(&package_lookup_mem);
+            package_lookup.set(cp_strdup(job->import_path), idx);
+        }
+
+        pkg->disk_offset = 0;
+        pkg->disk_len = 0;
+        pkg->lazy_files = NULL;
+        pkg->last_used_milli = NULL;
+        pkg->reference_names_pool = NULL;
+        pkg->method_sets_pool = NULL;
+        pkg->call_edges = NULL;
+        pkg->call_edges_pool = NULL;
+        pkg->symbols = NULL;
+        pkg->symbols_pool = NULL;
+        pkg->decl_table = NULL;
+        pkg->decl_table_pool = NULL;
+
+        pkg->use_pool = job->use_pool;
+        if (pkg->use_pool) {
+            pkg->pool = job->pool;
+
+            SCOPED_MEM(pkg->pool);
+            pkg->files = job->files;
+            pkg->import_path = go_intern(job->import_path);
+        } else {
+            pkg->pool = NULL;
+
+            SCOPED_MEM(&final_mem);
+            pkg->files = new_list(Go_File, job->files->len);
+            For (job->files) pkg->files->append(&it);
+            pkg->import_path = go_intern(job->import_path);
+        }
+
+        pkg->package_name = NULL;
+        replace_package_name(pkg, job->package_name);
+        rebuild_reference_names(pkg);
+        rebuild_method_sets(pkg);
+        rebuild_symbols(pkg);
+        rebuild_decl_table(pkg);
+        pkg->hash = job->hash;
+        pkg->fingerprint = job->fingerprint;
+        pkg->status = GPS_READY;
+        pkg->checked_for_outdated_hash = true;
+        pkg->in_workspace = index_has_module_containing(pkg->import_path);
+        pkg->in_goroot = job->resolved_path && path_has_descendant(goroot, job->resolved_path);
+        bump_package_generation(pkg);
+
+        check_duplicate_packages();
+        snapshot_dirty = true;
+
+        if (editor_packages.has(pkg->import_path))
+            add_editor_imports(pkg);
+
+        For (pkg->files) enqueue_imports_from_file(&it);
+
+        if (packages_dirtied_in_flight.has(job->import_path)) {
+            packages_dirtied_in_flight.remove(job->import_path);
+            pkg->status = GPS_OUTDATED;
+            enqueue_package(job->import_path);
+        }
+
+        if (!last_package_processed || !streq(job->import_path, last_package_processed)) {
+            SCOPED_MEM(&mem);
+            last_package_processed = cp_strdup(job->import_path);
+            packages_processed_since_last_write++;
+        }
+        batch_packages_processed++;
+
+        metrics.add_job(job);
+        index_print("Processed %s in %dms%s.", job->import_path, job->time_taken / 1000000, job->from_shared_cache ? " (shared cache)" : "");
+    };
+
+    // scratch_mem gets thrown out every iteration, so keep its high water mark
+    u64 scratch_mem_peak = 0;
+    bool last_sample_idle = true;
+
+    auto sample_metrics = [&]() {
+        bool idle = !package_queue.len && !workers.busy();
+
+        // an extra sample when things settle down, so it ends at zero
+        auto now = current_time_milli();
+        if (now - metrics.last_sample_milli < INDEX_METRICS_SAMPLE_MILLI)
+            if (!idle || last_sample_idle)
+                return;
+
+        last_sample_idle = idle;
+        metrics.add_queue_sample(package_queue.len, workers.outstanding);
+
+        u64 package_bytes = 0;
+        if (index.packages)
+            For (index.packages)
+                package_bytes += it.mem_allocated();
+
+        u64 eval_hits, eval_misses, eval_stale;
+        {
+            SCOPED_LOCK(&eval_cache.lock);
+            eval_hits = eval_cache.hits;
+            eval_misses = eval_cache.misses;
+            eval_stale = eval_cache.stale;
+        }
+
+        SCOPED_LOCK(&metrics.lock);
+
+        metrics.last_sample_milli = now;
+        metrics.eval_cache_hits = eval_hits;
+        metrics.eval_cache_misses = eval_misses;
+        metrics.eval_cache_stale = eval_stale;
+        metrics.num_pools = 0;
+
+        auto add = [&](ccstr name, u64 bytes) {
+            if (metrics.num_pools >= INDEX_METRICS_MAX_POOLS) return;
+            auto &it = metrics.pools[metrics.num_pools++];
+            it.name = name;
+            it.bytes = bytes;
+        };
+
+        add("mem", mem.mem_allocated);
+        add("final_mem", final_mem.mem_allocated);
+        add("package_pools", package_bytes);
+        add("index_pools_mem", index_pools_mem.mem_allocated);
+        add("package_lookup_mem", package_lookup_mem.mem_allocated);
+        add("snapshot_mem", snapshot ? snapshot->mem.mem_allocated : 0);
+        add("thread_mem", thread_mem.mem_allocated);
+        add("editors_mem", editors_mem.mem_allocated);
+        add("scratch_mem", scratch_mem_peak);
+        add("eval_cache_mem", eval_cache.mem.mem_allocated);
+        add("build_cache_mem", build_cache.mem.mem_allocated);
+
+        scratch_mem_peak = 0;
+    };
 
     index_print("Entering main loop...");
 
     bool try_write_after_checking_hashes = false;
-    for (;; sleep_milli(100)) {
+
+    // Set when an iteration leaves work for the next one (e.g. the hash scan
+    // only checks so many packages at a time). Otherwise we sleep until the
+    // main thread sends a message or a worker finishes a package.
+    bool more_to_do = false;
+
+    auto wait_for_work = [&]() {
+        if (more_to_do) {
+            more_to_do = false;
+            yield_write_lock();
+        } else {
+            // if there's an unpublished change, come back in time to publish
+            // it; if we're over budget, to evict whatever's gone cold
+            u32 timeout = 0;
+            if (snapshot_dirty)
+                timeout = INDEX_SNAPSHOT_INTERVAL_MILLI;
+            if (over_memory_budget)
+                if (!timeout || timeout > INDEX_EVICTION_CHECK_MILLI)
+                    timeout = INDEX_EVICTION_CHECK_MILLI;
+
+            leave_write_lock();
+            message_queue.wait(timeout);
+            enter_write_lock();
+        }
+        reclaim_retired();
+    };
+
+    for (;; wait_for_work()) {
         // SCOPED_FRAME(); // does this work? lol
 
         bool try_write_this_time = false;
@@ -1410,32 +2929,11 @@ void Go_Indexer::background_thread() {
         auto process_message = [&](auto msg) {
             switch (msg->type) {
             case GOMSG_RESCAN_INDEX:
-                if (status != IND_READY) break;
-                start_writing();
-                rescan_gomod(false);
-                rescan_everything();
+                rescan_this_time = true;
                 break;
 
             case GOMSG_OBLITERATE_AND_RECREATE_INDEX:
-                if (status != IND_READY) {
-                    if (status == IND_WRITING) {
-                        while (reacquires > 0)
-                            stop_writing();
-                    } else {
-                        break;
-                    }
-                }
-
-                cp_assert(status == IND_READY);
-
-                start_writing();
-                delete_file(path_join(world.current_path, ".cpdb"));
-                package_lookup.clear();
-                index.cleanup();
-                final_mem.cleanup();
-                final_mem.init("final_mem");
-                rescan_gomod(true);
-                rescan_everything();
+                obliterate_this_time = true;
                 break;
 
             case GOMSG_CLEANUP_UNUSED_MEMORY:
@@ -1443,87 +2941,145 @@ void Go_Indexer::background_thread() {
                 break;
 
             case GOMSG_FSEVENT:
-                handle_fsevent(msg->fsevent_filepath);
+                if (handle_fsevent(msg->fsevent_filepath)) {
+                    // nothing goes through the queue, so make sure this
+                    // still gets written out
+                    packages_processed_since_last_write++;
+                    try_write_after_checking_hashes = true;
+                }
+                break;
+
+            case GOMSG_EDITORS_CHANGED:
+                set_editor_filepaths(msg->editor_filepaths);
                 break;
             }
         };
 
+        rescan_this_time = false;
+        obliterate_this_time = false;
+
         {
             auto msgs = message_queue.start();
             For (msgs) process_message(&it);
             message_queue.end();
         }
 
-        // process items in queue
+        if (obliterate_this_time) {
+            while (reacquires > 0)
+                stop_writing();
+
+            start_writing();
+
+            enter_exclusive();
+            {
+                close_index_source();
+                delete_file(path_join(core.current_path, ".cpdb"));
+                delete_file(path_join(core.current_path, ".cpdb.build"));
+                build_cache.clear();
+                eval_cache.clear();
+
+                For (workers.drain()) free_index_job(it, false);
+                packages_in_flight.clear();
+                packages_dirtied_in_flight.clear();
+
+                // nobody's reading, so everything can go right away
+                {
+                    SCOPED_LOCK(&lock);
+                    retired_published = retired.len;
+                }
+                reclaim_retired();
+
+                package_lookup.clear();
+                index.cleanup();
+                final_mem.cleanup();
+                final_mem.init("final_mem");
+                index_pools_mem.cleanup();
+                index_pools_mem.init("index_pools_mem");
+                reset_module_resolver(true);
+            }
+            leave_exclusive();
+
+            rescan_everything();
+        } else if (rescan_this_time && status != IND_WRITING) {
+            start_writing();
+            rescan_gomod(false);
+            rescan_everything();
+        }
+
+        // hand packages in queue off to workers, publish what they finish
         // ---
 
-        bool queue_had_stuff = (package_queue.len > 0);
+        bool queue_had_stuff = (package_queue.len > 0 || workers.busy());
 
         Pool scratch_mem;
         scratch_mem.init("scratch_mem");
 
-        for (int items_processed = 0; items_processed < 10 && package_queue.len > 0; items_processed++) {
+        while (package_queue.len > 0 && workers.can_take_more()) {
             scratch_mem.reset();
             SCOPED_MEM(&scratch_mem);
 
-            // pop package from end of queue
-            ccstr import_path = NULL;
-            {
-                import_path = package_queue.pop();
-                already_enqueued_packages.remove(import_path);
-            }
+            // whatever the user needs most
+            auto import_path = package_queue.pop();
+
+            // if it got marked again, it'll be re-enqueued when the current
+            // job is published
+            if (packages_in_flight.has(import_path))
+                continue;
 
             auto pkg = find_package_in_index(import_path);
             if (pkg && pkg->status == GPS_READY) // already been processed
                 continue;
 
-            // we defer this, because in case we don't find any files,
-            // we don't actually want to create the package
-            auto get_ready_package = [&]() {
+            if (streq(import_path, "@builtin")) {
                 check_duplicate_packages();
 
                 if (pkg) {
-                    if (pkg->use_pool) {
-                        pkg->pool->cleanup();
-                        pkg->pool->init("go_package");
-                        pkg->pool->disable_alignment = true;
-                    }
+                    retire_package(pkg);
                 } else {
                     auto idx = index.packages->len;
                     pkg = index.packages->append();
-                    pkg->use_pool = !index_has_module_containing(import_path);
-                    if (pkg->use_pool) {
-                        SCOPED_MEM(&final_mem);
-                        pkg->pool = new_object(Pool);
-                        pkg->pool->init("go_package");
-                        pkg->pool->disable_alignment = true;
-                    }
 
-                    {
-                        SCOPED_MEM(&package_lookup_mem);
-                        package_lookup.set(cp_strdup(import_path), idx);
-                    }
+                    SCOPED_MEM(&package_lookup_mem);
+                    package_lookup.set(cp_strdup(import_path), idx);
                 }
 
+                pkg->use_pool = true;
+                pkg->pool = new_index_pool("go_package");
+                pkg->lazy_files = NULL;
+                pkg->last_used_milli = NULL;
+                pkg->reference_names = NULL;
+                pkg->reference_names_pool = NULL;
+                pkg->method_sets = NULL;
+                pkg->method_postings = NULL;
+                pkg->method_sets_pool = NULL;
+                pkg->call_edges = NULL;
+                pkg->call_edges_pool = NULL;
+                pkg->symbols = NULL;
+                pkg->symbols_pool = NULL;
+                pkg->decl_table = NULL;
+                pkg->decl_table_pool = NULL;
+
                 {
                     SCOPED_MEM(get_package_pool(pkg));
-                    pkg->status = GPS_OUTDATED;
                     pkg->files = new_list(Go_File);
-                    pkg->import_path = cp_strdup(import_path);
+                    pkg->import_path = go_intern(import_path);
+                    pkg->package_name = NULL;
                 }
 
-                check_duplicate_packages();
-            };
+                pkg->disk_offset = 0;
+                pkg->disk_len = 0;
 
-            if (streq(import_path, "@builtin")) {
-                get_ready_package();
                 pkg->status = GPS_UPDATING; // i don't think we actually need this anymore...
 
                 init_builtins(pkg);
+                rebuild_decl_table(pkg);
                 fill_package_hash(pkg);
 
                 pkg->status = GPS_READY;
                 pkg->checked_for_outdated_hash = true;
+                snapshot_dirty = true;
+
+                check_duplicate_packages();
                 continue;
             }
 
@@ -1534,72 +3090,43 @@ void Go_Indexer::background_thread() {
                 continue;
             }
 
-            Timer t; t.init();
-
-            auto source_files = list_source_files(resolved_path, true);
-            if (isempty(source_files)) {
-                if (pkg) remove_package(pkg);
-                continue;
+            if (!workers.busy()) {
+                batch_start_time = current_time_nano();
+                batch_packages_processed = 0;
             }
 
-            get_ready_package();
-            pkg->status = GPS_UPDATING;
+            bool use_pool = pkg ? pkg->use_pool : !index_has_module_containing(import_path);
+            auto job = new_index_job(import_path, resolved_path, use_pool);
 
-            ccstr package_name = NULL;
-            ccstr test_package_name = NULL;
-
-            For (source_files) {
-                auto filename = it;
-
-                // TODO: refactor, pretty sure we're doing same thing elsewhere
-
-                SCOPED_FRAME();
-
-                auto filepath = path_join(resolved_path, filename);
-
-                auto pf = parse_file(filepath, LANG_GO);
-                if (!pf) continue;
-                defer { free_parsed_file(pf); };
-
-                auto file = get_ready_file_in_package(pkg, filename);
-
-                ccstr pkgname = NULL;
-                process_tree_into_gofile(file, pf->root, filepath, &pkgname, get_file_pool(pkg, file));
-
-                if (pkgname) {
-                    SCOPED_MEM(&final_mem);
-                    if (str_ends_with(filename, "_test.go")) {
-                        if (!test_package_name)
-                            test_package_name = cp_strdup(pkgname);
-                    } else {
-                        if (!package_name)
-                            package_name = cp_strdup(pkgname);
-                    }
-                }
-
-                enqueue_imports_from_file(file);
+            {
+                SCOPED_MEM(&thread_mem);
+                packages_in_flight.add(cp_strdup(import_path));
             }
+            workers.submit(job);
+        }
 
-            if (!package_name) package_name = test_package_name;
-            replace_package_name(pkg, package_name);
-
-            fill_package_hash(pkg);
-
-            pkg->status = GPS_READY;
-            pkg->checked_for_outdated_hash = true;
+        {
+            scratch_mem.reset();
+            SCOPED_MEM(&scratch_mem);
 
-            if (!last_package_processed || !streq(import_path, last_package_processed)) {
-                SCOPED_MEM(&mem);
-                last_package_processed = cp_strdup(import_path);
-                packages_processed_since_last_write++;
+            For (workers.collect_finished()) {
+                publish_job(it);
+                free_index_job(it, true);
+                yield_write_lock();
             }
-
-            index_print("Processed %s in %dms.", import_path, t.read_total() / 1000000);
         }
 
+        scratch_mem_peak = max(scratch_mem_peak, scratch_mem.mem_allocated);
         scratch_mem.cleanup();
 
-        if (!package_queue.len) {
+        if (queue_had_stuff && !package_queue.len && !workers.busy() && batch_packages_processed > 0) {
+            auto secs = (current_time_nano() - batch_start_time) / 1000000000.0;
+            if (secs > 0)
+                index_print("Processed %d packages in %.2fs (%.1f packages/sec, %d workers).", batch_packages_processed, secs, batch_packages_processed / secs, workers.threads.len);
+            batch_packages_processed = 0;
+        }
+
+        if (!package_queue.len && !workers.busy()) {
             int i = 0;
             int num_checked = 0;
 
@@ -1611,6 +3138,10 @@ void Go_Indexer::background_thread() {
             auto to_remove = new_list(int);
 
             for (; i < index.packages->len && num_checked < 50; i++) {
+                // editors don't add or remove packages, so i and to_remove
+                // still line up after this
+                yield_write_lock();
+
                 auto &it = index.packages->at(i);
 
                 if (it.status != GPS_READY) continue;
@@ -1639,18 +3170,27 @@ void Go_Indexer::background_thread() {
                 auto package_path = get_package_path(it.import_path);
                 if (!package_path) continue;
 
+                auto fingerprint = fingerprint_package(package_path);
+                if (fingerprint && fingerprint == it.fingerprint) continue;
+
                 auto hash = hash_package(package_path);
                 if (!hash) {
                     // path no longer exists, so remove it
                     to_remove->append(i);
                     continue;
                 }
-                if (it.hash == hash) continue;
+
+                if (it.hash == hash) {
+                    // something got touched without changing, e.g. saved
+                    // with no edits; remember that so we don't hash it again
+                    it.fingerprint = fingerprint;
+                    continue;
+                }
 
                 // hash changed, mark outdated & queue for re-processing
                 mark_package_for_reprocessing(it.import_path);
             }
-            bool done = (i == index.packages->len && !package_queue.len);
+            bool done = (i == index.packages->len && !package_queue.len && !workers.busy());
 
             int offset = 0;
             For (to_remove) {
@@ -1658,6 +3198,8 @@ void Go_Indexer::background_thread() {
                 offset++;
             }
 
+            if (!done) more_to_do = true;
+
             if (done) {
                 if (try_write_after_checking_hashes) {
                     index_print("Finished scanning packages.");
@@ -1669,6 +3211,13 @@ void Go_Indexer::background_thread() {
             }
         }
 
+        // resolve call edges for the caller/callee hierarchy while idle
+        // ---
+
+        if (!package_queue.len && !workers.busy() && !more_to_do)
+            if (resolve_call_edges(CALL_EDGES_BUDGET_MILLI))
+                more_to_do = true;
+
         // clean up memory if it's getting out of control
         // ---
 
@@ -1688,6 +3237,11 @@ void Go_Indexer::background_thread() {
 
             {
                 SCOPED_MEM(&new_pool);
+
+                auto old = copy_into_index;
+                copy_into_index = true;
+                defer { copy_into_index = old; };
+
                 new_index = index.copy();
             }
 
@@ -1710,6 +3264,15 @@ void Go_Indexer::background_thread() {
         }
         */
 
+        // publish a new snapshot for readers
+        // ---
+
+        if (snapshot_dirty) {
+            bool idle = !package_queue.len && !workers.busy();
+            if (idle || current_time_milli() - last_publish_milli >= INDEX_SNAPSHOT_INTERVAL_MILLI)
+                publish_snapshot();
+        }
+
         // write index to disk
         // ---
 
@@ -1717,6 +3280,7 @@ void Go_Indexer::background_thread() {
 
         do {
             if (package_queue.len > 0) break;
+            if (workers.busy()) break;
             if (!try_write_this_time) break;
 
             defer {
@@ -1750,109 +3314,788 @@ void Go_Indexer::background_thread() {
             Timer t;
             t.init();
 
+            auto index_file = path_join(core.current_path, ".cpdb");
+            auto tmp_file = path_join(core.current_path, ".cpdb.tmp");
+
+            // Append changed packages to the existing file while most of it
+            // is still in use, otherwise rewrite the whole thing into
+            // .cpdb.tmp and move it over.
+            bool append = index_source_open && !index_file_needs_compaction(index_file_len, index_live_bytes);
+
+            // Write from a snapshot so we can let go of the write lock (and
+            // let the main thread reload editors) while the write happens.
+            // Holding a read on it keeps it from being reclaimed.
+            publish_snapshot();
+            auto snap = snapshot;
+            if (!acquire_lock(IND_READING)) break;
+            defer { release_lock(IND_READING); };
+
+            Pool write_mem;
+            write_mem.init("index_write_mem");
+            defer { write_mem.cleanup(); };
+
+            auto snap_packages = snap->index.packages;
+
+            i64 *offsets = NULL;
+            i64 *lens = NULL;
             {
+                SCOPED_MEM(&write_mem);
+                offsets = new_array(i64, snap_packages->len);
+                lens = new_array(i64, snap_packages->len);
+            }
+
+            i64 bytes_written = 0;
+
+            // A rewrite can start the atom ids over, unless it has to copy
+            // over files that still use the old ones.
+            bool keep_atom_ids = false;
+            For (snap_packages) {
+                if (it.needs_loading() && !it.lazy_files->files) {
+                    keep_atom_ids = true;
+                    break;
+                }
+            }
+
+            // index_atom_map is still in use by load_package_files() until
+            // the new file is in place, so write with a copy of it
+            Go_Atom_Map atom_map;
+            atom_map.init();
+            defer { atom_map.cleanup(); };
+
+            auto write_to = [&](ccstr path, bool append) -> bool {
+                atom_map.cleanup();
+                atom_map.init();
+                if (append || keep_atom_ids)
+                    atom_map.copy_from(&index_atom_map);
+
                 Index_Stream s;
-                if (!s.open(path_join(world.current_path, ".cpdb.tmp"), true)) {
+                if (!s.open(path, true, append)) {
                     index_print("Unable to open database file for writing.");
-                    break;
+                    return false;
                 }
                 defer { s.cleanup(); };
+                s.atom_map = &atom_map;
 
-                s.write_index(&index);
-                s.finish_writing();
-            }
+                if (!s.write_index(&snap->index, index_source_open ? &index_source : NULL, offsets, lens)) {
+                    index_print("Unable to write database file.");
+                    return false;
+                }
 
-            if (!move_file_atomically(path_join(world.current_path, ".cpdb.tmp"), path_join(world.current_path, ".cpdb"))) {
-                index_print("Unable to commit new database file, error: %s", get_last_error());
-                break;
+                bytes_written = s.bytes_written;
+                index_live_bytes = s.live_bytes;
+                return true;
+            };
+
+            bool committed = false;
+            {
+                leave_write_lock();
+                defer { enter_write_lock(); };
+
+                if (append) {
+                    // if this fails, the header still points at the old
+                    // directory, so just try a full rewrite
+                    if (!write_to(index_file, true))
+                        append = false;
+                }
+
+                if (!append) {
+                    if (write_to(tmp_file, false)) {
+                        if (move_file_atomically(tmp_file, index_file))
+                            committed = true;
+                        else
+                            index_print("Unable to commit new database file, error: %s", get_last_error());
+                    }
+                } else {
+                    committed = true;
+                }
             }
 
-            index_print("Finished writing (took %d ms).", t.read_time() / 1000000);
-        } while (0);
-    }
-}
+            if (!committed) break;
 
-bool Go_Indexer::start_background_thread() {
-    SCOPED_MEM(&mem);
-    auto fn = [](void* param) {
-        auto indexer = (Go_Indexer*)param;
-        indexer->background_thread();
-    };
-    return (bgthread = create_thread(fn, this));
-}
+            bool reopened = false;
+            {
+                SCOPED_LOCK(&index_source_lock);
 
-TSLanguage *get_ts_language(Parse_Lang lang) {
-    switch (lang) {
-    case LANG_GO: return tree_sitter_go();
-    case LANG_GOMOD: return tree_sitter_gomod();
-    case LANG_GOWORK: return tree_sitter_gowork();
-    }
-    return NULL;
-}
+                // a rewrite moves everything, so fence off loads that were
+                // going to read from the old offsets
+                if (!append) index_source_generation++;
 
-TSParser *new_ts_parser(Parse_Lang lang) {
-    auto tslang = get_ts_language(lang);
-    if (!tslang) return NULL;
+                auto old_map = index_atom_map;
+                index_atom_map = atom_map;
+                atom_map = old_map;
 
-    auto parser = ts_parser_new();
-    ts_parser_set_language(parser, tslang);
-    return parser;
-}
+                // packages in the snapshot that are still lazy now live at
+                // their new offsets
+                Fori (snap_packages) {
+                    if (it.files) continue;
+                    if (!it.lazy_files || it.lazy_files->files) continue;
 
-Parsed_File *parse_file(ccstr filepath, Parse_Lang lang, bool use_latest) {
-    Parsed_File *ret = NULL;
+                    it.lazy_files->offset = offsets[i];
+                    it.lazy_files->len = lens[i];
+                    it.lazy_files->generation = index_source_generation;
+                }
 
-    if (use_latest) {
-        auto editor = find_editor_by_filepath(filepath);
-        if (!editor) return NULL;
-        if (!editor->buf->tree) return NULL;
+                reopened = reopen_index_source();
+            }
 
-        auto it = new_object(Parser_It);
-        it->init(editor->buf);
+            if (!reopened) {
+                // only happens if the file went away under us
+                index_print("Unable to reopen database file.");
+                close_index_source();
+            }
 
-        ret = new_object(Parsed_File);
-        ret->tree_belongs_to_editor = true;
-        ret->editor_parser = editor->buf->parser;
-        ret->it = it;
-        ret->tree = ts_tree_copy(editor->buf->tree);
-    } else {
-        auto fm = map_file_into_memory(filepath);
-        if (!fm) return NULL;
+            // Only take the new offsets for packages that haven't changed
+            // since the snapshot, the rest get written out next time.
+            Fori (snap_packages) {
+                auto pkg = find_package_in_index(it.import_path);
+                if (!pkg) continue;
 
-        auto it = new_object(Parser_It);
-        it->init(fm);
+                if (pkg->loaded_files() == it.loaded_files() && pkg->lazy_files == it.lazy_files) {
+                    pkg->disk_offset = offsets[i];
+                    pkg->disk_len = lens[i];
+                } else {
+                    pkg->disk_offset = 0;
+                    pkg->disk_len = 0;
+                }
+            }
 
-        Parser_Input pinput;
-        pinput.it = it;
+            index_file_len = index_source_open ? index_source.fm->len : 0;
 
-        TSInput input;
-        input.payload = &pinput;
-        input.encoding = TSInputEncodingUTF8;
-        input.read = read_from_parser_input;
+            if (build_cache.dirty)
+                if (!build_cache.write(path_join(core.current_path, ".cpdb.build")))
+                    index_print("Unable to write build constraint cache.");
 
-        auto parser = new_ts_parser(lang);
-        if (!parser) return NULL;
-        defer { ts_parser_delete(parser); };
+            auto nanos = t.read_time();
+            metrics.add_write(nanos);
 
-        auto tree = ts_parser_parse(parser, NULL, input);
-        if (!tree) return NULL;
+            index_print(
+                "Finished writing (%s %lld bytes, took %d ms).",
+                append ? "appended" : "rewrote",
+                bytes_written,
+                nanos / 1000000
+            );
+        } while (0);
 
-        ret = new_object(Parsed_File);
-        ret->tree_belongs_to_editor = false;
-        ret->editor_parser = NULL;
-        ret->it = pinput.it;
-        ret->tree = tree;
+        evict_cold_packages();
+
+        sample_metrics();
+
+        // don't go to sleep holding the write lock with nothing in flight
+        if (status == IND_WRITING && !package_queue.len && !workers.busy())
+            more_to_do = true;
+
+        if (!more_to_do && !package_queue.len && !workers.busy() && !finished_initial_index) {
+            SCOPED_LOCK(&lock);
+            finished_initial_index = true;
+            finished_initial_index_cond.broadcast();
+        }
     }
+}
 
-    ret->root = new_ast_node(ts_tree_root_node(ret->tree), ret->it);
+Pool *Go_Indexer::new_index_pool(ccstr name) {
+    Pool *ret = NULL;
+    {
+        SCOPED_LOCK(&index_pools_lock);
+        SCOPED_MEM(&index_pools_mem);
+        ret = new_object(Pool);
+    }
+    ret->init(name);
+    ret->disable_alignment = true;
     return ret;
 }
 
-Ast_Node *new_ast_node(TSNode node, Parser_It *it) {
-    if (ts_node_is_null(node)) return NULL;
+Index_Job *Go_Indexer::new_index_job(ccstr import_path, ccstr resolved_path, bool use_pool) {
+    auto job = (Index_Job*)cp_malloc(sizeof(Index_Job));
+    ptr0(job);
+    job->mem.init("index_job");
 
-    auto ret = new_object(Ast_Node);
-    ret->init(node, it);
+    SCOPED_MEM(&job->mem);
+    job->import_path = cp_strdup(import_path);
+    job->resolved_path = cp_strdup(resolved_path);
+    job->use_pool = use_pool;
+    return job;
+}
+
+// If the job was never published, also frees the pools it filled.
+void Go_Indexer::free_index_job(Index_Job *job, bool published) {
+    if (!published) {
+        if (job->pool)
+            job->pool->cleanup();
+        else if (job->files)
+            For (job->files) it.cleanup();
+    }
+
+    job->mem.cleanup();
+    cp_free(job);
+}
+
+// Runs on a worker thread. Nothing in here is allowed to touch `index`,
+// `package_lookup`, `module_resolver` or `final_mem`.
+// Set while a worker runs a job, so process_tree_into_gofile() can tell it
+// how long hashing took.
+thread_local u64 *index_job_phase_nanos = NULL;
+
+void Go_Indexer::run_index_job(Index_Job *job) {
+    Timer t; t.init();
+    defer { job->time_taken = t.read_total(); };
+
+    // t.read_time() is the time since it was last called
+    auto phases = job->phase_nanos;
+    index_job_phase_nanos = phases;
+    defer { index_job_phase_nanos = NULL; };
+
+    // before reading anything, so that changes made while we're processing
+    // still show up as a different fingerprint later
+    job->fingerprint = fingerprint_package(job->resolved_path);
+    phases[IPHASE_LIST_DIR] += t.read_time();
+
+    auto source_files = list_source_files(job->resolved_path, true);
+    phases[IPHASE_BUILD_CONSTRAINTS] += t.read_time();
+
+    if (isempty(source_files)) {
+        job->empty = true;
+        return;
+    }
+
+    if (job->use_pool)
+        job->pool = new_index_pool("go_package");
+
+    // dependencies can come from, and go into, the cache every project shares
+    bool shareable = job->use_pool && is_package_shareable(job->resolved_path);
+    if (shareable) {
+        auto found = shared_cache.read(job);
+        phases[IPHASE_SHARED_CACHE] += t.read_time();
+
+        if (found) {
+            job->from_shared_cache = true;
+            return;
+        }
+    }
+
+    {
+        SCOPED_MEM(job->use_pool ? job->pool : &job->mem);
+        job->files = new_list(Go_File, source_files->len);
+    }
+
+    ccstr package_name = NULL;
+    ccstr test_package_name = NULL;
+
+    // same as hash_package(), but reuses the hashes we get from processing
+    // each file instead of reading everything a second time
+    u64 hash = hash64((void*)job->resolved_path, strlen(job->resolved_path));
+
+    For (source_files) {
+        auto filename = it;
+
+        SCOPED_FRAME();
+
+        auto filepath = path_join(job->resolved_path, filename);
+
+        auto pf = parse_file(filepath, LANG_GO, false);
+        phases[IPHASE_PARSE] += t.read_time();
+
+        if (!pf) {
+            hash ^= hash_file(filepath);
+            phases[IPHASE_HASH] += t.read_time();
+            continue;
+        }
+        defer { free_parsed_file(pf); };
+
+        auto file = job->files->append();
+        file->use_pool = !job->use_pool;
+
+        auto pool = job->pool;
+        if (file->use_pool)
+            pool = file->pool = new_index_pool("go_file");
+
+        {
+            SCOPED_MEM(pool);
+            file->filename = cp_strdup(filename);
+            file->scope_ops = job->use_pool ? NULL : new_list(Go_Scope_Op);
+            file->decls = new_list(Godecl);
+            file->imports = new_list(Go_Import);
+            file->references = new_list(Go_Reference);
+            file->reference_postings = new_list(Go_Reference_Posting);
+        }
+
+        ccstr pkgname = NULL;
+        auto hash_nanos = phases[IPHASE_HASH];
+        process_tree_into_gofile(file, pf->root, filepath, &pkgname, pool);
+        phases[IPHASE_PROCESS_TREE] += t.read_time() - (phases[IPHASE_HASH] - hash_nanos);
+        hash ^= file->hash;
+
+        if (pkgname) {
+            SCOPED_MEM(&job->mem);
+            if (str_ends_with(filename, "_test.go")) {
+                if (!test_package_name)
+                    test_package_name = cp_strdup(pkgname);
+            } else {
+                if (!package_name)
+                    package_name = cp_strdup(pkgname);
+            }
+        }
+    }
+
+    job->package_name = package_name ? package_name : test_package_name;
+    job->hash = hash;
+
+    if (shareable) {
+        t.read_time();
+        shared_cache.write(job);
+        phases[IPHASE_SHARED_CACHE] += t.read_time();
+    }
+}
+
+bool Go_Indexer::is_package_shareable(ccstr resolved_path) {
+    if (gomodcache && path_has_descendant(gomodcache, resolved_path)) return true;
+    if (goroot && path_has_descendant(goroot, resolved_path)) return true;
+    return false;
+}
+
+void Index_Worker_Pool::init(Go_Indexer *_indexer, int num_threads) {
+    ptr0(this);
+    indexer = _indexer;
+
+    lock.init();
+    cond.init();
+    finished_cond.init();
+
+    // shared between threads, so don't tie them to anyone's pool
+    threads.init(LIST_MALLOC, num_threads);
+    pending.init(LIST_MALLOC, 64);
+    finished.init(LIST_MALLOC, 64);
+
+    for (int i = 0; i < num_threads; i++) {
+        auto fn = [](void *param) {
+            ((Index_Worker_Pool*)param)->run_thread();
+        };
+        auto h = create_thread(fn, this);
+        if (h) threads.append(h);
+    }
+}
+
+void Index_Worker_Pool::cleanup() {
+    if (!indexer) return;
+
+    {
+        SCOPED_LOCK(&lock);
+        stopping = true;
+        cond.broadcast();
+    }
+
+    // a worker in the middle of a job finishes it first
+    For (&threads) {
+        join_thread(it);
+        close_thread_handle(it);
+    }
+    threads.cleanup();
+
+    For (&pending) indexer->free_index_job(it, false);
+    For (&finished) indexer->free_index_job(it, false);
+    pending.cleanup();
+    finished.cleanup();
+    outstanding = 0;
+
+    finished_cond.cleanup();
+    cond.cleanup();
+    lock.cleanup();
+
+    indexer = NULL;
+}
+
+void Index_Worker_Pool::run_thread() {
+    Pool worker_mem;
+    worker_mem.init("index_worker_mem");
+    defer { worker_mem.cleanup(); };
+
+    SCOPED_MEM(&worker_mem);
+
+    // parse_file() keeps its parser around for the life of the worker, so
+    // tree-sitter can't allocate out of worker_mem, which gets reset after
+    // every job.
+    use_pool_for_tree_sitter = false;
+    defer { cleanup_thread_ts_parsers(); };
+
+    while (true) {
+        Index_Job *job = NULL;
+        {
+            SCOPED_LOCK(&lock);
+            while (!pending.len && !stopping)
+                cond.wait(&lock);
+            if (stopping) break;
+
+            job = pending[0];
+            pending.remove((u32)0);
+        }
+
+        worker_mem.reset();
+        indexer->run_index_job(job);
+
+        {
+            SCOPED_LOCK(&lock);
+            finished.append(job);
+            finished_cond.signal();
+        }
+
+        // outside our lock, the background thread holds the message queue
+        // lock while it drains us
+        indexer->message_queue.wake();
+    }
+}
+
+void Index_Worker_Pool::submit(Index_Job *job) {
+    SCOPED_LOCK(&lock);
+    pending.append(job);
+    outstanding++;
+    cond.signal();
+}
+
+List<Index_Job*> *Index_Worker_Pool::collect_finished() {
+    SCOPED_LOCK(&lock);
+
+    auto ret = new_list(Index_Job*, finished.len);
+    For (&finished) ret->append(it);
+    finished.len = 0;
+    outstanding -= ret->len;
+    return ret;
+}
+
+void Index_Worker_Pool::wait_for_finished(u32 timeout_milli) {
+    SCOPED_LOCK(&lock);
+    if (!finished.len)
+        finished_cond.wait(&lock, timeout_milli);
+}
+
+// Takes back every job that hasn't started yet and waits for the rest to
+// finish. The returned jobs were never published, so the caller owns them.
+List<Index_Job*> *Index_Worker_Pool::drain() {
+    auto ret = new_list(Index_Job*);
+
+    {
+        SCOPED_LOCK(&lock);
+        For (&pending) ret->append(it);
+        outstanding -= pending.len;
+        pending.len = 0;
+    }
+
+    while (busy()) {
+        wait_for_finished(100);
+        For (collect_finished()) ret->append(it);
+    }
+    return ret;
+}
+
+ccstr index_phase_str(Index_Phase x) {
+    switch (x) {
+    case IPHASE_LIST_DIR: return "list_dir";
+    case IPHASE_BUILD_CONSTRAINTS: return "build_constraints";
+    case IPHASE_SHARED_CACHE: return "shared_cache";
+    case IPHASE_PARSE: return "parse";
+    case IPHASE_PROCESS_TREE: return "process_tree";
+    case IPHASE_HASH: return "hash";
+    case IPHASE_WRITE: return "write";
+    }
+    return NULL;
+}
+
+void Index_Metrics::init() {
+    ptr0(this);
+    lock.init();
+    start_milli = current_time_milli();
+}
+
+void Index_Metrics::cleanup() {
+    lock.cleanup();
+}
+
+void Index_Metrics::add_job(Index_Job *job) {
+    SCOPED_LOCK(&lock);
+
+    packages++;
+    package_nanos += job->time_taken;
+    if (job->from_shared_cache)
+        packages_from_shared_cache++;
+
+    for (int i = 0; i < _IPHASE_COUNT_; i++) {
+        auto nanos = job->phase_nanos[i];
+        if (!nanos) continue;
+
+        auto &it = phases[i];
+        it.count++;
+        it.total_nanos += nanos;
+        if (nanos > it.max_nanos)
+            it.max_nanos = nanos;
+    }
+
+    // keep the slowest few, slowest first
+    int pos = num_slowest;
+    while (pos > 0 && slowest[pos-1].nanos < job->time_taken)
+        pos--;
+    if (pos >= INDEX_METRICS_SLOWEST) return;
+
+    int last = min(num_slowest, INDEX_METRICS_SLOWEST - 1);
+    memmove(&slowest[pos+1], &slowest[pos], sizeof(slowest[0]) * (last - pos));
+    if (num_slowest < INDEX_METRICS_SLOWEST)
+        num_slowest++;
+
+    auto &it = slowest[pos];
+    cp_strcpy_fixed(it.import_path, job->import_path);
+    it.nanos = job->time_taken;
+    memcpy(it.phase_nanos, job->phase_nanos, sizeof(it.phase_nanos));
+}
+
+void Index_Metrics::add_write(u64 nanos) {
+    SCOPED_LOCK(&lock);
+
+    auto &it = phases[IPHASE_WRITE];
+    it.count++;
+    it.total_nanos += nanos;
+    if (nanos > it.max_nanos)
+        it.max_nanos = nanos;
+}
+
+void Index_Metrics::add_writing(u64 milli) {
+    SCOPED_LOCK(&lock);
+
+    writing_count++;
+    writing_total_milli += milli;
+    writing_last_milli = milli;
+    if (milli > writing_max_milli)
+        writing_max_milli = milli;
+}
+
+void Index_Metrics::add_queue_sample(int queued, int in_flight) {
+    SCOPED_LOCK(&lock);
+
+    if (queue_len == INDEX_METRICS_HISTORY) {
+        queue_start = (queue_start + 1) % INDEX_METRICS_HISTORY;
+        queue_len--;
+    }
+
+    auto it = get_queue_sample(queue_len++);
+    it->time_milli = current_time_milli() - start_milli;
+    it->queued = queued;
+    it->in_flight = in_flight;
+}
+
+ccstr Index_Metrics::to_json() {
+    SCOPED_LOCK(&lock);
+
+    Json_Renderer r;
+    r.init();
+
+    // Json_Renderer only knows about ints
+    auto num = [&](ccstr key, u64 val) {
+        r.field(key, [&]() { r.write("%llu", val); });
+    };
+
+    auto write_phases = [&](u64 *phase_nanos) {
+        r.obj([&]() {
+            for (int i = 0; i < _IPHASE_COUNT_; i++)
+                num(index_phase_str((Index_Phase)i), phase_nanos[i]);
+        });
+    };
+
+    r.obj([&]() {
+        num("uptime_milli", current_time_milli() - start_milli);
+        num("packages", packages);
+        num("packages_from_shared_cache", packages_from_shared_cache);
+        num("package_nanos", package_nanos);
+
+        r.field("phases", [&]() {
+            r.obj([&]() {
+                for (int i = 0; i < _IPHASE_COUNT_; i++) {
+                    auto &it = phases[i];
+                    r.field(index_phase_str((Index_Phase)i), [&]() {
+                        r.obj([&]() {
+                            num("count", it.count);
+                            num("total_nanos", it.total_nanos);
+                            num("max_nanos", it.max_nanos);
+                        });
+                    });
+                }
+            });
+        });
+
+        r.field("slowest_packages", [&]() {
+            r.arr([&]() {
+                for (int i = 0; i < num_slowest; i++) {
+                    auto &it = slowest[i];
+                    r.obj([&]() {
+                        r.field("import_path", (ccstr)it.import_path);
+                        num("nanos", it.nanos);
+                        r.field("phase_nanos", [&]() { write_phases(it.phase_nanos); });
+                    });
+                    r.sep();
+                }
+            });
+        });
+
+        r.field("queue_depth", [&]() {
+            r.arr([&]() {
+                for (int i = 0; i < queue_len; i++) {
+                    auto it = get_queue_sample(i);
+                    r.obj([&]() {
+                        num("time_milli", it->time_milli);
+                        r.field("queued", it->queued);
+                        r.field("in_flight", it->in_flight);
+                    });
+                    r.sep();
+                }
+            });
+        });
+
+        r.field("writing", [&]() {
+            r.obj([&]() {
+                num("count", writing_count);
+                num("total_milli", writing_total_milli);
+                num("max_milli", writing_max_milli);
+                num("last_milli", writing_last_milli);
+            });
+        });
+
+        r.field("eval_cache", [&]() {
+            r.obj([&]() {
+                num("hits", eval_cache_hits);
+                num("misses", eval_cache_misses);
+                num("stale", eval_cache_stale);
+            });
+        });
+
+        r.field("pools", [&]() {
+            r.obj([&]() {
+                for (int i = 0; i < num_pools; i++)
+                    num(pools[i].name, pools[i].bytes);
+            });
+        });
+    });
+
+    return r.finish();
+}
+
+bool Go_Indexer::start_background_thread() {
+    SCOPED_MEM(&mem);
+    auto fn = [](void* param) {
+        auto indexer = (Go_Indexer*)param;
+        indexer->background_thread();
+    };
+    return (bgthread = create_thread(fn, this));
+}
+
+TSLanguage *get_ts_language(Parse_Lang lang) {
+    switch (lang) {
+    case LANG_GO: return tree_sitter_go();
+    case LANG_GOMOD: return tree_sitter_gomod();
+    case LANG_GOWORK: return tree_sitter_gowork();
+    }
+    return NULL;
+}
+
+TSParser *new_ts_parser(Parse_Lang lang) {
+    auto tslang = get_ts_language(lang);
+    if (!tslang) return NULL;
+
+    auto parser = ts_parser_new();
+    ts_parser_set_language(parser, tslang);
+    return parser;
+}
+
+// One parser per language per thread, kept around so each file doesn't pay
+// to set one up and grow its stacks again from nothing. The parser outlives
+// whatever MEM is, so these are only for threads where tree-sitter uses
+// malloc.
+thread_local TSParser *thread_ts_parsers[_LANG_COUNT_];
+
+TSParser *get_thread_ts_parser(Parse_Lang lang) {
+    cp_assert(!use_pool_for_tree_sitter);
+
+    auto &ret = thread_ts_parsers[lang];
+    if (!ret) ret = new_ts_parser(lang);
+    return ret;
+}
+
+void cleanup_thread_ts_parsers() {
+    for (int i = 0; i < _LANG_COUNT_; i++) {
+        if (!thread_ts_parsers[i]) continue;
+        ts_parser_delete(thread_ts_parsers[i]);
+        thread_ts_parsers[i] = NULL;
+    }
+}
+
+// Hands tree-sitter the mapped file as is, instead of copying it out a few
+// bytes at a time through a Parser_It. A NUL ends the file, like it always
+// has.
+const char* read_from_file_mapping(void *p, uint32_t off, TSPoint pos, uint32_t *read) {
+    auto fm = (File_Mapping*)p;
+    if (off >= fm->len) {
+        *read = 0;
+        return "";
+    }
+
+    auto start = (char*)fm->data + off;
+    auto end = (char*)memchr(start, '\0', fm->len - off);
+    *read = (end ? end : (char*)fm->data + fm->len) - start;
+    return start;
+}
+
+Parsed_File *parse_file(ccstr filepath, Parse_Lang lang, bool use_latest) {
+    Parsed_File *ret = NULL;
+
+    if (use_latest) {
+        auto editor = find_editor_by_filepath(filepath);
+        if (!editor) return NULL;
+        if (!editor->buf->tree) return NULL;
+
+        auto it = new_object(Parser_It);
+        it->init(editor->buf);
+
+        ret = new_object(Parsed_File);
+        ret->tree_belongs_to_editor = true;
+        ret->editor_parser = editor->buf->parser;
+        ret->it = it;
+        ret->tree = ts_tree_copy(editor->buf->tree);
+    } else {
+        auto fm = map_file_into_memory(filepath);
+        if (!fm) return NULL;
+
+        auto it = new_object(Parser_It);
+        it->init(fm);
+
+        TSInput input;
+        input.payload = fm;
+        input.encoding = TSInputEncodingUTF8;
+        input.read = read_from_file_mapping;
+
+        // a parser's memory can't come from a pool that might be reset
+        // before the next file, so those threads get a new one each time
+        TSParser *parser = NULL;
+        bool own_parser = use_pool_for_tree_sitter;
+        if (own_parser)
+            parser = new_ts_parser(lang);
+        else
+            parser = get_thread_ts_parser(lang);
+        if (!parser) return NULL;
+        defer { if (own_parser) ts_parser_delete(parser); };
+
+        auto tree = ts_parser_parse(parser, NULL, input);
+        if (!tree) return NULL;
+
+        ret = new_object(Parsed_File);
+        ret->tree_belongs_to_editor = false;
+        ret->editor_parser = NULL;
+        ret->it = it;
+        ret->tree = tree;
+    }
+
+    ret->root = new_ast_node(ts_tree_root_node(ret->tree), ret->it);
+    return ret;
+}
+
+Ast_Node *new_ast_node(TSNode node, Parser_It *it) {
+    if (ts_node_is_null(node)) return NULL;
+
+    auto ret = new_object(Ast_Node);
+    ret->init(node, it);
     return ret;
 }
 
@@ -1939,77 +4182,473 @@ ccstr Ast_Node::string() {
         return ret;
     }
 
-    if (it->type == IT_BUFFER) {
-        auto pos = start();
-        auto buf = it->get_buf();
-        pos.x = buf->idx_byte_to_cp(pos.y, pos.x);
-        it->set_pos(pos);
+    if (it->type == IT_BUFFER) {
+        auto pos = start();
+        auto buf = it->get_buf();
+        pos.x = buf->idx_byte_to_cp(pos.y, pos.x);
+        it->set_pos(pos);
+
+        auto ret = new_list(char);
+        while (ret->len < len) {
+            char utf8[4];
+            int n = uchar_to_cstr(it->next(), utf8);
+            if (ret->len + n > len) break;
+            ret->concat(utf8, n);
+        }
+        ret->append('\0');
+        return ret->items;
+    }
+
+    return NULL;
+}
+
+Gotype *new_gotype(Gotype_Type type) {
+    // maybe optimize size of the object we allocate, like we did with Ast
+    auto ret = new_object(Gotype);
+    ret->type = type;
+    return ret;
+}
+
+Gotype *new_primitive_type(ccstr name) {
+    auto ret = new_gotype(GOTYPE_ID);
+    ret->id_name = name;
+    return ret;
+}
+
+Goresult* new_primitive_type_goresult(ccstr name) {
+    auto ctx = new_object(Go_Ctx);
+    ctx->import_path = "@builtin";
+    ctx->filename = cp_strdup(BUILTIN_FAKE_FILENAME);
+
+    return make_goresult(new_primitive_type(name), ctx);
+}
+
+void Go_Indexer::check_duplicate_packages() {
+#ifdef DEBUG_BUILD
+    SCOPED_FRAME();
+    auto lookup = new_table(int);
+    Fori (index.packages) {
+        bool found = false;
+        int idx = lookup->get(it.import_path, &found);
+        if (found) {
+            print("current index is %lu, already exists at %d", i, idx);
+            cp_panic("duplicate found");
+        }
+        lookup->set(it.import_path, i);
+    }
+#endif
+}
+
+void Go_Eval_Cache::init() {
+    ptr0(this);
+    lock.init();
+    mem.init("eval_cache_mem");
+
+    SCOPED_MEM(&mem);
+    table.init();
+}
+
+void Go_Eval_Cache::cleanup() {
+    clear();
+    mem.cleanup();
+    lock.cleanup();
+}
+
+// Hits are copied out before being returned, so nothing outside points
+// into mem.
+void Go_Eval_Cache::clear() {
+    SCOPED_LOCK(&lock);
+
+    // everything's in mem
+    table.lookup = NULL;
+    mem.reset();
+    full = false;
+
+    SCOPED_MEM(&mem);
+    table.init();
+}
+
+void Scope_Ops_Cache::init() {
+    ptr0(this);
+    lock.init();
+    evicted.init(LIST_MALLOC, SCOPE_OPS_CACHE_MAX);
+
+    for (int i = 0; i < SCOPE_OPS_CACHE_BUCKETS; i++)
+        buckets[i] = -1;
+}
+
+void Scope_Ops_Cache::cleanup() {
+    for (int i = 0; i < num_entries; i++)
+        evicted.append(entries[i].pool);
+    num_entries = 0;
+    free_evicted();
+
+    evicted.cleanup();
+    lock.cleanup();
+}
+
+u64 Scope_Ops_Cache::make_key(ccstr import_path, ccstr filename, u64 package_hash) {
+    auto a = hash64((void*)import_path, strlen(import_path));
+    auto b = hash64((void*)filename, strlen(filename));
+    return a ^ (b * 31) ^ (package_hash * 1099511628211ull);
+}
+
+// Caller holds lock.
+Scope_Ops_Cache::Entry *Scope_Ops_Cache::find(u64 key, ccstr import_path, ccstr filename) {
+    for (int i = buckets[key & (SCOPE_OPS_CACHE_BUCKETS - 1)]; i != -1; i = entries[i].next) {
+        auto &it = entries[i];
+        if (it.key != key) continue;
+        if (!streq(it.filename, filename)) continue;
+        if (!streq(it.import_path, import_path)) continue;
+
+        it.last_used = ++clock;
+        return &it;
+    }
+    return NULL;
+}
+
+// Caller holds lock. Makes room by evicting the least recently used entry,
+// and returns a blank one that's already in key's bucket.
+Scope_Ops_Cache::Entry *Scope_Ops_Cache::add(u64 key) {
+    int idx = num_entries;
+
+    if (num_entries < SCOPE_OPS_CACHE_MAX) {
+        num_entries++;
+    } else {
+        idx = 0;
+        for (int i = 1; i < num_entries; i++)
+            if (entries[i].last_used < entries[idx].last_used)
+                idx = i;
+
+        auto &old = entries[idx];
+        evicted.append(old.pool);
+
+        auto link = &buckets[old.key & (SCOPE_OPS_CACHE_BUCKETS - 1)];
+        while (*link != idx) link = &entries[*link].next;
+        *link = old.next;
+    }
+
+    auto &bucket = buckets[key & (SCOPE_OPS_CACHE_BUCKETS - 1)];
+
+    auto ret = &entries[idx];
+    ptr0(ret);
+    ret->key = key;
+    ret->last_used = ++clock;
+    ret->next = bucket;
+    bucket = idx;
+    return ret;
+}
+
+// Only when nobody can be reading, see reclaim_retired().
+void Scope_Ops_Cache::free_evicted() {
+    SCOPED_LOCK(&lock);
+
+    For (&evicted) {
+        it->cleanup();
+        cp_free(it);
+    }
+    evicted.len = 0;
+}
+
+// What the evaluation in progress on this thread has looked at, see
+// Go_Indexer::cached_eval().
+thread_local List<Go_Eval_Dep> *eval_deps = NULL;
+
+static void add_eval_dep(List<Go_Eval_Dep> *deps, ccstr import_path, u32 generation) {
+    For (deps)
+        if (it.import_path == import_path)
+            return;
+
+    Go_Eval_Dep dep;
+    dep.import_path = import_path;
+    dep.generation = generation;
+    deps->append(&dep);
+}
+
+Go_Package *Go_Indexer::find_package_in_index(ccstr import_path) {
+    if (!import_path) return NULL;
+
+    Table<int> *lookup = NULL;
+    List<Go_Package> *packages = NULL;
+
+    if (owns_working_index) {
+        lookup = &package_lookup;
+        packages = index.packages;
+    } else {
+        auto snap = get_pinned_snapshot();
+        lookup = &snap->package_lookup;
+        packages = snap->index.packages;
+    }
+
+    bool found = false;
+    auto ret = lookup->get(import_path, &found);
+    if (found) cp_assert(ret >= 0 && ret < packages->len);
+
+    if (eval_deps) {
+        auto generation = found ? packages->at(ret).generation : 0;
+        add_eval_dep(eval_deps, go_intern(import_path), generation);
+    }
+
+    if (!found) return NULL;
+    return &packages->at(ret);
+}
+
+Go_Package *Go_Indexer::find_up_to_date_package(ccstr import_path) {
+    auto pkg = find_package_in_index(import_path);
+    if (!pkg || pkg->status == GPS_OUTDATED) return NULL;
+
+    load_package_files(pkg);
+    return pkg;
+}
+
+// for copies of packages whose files can't be read in anymore
+static List<Go_File> no_files;
+
+// pkg might be a copy in a snapshot, so this only touches pkg->files; the
+// files themselves get read into pkg->lazy_files, which all copies share.
+void Go_Indexer::load_package_files(Go_Package *pkg) {
+    if (!pkg) return;
+
+    if (pkg->last_used_milli)
+        *pkg->last_used_milli = current_time_milli();
+
+    if (!pkg->needs_loading()) return;
+
+    auto lazy = pkg->lazy_files;
+
+    SCOPED_LOCK(&index_source_lock);
+    if (!pkg->needs_loading()) return;
+
+    if (lazy->files) {
+        pkg->files = lazy->files;
+        return;
+    }
+
+    // the package got replaced, or the .cpdb rewritten without it, since
+    // this copy was made
+    if (!index_source_open || !lazy->offset || lazy->generation != index_source_generation) {
+        pkg->files = &no_files;
+        pkg->status = GPS_OUTDATED;
+        return;
+    }
+
+    auto &s = index_source;
+    s.offset = lazy->offset;
+
+    if (!lazy->pool)
+        lazy->pool = new_index_pool("go_package_files");
+
+    List<Go_File> *files = NULL;
+    {
+        SCOPED_MEM(lazy->pool);
+        files = read_list<Go_File>(&s);
+        if (!s.ok || s.offset != lazy->offset + lazy->len) {
+            // let the indexer redo it next time it looks at the package
+            go_print("unable to read files for %s", pkg->import_path);
+            files = NULL;
+            pkg->status = GPS_OUTDATED;
+            pkg->disk_offset = 0;
+            pkg->disk_len = 0;
+        }
+        if (!files) files = new_list(Go_File);
+    }
+
+    lazy->files = files;
+    pkg->files = files;
+}
+
+// Whether pkg's files can be dropped and read back in from the .cpdb later.
+// Only dependencies, since workspace packages change all the time and are
+// what queries look at most.
+bool Go_Indexer::can_evict_package(Go_Package *pkg) {
+    if (!pkg->use_pool) return false;
+    if (pkg->status != GPS_READY) return false;
+    if (streq(pkg->import_path, "@builtin")) return false;
+
+    // nothing to drop
+    if (!pkg->loaded_files()) return false;
+
+    // what's in the .cpdb is out of date, or there's no .cpdb to read from
+    if (!pkg->disk_offset || !pkg->disk_len) return false;
+    if (!index_source_open) return false;
+
+    return true;
+}
+
+// Turns pkg back into what read_index() makes of a package: everything but
+// the files, which stay in the .cpdb until load_package_files() reads them
+// in again. Needs write_lock.
+void Go_Indexer::evict_package(Go_Package *pkg) {
+    Go_Package stub = *pkg;
+
+    stub.pool = new_index_pool("go_package");
+    stub.files = NULL;
+    stub.reference_names_pool = NULL;
+    stub.method_sets_pool = NULL;
+    stub.call_edges_pool = NULL;
+    stub.symbols_pool = NULL;
+    stub.decl_table_pool = NULL;
+
+    {
+        SCOPED_MEM(stub.pool);
+        stub.import_path = go_intern(pkg->import_path);
+        stub.package_name = go_intern(pkg->package_name);
+        stub.reference_names = copy_list(pkg->reference_names);
+        stub.method_sets = copy_list(pkg->method_sets);
+        stub.method_postings = copy_list(pkg->method_postings);
+        stub.call_edges = copy_list(pkg->call_edges);
+        stub.symbols = copy_list(pkg->symbols);
+        stub.decl_table = copy_list(pkg->decl_table);
+    }
+
+    stub.lazy_files = new_lazy_files();
+    stub.lazy_files->offset = pkg->disk_offset;
+    stub.lazy_files->len = pkg->disk_len;
+    stub.lazy_files->generation = index_source_generation;
+
+    // the old clock goes along with everything else retire_package() gets
+    stub.last_used_milli = NULL;
+    if (pkg->last_used_milli) {
+        stub.last_used_milli = (u64*)cp_malloc(sizeof(u64));
+        *stub.last_used_milli = *pkg->last_used_milli;
+    }
+
+    // the old files, and the old lazy_files along with them, go once
+    // nobody's reading
+    retire_package(pkg);
+    *pkg = stub;
+
+    // so eval_cache doesn't hand out anything that pointed into them
+    bump_package_generation(pkg);
+    snapshot_dirty = true;
+}
+
+// Keeps the index under options.index_memory_budget_mb by evicting the
+// dependencies that have gone unused the longest. Needs write_lock.
+void Go_Indexer::evict_cold_packages() {
+    if (!index.packages) return;
+
+    auto now = current_time_milli();
+    if (now - last_eviction_check_milli < INDEX_EVICTION_CHECK_MILLI) return;
+    last_eviction_check_milli = now;
+
+    struct Candidate {
+        int index;
+        u64 last_used;
+        u64 bytes;
+    };
+
+    List<Candidate> candidates;
+    candidates.init(LIST_MALLOC, 64);
+    defer { candidates.cleanup(); };
+
+    u64 total = 0;
+
+    Fori (index.packages) {
+        auto bytes = it.mem_allocated();
+        total += bytes;
+
+        // start the clock on packages that don't have one yet
+        if (!it.last_used_milli) {
+            it.last_used_milli = (u64*)cp_malloc(sizeof(u64));
+            *it.last_used_milli = now;
+            snapshot_dirty = true;
+            continue;
+        }
+
+        if (!can_evict_package(&it)) continue;
+        if (now - *it.last_used_milli < INDEX_EVICTION_MIN_IDLE_MILLI) continue;
+
+        auto c = candidates.append();
+        c->index = i;
+        c->last_used = *it.last_used_milli;
+        c->bytes = bytes;
+    }
+
+    over_memory_budget = false;
+    if (options.index_memory_budget_mb <= 0) return;
+
+    u64 budget = (u64)options.index_memory_budget_mb * 1024 * 1024;
+    if (total <= budget) return;
+
+    candidates.sort([&](auto a, auto b) {
+        if (a->last_used < b->last_used) return -1;
+        if (a->last_used > b->last_used) return 1;
+        return 0;
+    });
+
+    int evicted = 0;
+    u64 freed = 0;
 
-        auto ret = new_list(char);
-        while (ret->len < len) {
-            char utf8[4];
-            int n = uchar_to_cstr(it->next(), utf8);
-            if (ret->len + n > len) break;
-            ret->concat(utf8, n);
-        }
-        ret->append('\0');
-        return ret->items;
+    For (&candidates) {
+        if (total - freed <= budget) break;
+
+        evict_package(&index.packages->at(it.index));
+        freed += it.bytes;
+        evicted++;
     }
 
-    return NULL;
-}
+    // the rest might go once they've sat long enough, see wait_for_work
+    over_memory_budget = (total - freed > budget);
 
-Gotype *new_gotype(Gotype_Type type) {
-    // maybe optimize size of the object we allocate, like we did with Ast
-    auto ret = new_object(Gotype);
-    ret->type = type;
-    return ret;
+    if (evicted)
+        index_print(
+            "Index over memory budget (%llu MB), evicted %d packages (%llu MB).",
+            total / 1024 / 1024,
+            evicted,
+            freed / 1024 / 1024
+        );
 }
 
-Gotype *new_primitive_type(ccstr name) {
-    auto ret = new_gotype(GOTYPE_ID);
-    ret->id_name = name;
-    return ret;
-}
+void Go_Indexer::close_index_source() {
+    SCOPED_LOCK(&index_source_lock);
 
-Goresult* new_primitive_type_goresult(ccstr name) {
-    auto ctx = new_object(Go_Ctx);
-    ctx->import_path = "@builtin";
-    ctx->filename = cp_strdup(BUILTIN_FAKE_FILENAME);
+    // anything not read in yet is going away
+    if (index.packages) {
+        For (index.packages) {
+            if (!it.needs_loading()) continue;
 
-    return make_goresult(new_primitive_type(name), ctx);
-}
+            if (it.lazy_files->files) {
+                it.files = it.lazy_files->files;
+                continue;
+            }
 
-void Go_Indexer::check_duplicate_packages() {
-#ifdef DEBUG_BUILD
-    SCOPED_FRAME();
-    auto lookup = new_table(int);
-    Fori (index.packages) {
-        bool found = false;
-        int idx = lookup->get(it.import_path, &found);
-        if (found) {
-            print("current index is %lu, already exists at %d", i, idx);
-            cp_panic("duplicate found");
+            SCOPED_MEM(get_package_pool(&it));
+            it.files = new_list(Go_File);
+            it.disk_offset = 0;
+            it.disk_len = 0;
+            it.status = GPS_OUTDATED;
+            snapshot_dirty = true;
         }
-        lookup->set(it.import_path, i);
     }
-#endif
-}
 
-Go_Package *Go_Indexer::find_package_in_index(ccstr import_path) {
-    if (!import_path) return NULL;
+    if (index_source_open) {
+        index_source.cleanup();
+        index_source_open = false;
+    }
 
-    bool found = false;
-    auto ret = package_lookup.get(import_path, &found);
-    if (!found) return NULL;
+    index_source_generation++;
 
-    cp_assert(ret >= 0 && ret < index.packages->len);
-    return &index.packages->at(ret);
+    index_atom_map.cleanup();
+    index_atom_map.init();
 }
 
-Go_Package *Go_Indexer::find_up_to_date_package(ccstr import_path) {
-    auto pkg = find_package_in_index(import_path);
-    return (pkg && pkg->status != GPS_OUTDATED) ? pkg : NULL;
+// After the .cpdb gets written, map it again so the mapping covers whatever
+// got appended (or points at the new file, if it got replaced). Caller holds
+// index_source_lock, and updates offsets of packages that haven't been read
+// in if they moved.
+bool Go_Indexer::reopen_index_source() {
+    if (index_source_open) {
+        index_source.cleanup();
+        index_source_open = false;
+    }
+
+    if (!index_source.open(path_join(core.current_path, ".cpdb")))
+        return false;
+
+    index_source_open = true;
+    index_source.atom_map = &index_atom_map;
+    return true;
 }
 
 ccstr Go_Indexer::get_import_package_name(Go_Import *it) {
@@ -2529,6 +5168,11 @@ void Go_Indexer::process_tree_into_gofile(
     Timer t;
     t.init("process_tree_into_gofile");
 
+    // everything copied into pool below is going into the index
+    auto old_copy_into_index = copy_into_index;
+    copy_into_index = true;
+    defer { copy_into_index = old_copy_into_index; };
+
     auto filename = cp_basename(filepath);
 
     if (time) t.log("get filename");
@@ -2564,9 +5208,8 @@ void Go_Indexer::process_tree_into_gofile(
     // add scope_ops
     // -------------
 
-    file->scope_ops->len = 0;
-
-    {
+    // dependencies leave them out, see Scope_Ops_Cache
+    if (file->scope_ops) {
         auto ops = iterate_over_scope_ops2(root, filename);
 
         if (time) t.log("get scope ops 2 (iterate)");
@@ -2582,7 +5225,7 @@ void Go_Indexer::process_tree_into_gofile(
     // --------------
 
     file->references->len = 0;
-    if (path_has_descendant(world.current_path, filepath)) {
+    if (path_has_descendant(core.current_path, filepath)) {
         int scope_ops_idx = 0;
 
         auto is_selector_sel = [&](Ast_Node *it) {
@@ -2632,6 +5275,28 @@ void Go_Indexer::process_tree_into_gofile(
 
     if (time) t.log("references");
 
+    // add reference postings
+    // ----------------------
+
+    {
+        SCOPED_MEM(pool);
+        file->reference_postings = new_list(Go_Reference_Posting, max(file->references->len, 1));
+    }
+
+    Fori (file->references) {
+        auto posting = file->reference_postings->append();
+        posting->name = it.is_sel ? it.sel : it.name;
+        posting->index = i;
+    }
+
+    file->reference_postings->sort([&](auto a, auto b) {
+        auto ret = strcmp(a->name, b->name);
+        if (ret) return ret;
+        return a->index - b->index;
+    });
+
+    if (time) t.log("reference postings");
+
     // add import info
     // ---------------
 
@@ -2661,7 +5326,12 @@ void Go_Indexer::process_tree_into_gofile(
 
     if (time) t.log("get import info");
 
-    file->hash = hash_file(filepath);
+    {
+        auto start = current_time_nano();
+        file->hash = hash_file(filepath);
+        if (index_job_phase_nanos)
+            index_job_phase_nanos[IPHASE_HASH] += current_time_nano() - start;
+    }
 }
 
 void Go_Indexer::import_decl_to_goimports(Ast_Node *decl_node, List<Go_Import> *out) {
@@ -2738,49 +5408,440 @@ u64 Go_Indexer::hash_file(ccstr filepath) {
 u64 Go_Indexer::hash_package(ccstr resolved_package_path) {
     if (!resolved_package_path) return 0;
 
-    if (streq(resolved_package_path, "@builtin"))
-        return CUSTOM_HASH_BUILTINS;
+    if (streq(resolved_package_path, "@builtin"))
+        return CUSTOM_HASH_BUILTINS;
+
+    u64 ret = 0;
+    ret ^= hash64((void*)resolved_package_path, strlen(resolved_package_path));
+
+    {
+        SCOPED_FRAME();
+
+        auto files = list_source_files(resolved_package_path, true);
+        if (!files) return 0;
+        For (files)
+            ret ^= hash_file(path_join(resolved_package_path, it));
+    }
+
+    return ret;
+}
+
+// Cheap stand-in for hash_package(): combines the name, size, mtime and inode
+// of every .go file in the directory without reading any of them, or
+// evaluating build constraints. If it hasn't changed, neither has the hash.
+u64 Go_Indexer::fingerprint_package(ccstr resolved_package_path) {
+    if (!resolved_package_path) return 0;
+    if (streq(resolved_package_path, "@builtin")) return 0;
+
+    u64 ret = hash64((void*)resolved_package_path, strlen(resolved_package_path));
+
+    auto ok = list_directory(resolved_package_path, [&](Dir_Entry *ent) -> bool {
+        if (ent->type == DIRENT_DIR) return true;
+        if (!str_ends_with(ent->name, ".go")) return true;
+
+        SCOPED_FRAME();
+
+        File_Stat st;
+        if (!stat_file(path_join(resolved_package_path, ent->name), &st)) {
+            ret = 0;
+            return false;
+        }
+
+        ret ^= hash64(ent->name, strlen(ent->name)) ^ hash64(&st, sizeof(st));
+        return true;
+    });
+
+    return ok ? ret : 0;
+}
+
+bool is_file_included_in_build(ccstr path) {
+    return GHBuildEnvIsFileIncluded((char*)path);
+}
+
+List<ccstr>* Go_Indexer::list_source_files(ccstr dirpath, bool include_tests) {
+    auto files = list_included_files(dirpath);
+    if (!files) return NULL;
+
+    auto ret = new_list(ccstr, files->len);
+    For (files) {
+        if (str_ends_with(it, "_test.go") && !include_tests) continue;
+        ret->append(it);
+    }
+    return ret;
+}
+
+// Names of .go files in dirpath that are included in the build, including
+// tests. Evaluates the whole directory in one go and caches the result.
+List<ccstr>* Go_Indexer::list_included_files(ccstr dirpath) {
+    auto fingerprint = fingerprint_package(dirpath);
+    if (fingerprint) {
+        auto ret = build_cache.get(dirpath, fingerprint);
+        if (ret) return ret;
+    }
+
+    GoUint8 ok = false;
+    auto s = GHBuildEnvListIncludedFiles((char*)dirpath, &ok);
+    if (!ok) {
+        // same as if each file came back not included
+        if (check_path(dirpath) != CPR_DIRECTORY) return NULL;
+        return new_list(ccstr);
+    }
+    defer { GHFree(s); };
+
+    auto ret = new_list(ccstr);
+    if (s[0] != '\0') {
+        for (auto p = s; p; ) {
+            auto next = strchr(p, '\n');
+            auto len = next ? next - p : strlen(p);
+            ret->append(cp_strncpy(p, len));
+            p = next ? next + 1 : NULL;
+        }
+    }
+
+    if (fingerprint)
+        build_cache.set(dirpath, fingerprint, ret);
+    return ret;
+}
+
+void Build_Constraint_Cache::init() {
+    ptr0(this);
+    mem.init("build_cache_mem");
+    lock.init();
+
+    SCOPED_MEM(&mem);
+    table.init();
+}
+
+void Build_Constraint_Cache::cleanup() {
+    mem.cleanup();
+    lock.cleanup();
+}
+
+void Build_Constraint_Cache::clear() {
+    SCOPED_LOCK(&lock);
+
+    mem.reset();
+    {
+        SCOPED_MEM(&mem);
+        ptr0(&table);
+        table.init();
+    }
+    dirty = true;
+}
+
+void Build_Constraint_Cache::set_tags_hash(u64 hash) {
+    if (tags_hash == hash) return;
+    clear();
+    tags_hash = hash;
+}
+
+// returns a copy in MEM
+List<ccstr> *Build_Constraint_Cache::get(ccstr dirpath, u64 fingerprint) {
+    SCOPED_LOCK(&lock);
+
+    auto entry = table.get(dirpath);
+    if (!entry || entry->fingerprint != fingerprint) return NULL;
+
+    auto ret = new_list(ccstr, entry->files->len);
+    For (entry->files) ret->append(cp_strdup(it));
+    return ret;
+}
+
+void Build_Constraint_Cache::set(ccstr dirpath, u64 fingerprint, List<ccstr> *files) {
+    SCOPED_LOCK(&lock);
+    SCOPED_MEM(&mem);
+
+    // replaced entries stay in mem until the next clear(), but directories
+    // only get here when their files change, so that's not much
+    auto entry = new_object(Entry);
+    entry->fingerprint = fingerprint;
+    entry->files = new_list(ccstr, files->len);
+    For (files) entry->files->append(cp_strdup(it));
+
+    table.set(cp_strdup(dirpath), entry);
+    dirty = true;
+}
+
+bool Build_Constraint_Cache::read(ccstr path) {
+    SCOPED_LOCK(&lock);
+
+    Index_Stream s;
+    if (!s.open(path)) return false;
+    defer { s.cleanup(); };
+
+    if (s.read4() != GO_INDEX_MAGIC_NUMBER) return false;
+    if (s.read4() != BUILD_CACHE_VERSION) return false;
+
+    // cached with different build tags, nothing in here is any good
+    if ((u64)s.read8() != tags_hash) return false;
+
+    auto count = s.read4();
+    if (!s.ok) return false;
+
+    SCOPED_MEM(&mem);
+
+    for (int i = 0; i < count; i++) {
+        auto dirpath = s.readstr();
+        auto fingerprint = (u64)s.read8();
+        auto len = s.read4();
+        if (!s.ok || len < 0) return false;
+
+        auto entry = new_object(Entry);
+        entry->fingerprint = fingerprint;
+        entry->files = new_list(ccstr, len);
+        for (int j = 0; j < len; j++)
+            entry->files->append(s.readstr());
+        if (!s.ok) return false;
+
+        table.set(dirpath, entry);
+    }
+
+    dirty = false;
+    return true;
+}
+
+bool Build_Constraint_Cache::write(ccstr path) {
+    SCOPED_LOCK(&lock);
+    SCOPED_FRAME();
+
+    auto tmp_path = cp_sprintf("%s.tmp", path);
+
+    {
+        Index_Stream s;
+        if (!s.open(tmp_path, true)) return false;
+        defer { s.cleanup(); };
+
+        auto entries = table.entries();
+
+        s.write4(GO_INDEX_MAGIC_NUMBER);
+        s.write4(BUILD_CACHE_VERSION);
+        s.write8(tags_hash);
+        s.write4(entries->len);
+
+        For (entries) {
+            s.writestr(it->name);
+            s.write8(it->value->fingerprint);
+            s.write4(it->value->files->len);
+            For (it->value->files) s.writestr(it);
+        }
+
+        if (!s.ok) return false;
+        s.finish_writing();
+    }
+
+    if (!move_file_atomically(tmp_path, path)) return false;
+
+    dirty = false;
+    return true;
+}
+
+void Shared_Package_Cache::init(ccstr configdir, u64 tags_hash, ccstr goroot) {
+    ptr0(this);
+    mem.init("shared_package_cache");
+
+    if (!configdir || !configdir[0]) return;
+
+    SCOPED_MEM(&mem);
+
+    auto path = path_join(configdir, "pkgcache");
+    if (check_path(path) != CPR_DIRECTORY)
+        if (!create_directory(path))
+            return;
+
+    dir = cp_strdup(path);
+
+    // GOROOT doesn't have the version in its path, so it goes in the key
+    env_hash = tags_hash;
+    if (goroot) {
+        auto version = read_file(path_join(goroot, "VERSION"));
+        if (version) env_hash ^= hash64((void*)version, strlen(version)) * 31;
+    }
+
+    sweep();
+}
+
+void Shared_Package_Cache::cleanup() {
+    mem.cleanup();
+}
+
+void Shared_Package_Cache::sweep() {
+    if (!dir) return;
+
+    SCOPED_FRAME();
+
+    struct Entry {
+        ccstr path;
+        u64 size;
+        u64 mtime_nano;
+    };
+
+    auto entries = new_list(Entry);
+    u64 total = 0;
+    u64 now = (u64)get_unix_time() * 1000000000;
+    u64 tmp_max_age = (u64)SHARED_CACHE_TMP_MAX_AGE_SECS * 1000000000;
+    int tmp_deleted = 0;
+
+    list_directory(dir, [&](auto ent) {
+        if (ent->type != DIRENT_FILE) return true;
+
+        auto path = path_join(dir, ent->name);
+
+        File_Stat st;
+        if (!stat_file(path, &st)) return true;
+
+        if (str_ends_with(ent->name, ".tmp")) {
+            if (st.mtime_nano < now && now - st.mtime_nano > tmp_max_age)
+                if (delete_file(path))
+                    tmp_deleted++;
+            return true;
+        }
+
+        auto it = entries->append();
+        it->path = path;
+        it->size = st.size;
+        it->mtime_nano = st.mtime_nano;
+        total += st.size;
+        return true;
+    });
+
+    if (tmp_deleted)
+        index_print("Deleted %d stale temp files from the shared package cache.", tmp_deleted);
+
+    if (total <= SHARED_CACHE_MAX_BYTES) return;
+
+    // entries aren't touched when they're read, so this goes by when they
+    // were written; get down to 3/4 so we're not back here every startup
+    entries->sort([&](auto a, auto b) {
+        if (a->mtime_nano < b->mtime_nano) return -1;
+        if (a->mtime_nano > b->mtime_nano) return 1;
+        return 0;
+    });
+
+    auto target = SHARED_CACHE_MAX_BYTES / 4 * 3;
+    int deleted = 0;
+    u64 freed = 0;
+
+    For (entries) {
+        if (total - freed <= target) break;
+        if (!delete_file(it.path)) continue;
+        freed += it.size;
+        deleted++;
+    }
+
+    index_print(
+        "Shared package cache over %llu MB, deleted %d oldest entries (%llu MB).",
+        SHARED_CACHE_MAX_BYTES / 1024 / 1024,
+        deleted,
+        freed / 1024 / 1024
+    );
+}
+
+// Where the package would be, in MEM.
+ccstr Shared_Package_Cache::get_path(ccstr resolved_path, u64 fingerprint) {
+    u64 key = hash64((void*)resolved_path, strlen(resolved_path));
+    key ^= fingerprint * 31;
+    key ^= env_hash * 37;
+    return path_join(dir, cp_sprintf("%016llx", key));
+}
+
+// Reads the package's files into job->pool, and fills in the rest of what
+// run_index_job() would have. Called by indexer workers.
+bool Shared_Package_Cache::read(Index_Job *job) {
+    if (!dir || !job->fingerprint || !job->pool) return false;
+
+    SCOPED_FRAME();
+
+    Index_Stream s;
+    if (!s.open(get_path(job->resolved_path, job->fingerprint))) return false;
+    defer { s.cleanup(); };
+
+    Go_Atom_Map atom_map;
+    atom_map.init();
+    defer { atom_map.cleanup(); };
+
+    if (s.read4() != GO_INDEX_MAGIC_NUMBER) return false;
+    if (s.read4() != GO_INDEX_VERSION) return false;
+
+    auto last_chunk = s.read8();
+    if (!s.ok) return false;
+
+    s.atom_map = &atom_map;
+    if (!s.read_atoms(last_chunk, s.fm->len)) return false;
+
+    s.offset = GO_INDEX_HEADER_SIZE;
+    auto resolved_path = s.readstr();
+    auto hash = (u64)s.read8();
+    auto package_name = s.readstr();
+
+    // a different package that happens to have the same key
+    if (!s.ok || !streq(resolved_path, job->resolved_path)) return false;
+
+    List<Go_File> *files = NULL;
+    {
+        SCOPED_MEM(job->pool);
+        files = read_list<Go_File>(&s);
+    }
+
+    if (!s.ok || !files) {
+        job->pool->reset();
+        return false;
+    }
+
+    job->files = files;
+    job->package_name = package_name[0] ? package_name : NULL;
+    job->hash = hash;
+    return true;
+}
+
+// Saves what run_index_job() came up with. Called by indexer workers.
+bool Shared_Package_Cache::write(Index_Job *job) {
+    if (!dir || !job->fingerprint) return false;
+
+    SCOPED_FRAME();
+
+    auto path = get_path(job->resolved_path, job->fingerprint);
 
-    u64 ret = 0;
-    ret ^= hash64((void*)resolved_package_path, strlen(resolved_package_path));
+    // other workers, or other instances of us, could be writing the same one
+    auto tmp_path = cp_sprintf("%s.%llx.tmp", path, current_time_nano());
 
+    bool ok = false;
     {
-        SCOPED_FRAME();
-
-        auto files = list_source_files(resolved_package_path, true);
-        if (!files) return 0;
-        For (files)
-            ret ^= hash_file(path_join(resolved_package_path, it));
-    }
+        Index_Stream s;
+        if (!s.open(tmp_path, true)) return false;
+        defer { s.cleanup(); };
 
-    return ret;
-}
+        Go_Atom_Map atom_map;
+        atom_map.init();
+        defer { atom_map.cleanup(); };
 
-bool is_file_included_in_build(ccstr path) {
-    return GHBuildEnvIsFileIncluded((char*)path);
-}
+        s.write4(GO_INDEX_MAGIC_NUMBER);
+        s.write4(GO_INDEX_VERSION);
+        s.write8(0);
 
-List<ccstr>* Go_Indexer::list_source_files(ccstr dirpath, bool include_tests) {
-    auto ret = new_list(ccstr);
+        s.atom_map = &atom_map;
+        s.writestr(job->resolved_path);
+        s.write8(job->hash);
+        s.writestr(job->package_name);
+        write_list(job->files, &s);
 
-    auto save_gofiles = [&](Dir_Entry *ent) -> bool {
-        do {
-            if (ent->type == DIRENT_DIR) break;
-            if (!str_ends_with(ent->name, ".go")) break;
-            if (str_ends_with(ent->name, "_test.go") && !include_tests) break;
+        // header points at the strings, like the .cpdb's trailer does
+        if (s.write_atoms()) {
+            auto end = s.offset;
+            s.offset = 8;
+            s.write8(atom_map.last_chunk);
+            s.offset = end;
 
-            {
-                SCOPED_FRAME();
-                if (!is_file_included_in_build(path_join(dirpath, ent->name))) break;
+            if (s.ok) {
+                s.finish_writing();
+                ok = true;
             }
+        }
+    }
 
-            ret->append(cp_strdup(ent->name));
-        } while (0);
-
-        return true;
-    };
+    if (ok && move_file_atomically(tmp_path, path)) return true;
 
-    return list_directory(dirpath, save_gofiles) ? ret : NULL;
+    delete_file(tmp_path);
+    return false;
 }
 
 ccstr Go_Indexer::get_package_path(ccstr import_path) {
@@ -2804,6 +5865,40 @@ ccstr Go_Indexer::get_package_path(ccstr import_path) {
     return is_package ? path : NULL;
 }
 
+// Whether pos is in the types of a non-generic func's params or results,
+// where nothing from inside the func is in scope. The body's start isn't
+// kept, so this goes from the end of the name to the end of the last param
+// or result. Param names themselves are left out, they're decls.
+static bool is_in_plain_func_signature(Godecl *decl, cur2 pos) {
+    if (decl->type != GODECL_FUNC) return false;
+    if (!isempty(decl->type_params)) return false;
+
+    auto gotype = decl->gotype;
+    if (!gotype || gotype->type != GOTYPE_FUNC) return false;
+
+    // the receiver's type params are in scope too
+    auto recv = gotype->func_recv;
+    if (recv && recv->type == GOTYPE_POINTER) recv = recv->pointer_base;
+    if (recv && recv->type == GOTYPE_GENERIC) return false;
+
+    if (pos < decl->name_end) return false;
+
+    auto end = decl->name_end;
+    auto check = [&](List<Godecl> *fields) {
+        if (!fields) return true;
+
+        For (fields) {
+            if (it.name_start <= pos && pos < it.name_end) return false;
+            if (end < it.decl_end) end = it.decl_end;
+        }
+        return true;
+    };
+
+    if (!check(gotype->func_sig.params)) return false;
+    if (!check(gotype->func_sig.result)) return false;
+    return pos < end;
+}
+
 Goresult *Go_Indexer::find_decl_of_id(ccstr id_to_find, cur2 id_pos, Go_Ctx *ctx, Go_Import **single_import) {
     if (!ctx) return NULL;
 
@@ -2815,7 +5910,26 @@ Goresult *Go_Indexer::find_decl_of_id(ccstr id_to_find, cur2 id_pos, Go_Ctx *ctx
         auto file = pkg->files->find(check);
         if (!file) return NULL;
 
-        auto scope_ops = file->scope_ops;
+        // Dependencies don't keep scope ops, and most of the ids looked up
+        // in them are in type declarations and func signatures, where the
+        // only thing in scope besides the package and imports would be type
+        // params. Not worth parsing the file again for those.
+        bool use_scope_ops = true;
+        if (!file->scope_ops) {
+            For (file->decls) {
+                if (it.type == GODECL_TYPE && isempty(it.type_params)) {
+                    if (it.decl_start <= id_pos && id_pos < it.decl_end) {
+                        use_scope_ops = false;
+                        break;
+                    }
+                } else if (is_in_plain_func_signature(&it, id_pos)) {
+                    use_scope_ops = false;
+                    break;
+                }
+            }
+        }
+
+        auto scope_ops = use_scope_ops ? get_scope_ops(pkg, file) : NULL;
 
         SCOPED_FRAME_WITH_MEM(&scoped_table_mem);
 
@@ -2826,7 +5940,7 @@ Goresult *Go_Indexer::find_decl_of_id(ccstr id_to_find, cur2 id_pos, Go_Ctx *ctx
         }
         defer { table.cleanup(); };
 
-        For (scope_ops) {
+        if (scope_ops) For (scope_ops) {
             if (it.pos > id_pos) break;
 
             bool get_out = false;
@@ -3341,6 +6455,84 @@ bool Go_Indexer::are_gotypes_equal(Goresult *ra, Goresult *rb) {
     return false;
 }
 
+// Method hashes for find_interfaces() and find_implementations(), sorted,
+// without duplicates.
+static List<u64> *hash_methods(List<Goresult> *methods) {
+    auto ret = new_list(u64, max(methods->len, 1));
+    For (methods) ret->append(hash_method(it.decl->name, it.decl->gotype));
+
+    ret->sort([&](auto a, auto b) { return *a == *b ? 0 : (*a < *b ? -1 : 1); });
+
+    auto uniq = new_list(u64, max(ret->len, 1));
+    For (ret)
+        if (!uniq->len || *uniq->last() != it)
+            uniq->append(it);
+    return uniq;
+}
+
+// Which of pkg's method sets are interfaces that could be satisfied by a
+// type with methods `hashes`, or NULL if none can.
+static bool *find_possible_interfaces(Go_Package *pkg, List<u64> *hashes) {
+    auto sets = pkg->method_sets;
+    auto postings = pkg->method_postings;
+    if (!sets || !postings) return NULL;
+
+    auto matched = new_array(int, sets->len);
+    For (hashes) {
+        for (int i = find_method_posting(postings, it); i < postings->len; i++) {
+            auto &posting = postings->at(i);
+            if (posting.hash != it) break;
+            matched[posting.set]++;
+        }
+    }
+
+    auto ret = new_array(bool, sets->len);
+    bool found = false;
+
+    Fori (sets) {
+        if (!it.is_interface) continue;
+        if (!it.has_embeds && matched[i] != it.methods) continue;
+        ret[i] = true;
+        found = true;
+    }
+    return found ? ret : NULL;
+}
+
+// Which of pkg's method sets could implement an interface with methods
+// `hashes`, or NULL if none can.
+static bool *find_possible_implementations(Go_Package *pkg, List<u64> *hashes) {
+    auto sets = pkg->method_sets;
+    auto postings = pkg->method_postings;
+    if (!sets || !postings) return NULL;
+
+    auto ret = new_array(bool, sets->len);
+    bool found = false;
+
+    if (!hashes->len) {
+        for (int i = 0; i < sets->len; i++)
+            ret[i] = true;
+        return sets->len ? ret : NULL;
+    }
+
+    // go through the sets that have the first method, check for the rest
+    auto first = hashes->at(0);
+    for (int i = find_method_posting(postings, first); i < postings->len; i++) {
+        auto set = postings->at(i).set;
+        if (postings->at(i).hash != first) break;
+
+        bool ok = true;
+        for (int j = 1; j < hashes->len && ok; j++)
+            if (!pkg->has_method(set, hashes->at(j)))
+                ok = false;
+
+        if (!ok) continue;
+
+        ret[set] = true;
+        found = true;
+    }
+    return found ? ret : NULL;
+}
+
 List<Find_Decl> *Go_Indexer::find_interfaces(Goresult *target, bool search_everywhere) {
     if (!target->decl) return NULL;
     if (target->decl->type != GODECL_TYPE) return NULL;
@@ -3357,9 +6549,10 @@ List<Find_Decl> *Go_Indexer::find_interfaces(Goresult *target, bool search_every
         print("%s %s %s", filepath, decl->decl_start.str(), decl->name);
     }
 
+    auto hashes = hash_methods(methods);
     auto ret = new_list(Find_Decl);
 
-    For (index.packages) {
+    For (get_index()->packages) {
         if (it.status != GPS_READY) continue;
 
         auto import_path = it.import_path;
@@ -3369,6 +6562,12 @@ List<Find_Decl> *Go_Indexer::find_interfaces(Goresult *target, bool search_every
             if (!index_has_module_containing(import_path))
                 continue;
 
+        auto possible = find_possible_interfaces(&it, hashes);
+        if (!possible) continue;
+
+        auto pkg = &it;
+
+        load_package_files(&it);
         For (it.files) {
             auto ctx = new_object(Go_Ctx);
             ctx->import_path = import_path;
@@ -3382,6 +6581,9 @@ List<Find_Decl> *Go_Indexer::find_interfaces(Goresult *target, bool search_every
                 auto gotype = it.gotype;
                 if (gotype->type != GOTYPE_INTERFACE) continue;
 
+                auto set = pkg->find_method_set(it.name);
+                if (set == -1 || !possible[set]) continue;
+
                 // TODO: validate methods
 
                 auto match = [&]() {
@@ -3459,7 +6661,9 @@ List<Find_Decl> *Go_Indexer::find_implementations(Goresult *target, bool search_
         return ret;
     };
 
-    For (index.packages) {
+    auto hashes = hash_methods(methods);
+
+    For (get_index()->packages) {
         if (it.status != GPS_READY) continue;
 
         auto import_path = it.import_path;
@@ -3469,6 +6673,16 @@ List<Find_Decl> *Go_Indexer::find_implementations(Goresult *target, bool search_
             if (!index_has_module_containing(import_path))
                 continue;
 
+        auto possible = find_possible_implementations(&it, hashes);
+        if (!possible) continue;
+
+        auto pkg = &it;
+        auto is_possible = [&](ccstr type_name) {
+            auto set = pkg->find_method_set(type_name);
+            return set != -1 && possible[set];
+        };
+
+        load_package_files(&it);
         For (it.files) {
             auto ctx = new_object(Go_Ctx);
             ctx->import_path = import_path;
@@ -3478,6 +6692,8 @@ List<Find_Decl> *Go_Indexer::find_implementations(Goresult *target, bool search_
                 if (it.type != GODECL_FUNC && it.type != GODECL_TYPE) continue;
 
                 if (it.type == GODECL_TYPE) {
+                    if (!is_possible(it.name)) continue;
+
                     auto type_name = cp_sprintf("%s:%s", import_path, it.name);
                     auto type_info = get_type_info(type_name);
                     type_info->decl = make_goresult(&it, ctx);
@@ -3494,6 +6710,7 @@ List<Find_Decl> *Go_Indexer::find_implementations(Goresult *target, bool search_
                     recv = recv->pointer_base;
 
                 if (recv->type != GOTYPE_ID) continue;
+                if (!is_possible(recv->id_name)) continue;
 
                 auto type_name = cp_sprintf("%s:%s", import_path, recv->id_name);
                 auto method_name = it.name;
@@ -3535,6 +6752,7 @@ List<Find_Decl> *Go_Indexer::find_implementations(Goresult *target, bool search_
         };
 
         if (!match()) continue;
+        if (!info->decl) continue;
 
         auto parts = split_string(it->name, ':');
         if (parts->len != 2) continue;
@@ -3583,14 +6801,15 @@ Jump_To_Definition_Result* Go_Indexer::jump_to_symbol(ccstr symbol) {
         pkgname[len] = '\0';
     }
 
-    For (index.packages) {
+    For (get_index()->packages) {
         if (it.status != GPS_READY) continue;
 
-        if (!index.workspace->find_module_containing(it.import_path)) continue;
+        if (!get_index()->workspace->find_module_containing(it.import_path)) continue;
 
         if (!streq(it.package_name, pkgname)) continue;
 
         auto import_path = it.import_path;
+        load_package_files(&it);
         For (it.files) {
             auto filename = it.filename;
             For (it.decls) {
@@ -3624,16 +6843,6 @@ List<Find_References_File> *Go_Indexer::find_references(ccstr filepath, cur2 pos
     return find_references(result->decl, include_self);
 }
 
-// TODO: maybe we should have the caller call reload_all_editors(), wrapped
-// in a function like init_indexer_session() or something
-List<Call_Hier_Node>* Go_Indexer::generate_caller_hierarchy(Goresult *declres) {
-    reload_all_editors();
-
-    auto ret = new_list(Call_Hier_Node);
-    actually_generate_caller_hierarchy(declres, ret);
-    return ret;
-}
-
 Godecl *Go_Indexer::find_toplevel_containing(Go_File *file, cur2 start, cur2 end) {
     int lo = 0, hi = file->decls->len;
     while (lo <= hi) {
@@ -3650,148 +6859,383 @@ Godecl *Go_Indexer::find_toplevel_containing(Go_File *file, cur2 start, cur2 end
     return NULL;
 }
 
-void Go_Indexer::actually_generate_caller_hierarchy(Goresult *declres, List<Call_Hier_Node> *out) {
-    auto ref_files = actually_find_references(declres, false);
-    if (!ref_files) return;
-    // if (!ref_files->len) return;
+// Identifies a func or method the same way a Go_Call_Edge does.
+static ccstr call_graph_key(ccstr import_path, ccstr recv, ccstr name) {
+    return cp_sprintf("%s %s %s", import_path, recv ? recv : "", name);
+}
 
-    For (ref_files) {
-        auto filepath = it.filepath;
-        auto ctx = filepath_to_ctx(filepath);
-        Go_Package *pkg = NULL;
-        auto file = find_gofile_from_ctx(ctx, &pkg);
+// @Read
+// Needs the whole index to resolve the references, so it's what the
+// indexer does for every workspace package once it's idle.
+void Go_Indexer::compute_call_edges(Go_Package *pkg, List<Go_Call_Edge> *out) {
+    load_package_files(pkg);
+    if (!pkg->files) return;
 
-        if (!file || !pkg) continue;
+    auto files = new_list(Go_File*, max(pkg->files->len, 1));
+    For (pkg->files) files->append(&it);
+    files->sort([&](auto a, auto b) { return strcmp((*a)->filename, (*b)->filename); });
+
+    For (files) compute_file_call_edges(pkg->import_path, it, -1, out);
+}
 
-        For (it.results) {
-            auto &ref = it.reference;
+// @Read
+// Appends file's edges, or just the ones from its only_caller'th decl if
+// that isn't -1.
+void Go_Indexer::compute_file_call_edges(ccstr import_path, Go_File *file, int only_caller, List<Go_Call_Edge> *out) {
+    if (!file->decls || !file->references) return;
 
-            // get the bounds of the reference
-            cur2 start, end;
-            if (ref->is_sel) {
-                start = ref->x_start;
-                end = ref->sel_end;
-            } else {
-                start = ref->start;
-                end = ref->end;
-            }
+    Pool scratch;
+    scratch.init("call_edges_scratch");
+    defer { scratch.cleanup(); };
 
-            auto enclosing_decl = find_toplevel_containing(file, start, end);
-            if (!enclosing_decl)
-                continue;
+    import_path = go_intern(import_path);
+    auto filename = go_intern(file->filename);
 
-            auto declres = make_goresult(enclosing_decl, ctx);
+    Go_Ctx ctx; ptr0(&ctx);
+    ctx.import_path = import_path;
+    ctx.filename = file->filename;
 
-            auto fd = new_object(Find_Decl);
-            fd->filepath = filepath;
-            fd->decl = declres;
-            fd->package_name = pkg->package_name;
+    // references are sorted by position, and so are toplevels
+    int tidx = 0;
+    auto toplevels = file->decls;
+
+    Fori (file->references) {
+        auto &ref = it;
+        auto start = ref.true_start();
+
+        while (tidx < toplevels->len && toplevels->at(tidx).decl_end < start)
+            tidx++;
+        if (tidx == toplevels->len) break;
+        if (only_caller != -1 && tidx > only_caller) break;
+        if (only_caller != -1 && tidx < only_caller) continue;
 
-            Call_Hier_Node node;
-            node.decl = fd;
-            node.children = new_list(Call_Hier_Node);
-            node.ref = it.reference;
-            out->append(&node);
+        auto &tl = toplevels->at(tidx);
+        if (start < tl.decl_start) continue;
+        if (!ref.is_sel && ref.start == tl.name_start) continue;
 
-            if (enclosing_decl->gotype)
-                if (enclosing_decl->gotype->type == GOTYPE_FUNC)
-                    actually_generate_caller_hierarchy(declres, node.children);
+        ccstr callee_import_path = NULL, callee_recv = NULL, callee_name = NULL;
+        {
+            SCOPED_MEM(&scratch);
+
+            auto res = get_reference_decl(&ref, &ctx);
+            if (!res || !res->decl) continue;
+
+            auto decl = res->decl;
+            if (decl->type != GODECL_FUNC) continue;
+            if (!decl->gotype || decl->gotype->type != GOTYPE_FUNC) continue;
+
+            // interned, so they outlive scratch
+            callee_import_path = go_intern(res->ctx->import_path);
+            callee_recv = go_intern(get_godecl_recvname(decl));
+            callee_name = go_intern(decl->name);
         }
+
+        auto edge = out->append();
+        edge->filename = filename;
+        edge->caller = tidx;
+        edge->reference = i;
+        edge->callee_import_path = callee_import_path;
+        edge->callee_recv = callee_recv;
+        edge->callee_name = callee_name;
     }
 }
 
-List<Call_Hier_Node>* Go_Indexer::generate_callee_hierarchy(Goresult *declres) {
-    reload_all_editors();
+// @Write
+// Redoes pkg's call edges for filename after it's been reprocessed or
+// removed. Every other file's edges stay as they are, so this costs about
+// as much as resolving the one file. Packages resolve_call_edges() hasn't
+// gotten to yet are left for it.
+void Go_Indexer::update_call_edges(Go_Package *pkg, ccstr filename) {
+    auto old_edges = pkg->call_edges;
+    if (!old_edges) return;
+
+    Go_File *file = NULL;
+    if (pkg->files)
+        file = pkg->files->find([&](auto it) { return streq(it->filename, filename); });
+
+    auto pool = new_index_pool("go_package_call_edges");
+    {
+        SCOPED_MEM(pool);
 
-    auto ret = new_list(Call_Hier_Node);
-    actually_generate_callee_hierarchy(declres, ret);
-    return ret;
+        // still sorted by filename, the file's new edges go where its old
+        // ones were
+        auto edges = new_list(Go_Call_Edge, max(old_edges->len, 1));
+
+        int i = 0;
+        for (; i < old_edges->len && strcmp(old_edges->at(i).filename, filename) < 0; i++)
+            edges->append(&old_edges->at(i));
+        while (i < old_edges->len && streq(old_edges->at(i).filename, filename))
+            i++;
+
+        if (file) compute_file_call_edges(pkg->import_path, file, -1, edges);
+
+        for (; i < old_edges->len; i++)
+            edges->append(&old_edges->at(i));
+
+        pkg->call_edges = edges;
+    }
+
+    retire_pool(pkg->call_edges_pool);
+    pkg->call_edges_pool = pool;
+    snapshot_dirty = true;
 }
 
-void Go_Indexer::actually_generate_callee_hierarchy(Goresult *declres, List<Call_Hier_Node> *out, List<Seen_Callee_Entry> *seen) {
-    Go_Package *pkg = NULL;
-    auto file = find_gofile_from_ctx(declres->ctx, &pkg);
-    if (!file) return;
+// @Write
+void Go_Indexer::invalidate_decl_table(Go_Package *pkg) {
+    if (!pkg->decl_table) return;
 
-    // auto ctx = declres->ctx;
-    auto decl = declres->decl;
+    retire_pool(pkg->decl_table_pool);
+    pkg->decl_table_pool = NULL;
+    pkg->decl_table = NULL;
+    snapshot_dirty = true;
+}
 
-    int start_index = -1;
-    {
-        auto refs = file->references;
-        int lo = 0, hi = refs->len-1;
-        while (lo < hi) {
-            auto mid = (lo+hi)/2;
-            auto &it = file->references->at(mid);
-            if (it.true_start() < decl->decl_start)
-                lo = mid+1;
-            else
-                hi = mid-1;
+// @Write
+// Resolves call edges for workspace packages that don't have them, for up
+// to budget_milli. Returns whether there are any left.
+bool Go_Indexer::resolve_call_edges(u64 budget_milli) {
+    auto start = current_time_milli();
+
+    For (index.packages) {
+        yield_write_lock();
+
+        if (it.status != GPS_READY) continue;
+        if (it.call_edges) continue;
+        if (!index_has_module_containing(it.import_path)) continue;
+
+        if (current_time_milli() - start >= budget_milli)
+            return true;
+
+        auto pool = new_index_pool("go_package_call_edges");
+        {
+            SCOPED_MEM(pool);
+            auto edges = new_list(Go_Call_Edge);
+            compute_call_edges(&it, edges);
+            it.call_edges = edges;
         }
-        start_index = lo;
+
+        retire_pool(it.call_edges_pool);
+        it.call_edges_pool = pool;
+        snapshot_dirty = true;
     }
+    return false;
+}
 
-    if (!seen)
-        seen = new_list(Seen_Callee_Entry);
+Goresult *Go_Indexer::find_call_edge_callee(Go_Call_Edge *edge) {
+    auto decls = list_package_decls(edge->callee_import_path);
+    if (!decls) return NULL;
 
-    auto find_seen = [&](Goresult *res) -> Call_Hier_Node* {
-        For (seen) {
-            auto a = it.declres;
-            auto b = res;
+    For (decls) {
+        auto decl = it.decl;
+        if (decl->type != GODECL_FUNC) continue;
+        if (!streq(decl->name, edge->callee_name)) continue;
 
-            if (!streq(a->ctx->import_path, b->ctx->import_path)) continue;
-            if (!streq(a->ctx->filename, b->ctx->filename)) continue;
-            if (a->decl->name_start != b->decl->name_start) continue;
-            if (!streq(a->decl->name, b->decl->name)) continue;
+        auto recv = get_godecl_recvname(decl);
+        if (!recv != !edge->callee_recv) continue;
+        if (recv && !streq(recv, edge->callee_recv)) continue;
 
-            return &it.node;
-        }
-        return NULL;
-    };
+        return &it;
+    }
+    return NULL;
+}
 
-    for (int i = start_index; i < file->references->len; i++) {
-        auto &it = file->references->at(i);
-        if (it.true_start() >= decl->decl_end)
-            break;
+// Index of the first edge for (filename, caller), or edges->len.
+static int find_call_edge(List<Go_Call_Edge> *edges, ccstr filename, int caller) {
+    int lo = 0, hi = edges->len;
+    while (lo < hi) {
+        auto mid = (lo + hi) / 2;
+        auto &it = edges->at(mid);
+
+        auto cmp = strcmp(it.filename, filename);
+        if (!cmp) cmp = it.caller - caller;
+
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// TODO: maybe we should have the caller call reload_all_editors(), wrapped
+// in a function like init_indexer_session() or something
+//
+// Only goes one level deep; the rest of the tree gets filled in by
+// list_callers() as the user opens it, out of *callers.
+List<Call_Hier_Node>* Go_Indexer::generate_caller_hierarchy(Goresult *declres, Caller_Map **callers) {
+    reload_all_editors();
 
-        if (!it.is_sel && it.start == decl->name_start) continue;
+    auto map = new_object(Caller_Map);
+    map->table.init();
 
-        auto res = get_reference_decl(&it, declres->ctx);
-        if (!res) continue;
-        if (!index_has_module_containing(res->ctx->import_path)) continue;
+    For (get_index()->packages) {
+        if (it.status != GPS_READY) continue;
+        if (!index_has_module_containing(it.import_path)) continue;
 
-        auto decl = res->decl;
-        auto gotype = decl->gotype;
-        if (!gotype) continue;
-        if (gotype->type != GOTYPE_FUNC) continue;
+        auto pkg = &it;
+        auto import_path = cp_strdup(pkg->import_path);
 
-        auto existing = find_seen(res);
-        if (existing) {
-            out->append(existing);
+        // rather than resolve a whole package here, show what there is
+        // and let the indexer get to it
+        if (!pkg->call_edges) {
+            map->incomplete = true;
             continue;
         }
 
-        auto pkg = find_up_to_date_package(res->ctx->import_path);
-        if (!pkg) continue;
+        For (pkg->call_edges) {
+            auto key = call_graph_key(it.callee_import_path, it.callee_recv, it.callee_name);
+            auto list = map->table.get(key);
+            if (!list) {
+                list = new_list(Caller_Edge);
+                map->table.set(key, list);
+            }
+
+            auto edge = list->append();
+            edge->import_path = import_path;
+            edge->filename = cp_strdup(it.filename);
+            edge->generation = pkg->generation;
+            edge->caller = it.caller;
+            edge->reference = it.reference;
+        }
+    }
+
+    *callers = map;
+
+    auto decl = declres->decl;
+    auto key = call_graph_key(declres->ctx->import_path, get_godecl_recvname(decl), decl->name);
+    return list_callers(map, key);
+}
+
+// @Read
+// The callers of the function with call_graph_key() key. Edges into
+// packages that changed since callers was built are left out.
+List<Call_Hier_Node>* Go_Indexer::list_callers(Caller_Map *callers, ccstr key) {
+    auto ret = new_list(Call_Hier_Node);
+
+    auto edges = callers->table.get(key);
+    if (!edges) return ret;
+
+    For (edges) {
+        auto edge = &it;
+
+        auto pkg = find_package_in_index(edge->import_path);
+        if (!pkg || pkg->generation != edge->generation) continue;
+
+        load_package_files(pkg);
+        if (!pkg->files) continue;
+
+        auto file = pkg->files->find([&](auto it) { return streq(it->filename, edge->filename); });
+        if (!file) continue;
+
+        // shouldn't happen, the generation would've changed
+        if (!file->decls || edge->caller >= file->decls->len) continue;
+        if (!file->references || edge->reference >= file->references->len) continue;
+
+        auto ctx = new_object(Go_Ctx);
+        ctx->import_path = pkg->import_path;
+        ctx->filename = file->filename;
+
+        auto enclosing_decl = &file->decls->at(edge->caller);
 
         auto fd = new_object(Find_Decl);
-        fd->filepath = ctx_to_filepath(res->ctx);
-        fd->decl = res;
+        fd->filepath = ctx_to_filepath(ctx);
+        fd->decl = make_goresult(enclosing_decl, ctx);
         fd->package_name = pkg->package_name;
 
-        Call_Hier_Node node; ptr0(&node);
-        node.decl = fd;
-        node.children = new_list(Call_Hier_Node);
-        node.ref = &it;
-        out->append(&node);
+        auto node = ret->append();
+        node->decl = fd;
+        node->ref = &file->references->at(edge->reference);
+
+        if (enclosing_decl->gotype && enclosing_decl->gotype->type == GOTYPE_FUNC)
+            node->callers_key = call_graph_key(pkg->import_path, get_godecl_recvname(enclosing_decl), enclosing_decl->name);
+    }
+    return ret;
+}
+
+List<Call_Hier_Node>* Go_Indexer::generate_callee_hierarchy(Goresult *declres) {
+    reload_all_editors();
+
+    auto callees = new_table(Goresult*);
+
+    struct Todo {
+        Goresult *declres;
+        List<Call_Hier_Node> *out;
+    };
+
+    auto lists = new_table(List<Call_Hier_Node>*);
+    auto todo = new_list(Todo);
+
+    auto get_children = [&](Goresult *res) {
+        auto key = call_graph_key(res->ctx->import_path, get_godecl_recvname(res->decl), res->decl->name);
+
+        bool found = false;
+        auto ret = lists->get(key, &found);
+        if (!found) {
+            ret = new_list(Call_Hier_Node);
+            lists->set(key, ret);
+
+            auto t = todo->append();
+            t->declres = res;
+            t->out = ret;
+        }
+        return ret;
+    };
+
+    auto ret = get_children(declres);
+
+    for (int i = 0; i < todo->len; i++) {
+        auto t = todo->at(i);
+
+        Go_Package *pkg = NULL;
+        auto file = find_gofile_from_ctx(t.declres->ctx, &pkg);
+        if (!file || !pkg) continue;
+
+        auto decl = t.declres->decl;
+        auto toplevel = find_toplevel_containing(file, decl->decl_start, decl->decl_end);
+        if (!toplevel) continue;
+
+        auto caller = (int)(toplevel - file->decls->items);
+
+        // if the indexer hasn't gotten to the package, just resolve the one
+        // decl's references instead of the whole package
+        auto edges = pkg->call_edges;
+        if (!edges) {
+            edges = new_list(Go_Call_Edge);
+            compute_file_call_edges(pkg->import_path, file, caller, edges);
+        }
+
+        for (int j = find_call_edge(edges, file->filename, caller); j < edges->len; j++) {
+            auto edge = &edges->at(j);
+            if (edge->caller != caller || !streq(edge->filename, file->filename)) break;
+            if (edge->reference >= file->references->len) continue;
+            if (!index_has_module_containing(edge->callee_import_path)) continue;
+
+            auto key = call_graph_key(edge->callee_import_path, edge->callee_recv, edge->callee_name);
+
+            bool found = false;
+            auto res = callees->get(key, &found);
+            if (!found) {
+                res = find_call_edge_callee(edge);
+                callees->set(key, res);
+            }
+            if (!res) continue;
+
+            auto callee_pkg = find_up_to_date_package(res->ctx->import_path);
+            if (!callee_pkg) continue;
 
-        Seen_Callee_Entry se;
-        se.declres = res;
-        memcpy(&se.node, &node, sizeof(Call_Hier_Node));
-        seen->append(&se);
+            auto fd = new_object(Find_Decl);
+            fd->filepath = ctx_to_filepath(res->ctx);
+            fd->decl = res;
+            fd->package_name = callee_pkg->package_name;
 
-        actually_generate_callee_hierarchy(res, node.children, seen);
+            auto node = t.out->append();
+            node->decl = fd;
+            node->ref = &file->references->at(edge->reference);
+            node->children = get_children(res);
+        }
     }
+
+    return ret;
 }
 
 List<Find_References_File> *Go_Indexer::find_references(Goresult *declres, bool include_self) {
@@ -3822,7 +7266,9 @@ List<Find_References_File> *Go_Indexer::actually_find_references(Goresult *declr
     if (!decl) return NULL;
     if (decl->type == GODECL_IMPORT) return NULL;
 
-    auto decl_name = decl->name;
+    // references' names are interned (see Go_Reference::copy()), so they
+    // can be compared to this by pointer
+    auto decl_name = go_intern(decl->name);
     if (!decl_name) return NULL;
 
     auto ctx = declres->ctx;
@@ -3876,6 +7322,9 @@ List<Find_References_File> *Go_Indexer::actually_find_references(Goresult *declr
     };
 
     auto process = [&](Go_Package *pkg, Go_File *file) {
+        auto first_posting = find_reference_posting(file->reference_postings, decl_name);
+        if (first_posting == -1) return;
+
         Go_Ctx ctx2;
         ctx2.import_path = pkg->import_path;
         ctx2.filename = file->filename;
@@ -3908,7 +7357,7 @@ List<Find_References_File> *Go_Indexer::actually_find_references(Goresult *declr
         }
 
         auto process_ref = [&](Go_Reference *it) {
-            if (!streq(it->is_sel ? it->sel : it->name, decl_name))
+            if ((it->is_sel ? it->sel : it->name) != decl_name)
                 return;
 
             auto check_is_self = [&]() {
@@ -4003,7 +7452,13 @@ List<Find_References_File> *Go_Indexer::actually_find_references(Goresult *declr
             }
         };
 
-        For (file->references) process_ref(&it);
+        // only the references with the right name, see Go_Reference_Posting
+        auto postings = file->reference_postings;
+        for (int i = first_posting; i < postings->len; i++) {
+            auto &posting = postings->at(i);
+            if (posting.name != decl_name) break;
+            process_ref(&file->references->at(posting.index));
+        }
 
         if (results->len > 0) {
             Find_References_File out;
@@ -4021,13 +7476,18 @@ List<Find_References_File> *Go_Indexer::actually_find_references(Goresult *declr
     } else if (islower(decl_name[0])) {
         auto pkg = find_package_in_index(ctx->import_path);
         if (!pkg) return NULL;
+        if (!pkg->has_reference_to(decl_name)) return ret;
+        load_package_files(pkg);
         For (pkg->files) process(pkg, &it);
     } else {
-        For (index.packages) {
+        For (get_index()->packages) {
             if (it.status != GPS_READY) continue;
+            // before anything else, this doesn't need the files read in
+            if (!it.has_reference_to(decl_name)) continue;
             if (!index_has_module_containing(it.import_path))
                 continue;
             auto &pkg = it;
+            load_package_files(&it);
             For (it.files) process(&pkg, &it);
         }
     }
@@ -4050,8 +7510,9 @@ Go_Work_Module *Go_Workspace::find_module_containing_resolved(ccstr resolved_pat
 }
 
 bool Go_Indexer::index_has_module_containing(ccstr path) {
-    if (!index.workspace) return false;
-    return (index.workspace->find_module_containing(path) != NULL);
+    auto workspace = get_index()->workspace;
+    if (!workspace) return false;
+    return (workspace->find_module_containing(path) != NULL);
 }
 
 List<Go_Import> *Go_Indexer::optimize_imports(ccstr filepath) {
@@ -4248,27 +7709,83 @@ List<Go_Import> *Go_Indexer::optimize_imports(ccstr filepath) {
     return ret;
 }
 
-ccstr Go_Indexer::find_best_import(ccstr package_name, List<ccstr> *identifiers) {
-    List<Go_Package*> candidates; candidates.init();
-    List<int> indexes; indexes.init();
+// The packages that could be imported, see Go_Package_Name.
+List<Go_Package_Name> *Go_Indexer::build_package_names(Go_Index *index) {
+    auto packages = index->packages;
+    auto ret = new_list(Go_Package_Name, packages ? max(packages->len, 1) : 1);
+    if (!packages) return ret;
 
-    For (index.packages) {
+    Fori (packages) {
         if (it.status != GPS_READY) continue;
         if (!it.package_name) continue;
-        if (!streq(it.package_name, package_name)) continue;
+        if (it.package_name[0] == '@') continue;
+        if (!it.in_workspace && is_import_path_internal(it.import_path)) continue;
 
-        if (!index_has_module_containing(it.import_path))
-            if (is_import_path_internal(it.import_path))
-                continue;
+        auto name = ret->append();
+        name->package_name = it.package_name;
+        name->package = i;
+    }
+
+    ret->sort([&](auto a, auto b) {
+        if (a->package_name != b->package_name)
+            return a->package_name < b->package_name ? -1 : 1;
+        return a->package - b->package;
+    });
+    return ret;
+}
+
+// @Read
+// Go_Package_Name::package indexes into *packages, which comes from the same
+// snapshot, so look them up together.
+List<Go_Package_Name> *Go_Indexer::get_package_names(List<Go_Package> **packages) {
+    if (owns_working_index) {
+        *packages = index.packages;
+        return build_package_names(&index);
+    }
+
+    auto snap = get_pinned_snapshot();
+    *packages = snap->index.packages;
+    return snap->package_names;
+}
+
+// @Read
+List<Go_Package_Name> *Go_Indexer::find_package_names(ccstr package_name, List<Go_Package> **packages) {
+    auto names = get_package_names(packages);
+    auto name = go_intern(package_name);
+
+    int lo = 0, hi = names->len;
+    while (lo < hi) {
+        auto mid = (lo + hi) / 2;
+        if (names->at(mid).package_name < name)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    auto ret = new_list(Go_Package_Name);
+    for (int i = lo; i < names->len && names->at(i).package_name == name; i++)
+        ret->append(&names->at(i));
+    return ret;
+}
+
+ccstr Go_Indexer::find_best_import(ccstr package_name, List<ccstr> *identifiers) {
+    List<Go_Package> *packages = NULL;
+    auto names = find_package_names(package_name, &packages);
+
+    List<Go_Package*> candidates; candidates.init();
+    List<int> indexes; indexes.init();
 
-        candidates.append(&it);
+    For (names) {
+        candidates.append(&packages->at(it.package));
         indexes.append(indexes.len);
     }
 
     if (!candidates.len) return NULL;
 
     String_Set all_identifiers; all_identifiers.init();
-    For (identifiers) all_identifiers.add(it);
+    For (identifiers)
+        if (!is_name_private(it))
+            all_identifiers.add(it);
 
     struct Score {
         bool in_goroot;
@@ -4278,32 +7795,20 @@ ccstr Go_Indexer::find_best_import(ccstr package_name, List<ccstr> *identifiers)
 
     auto scores = new_array(Score, candidates.len);
 
+    auto idents = all_identifiers.items();
+
     for (int i = 0; i < candidates.len; i++) {
-        auto it = candidates[i];
+        auto pkg = candidates[i];
 
         auto &score = scores[i];
         ptr0(&score);
 
-        if (it->files) {
-            For (it->files) {
-                if (!it.decls) continue;
-                For (it.decls) {
-                    if (it.type == GODECL_FUNC)
-                        if (!it.gotype->func_recv)
-                            continue;
-                    if (all_identifiers.has(it.name))
-                        score.matching_idents++;
-                }
-            }
-        }
-
-        if (index_has_module_containing(it->import_path))
-            score.in_workspace = true;
+        For (idents)
+            if (pkg->has_decl(it))
+                score.matching_idents++;
 
-        auto package_path = get_package_path(it->import_path);
-        if (package_path)
-            if (path_has_descendant(package_path, goroot))
-                score.in_goroot = true;
+        score.in_workspace = pkg->in_workspace;
+        score.in_goroot = pkg->in_goroot;
     };
 
     auto compare_scores = [&](Score *a, Score *b) {
@@ -5196,11 +8701,11 @@ Gotype *Go_Indexer::get_closest_function(ccstr filepath, cur2 pos) {
 
 // this fills possible types
 void Go_Indexer::fill_generate_implementation(List<Go_Symbol> *out, bool selected_interface) {
-    For (index.packages) {
+    For (get_index()->packages) {
         if (it.status != GPS_READY) continue;
 
         if (selected_interface)
-            if (!index.workspace->find_module_containing(it.import_path))
+            if (!get_index()->workspace->find_module_containing(it.import_path))
                 continue;
 
         auto pkg = &it;
@@ -5209,6 +8714,7 @@ void Go_Indexer::fill_generate_implementation(List<Go_Symbol> *out, bool selecte
         ctx.import_path = it.import_path;
 
         auto pkgname = it.package_name;
+        load_package_files(&it);
         For (it.files) {
             ctx.filename = it.filename;
             auto filehash = it.hash;
@@ -5244,59 +8750,253 @@ void Go_Indexer::fill_generate_implementation(List<Go_Symbol> *out, bool selecte
     }
 }
 
-void Go_Indexer::fill_goto_symbol(List<Go_Symbol> *out) {
-    auto packages = new_list(Go_Package*);
-    For (index.packages)
-        if (index.workspace->find_module_containing(it.import_path))
-            packages->append(&it);
+u64 symbol_char_mask(ccstr s) {
+    u64 ret = 0;
+    for (; *s; s++) {
+        auto c = tolower((uchar)*s);
+        if (c >= 'a' && c <= 'z')
+            ret |= (u64)1 << (c - 'a');
+        else if (c >= '0' && c <= '9')
+            ret |= (u64)1 << (26 + c - '0');
+        else if (c == '_')
+            ret |= (u64)1 << 36;
+        else if (c == '.')
+            ret |= (u64)1 << 37;
+        else
+            ret |= (u64)1 << 38;
+    }
+    return ret;
+}
 
-    For (packages) {
-        auto pkg = it;
+List<u64> *symbol_block_masks(List<Go_Symbol_Entry> *symbols) {
+    auto blocks = (symbols->len + GOTO_SYMBOL_BLOCK_SIZE - 1) / GOTO_SYMBOL_BLOCK_SIZE;
+    auto ret = new_list(u64, max(blocks, 1));
+    Fori (symbols) {
+        if (i % GOTO_SYMBOL_BLOCK_SIZE == 0)
+            ret->append((u64)0);
+        *ret->last() |= it.mask;
+    }
+    return ret;
+}
 
-        auto pkgname = pkg->package_name;
-        auto import_path = pkg->import_path;
+static u64 hash_decl_name(ccstr name) {
+    return hash64((void*)name, strlen(name));
+}
 
-        For (pkg->files) {
-            auto ctx = new_object(Go_Ctx);
-            ctx->filename = it.filename;
-            ctx->import_path = import_path;
+// Same decls list_package_decls(LISTDECLS_EXCLUDE_METHODS) would give.
+static bool goes_in_decl_table(Godecl *decl) {
+    if (!decl->name) return false;
+    if (decl->type == GODECL_FUNC && decl->gotype && decl->gotype->func_recv) return false;
+    return true;
+}
 
-            auto filepath = ctx_to_filepath(ctx);
+// The slot name is in, or the empty one it would go in.
+static Go_Decl_Slot *find_decl_slot(List<Go_Decl_Slot> *table, ccstr name) {
+    auto mask = table->len - 1;
+    auto hash = hash_decl_name(name);
 
-            For (it.decls) {
-                if (streq(it.name, "_")) continue;
+    for (auto i = hash & mask;; i = (i + 1) & mask) {
+        auto slot = &table->at(i);
+        if (slot->file == -1) return slot;
+        if (slot->hash == hash && streq(slot->name, name)) return slot;
+    }
+}
 
-                auto getrecv = [&]() -> ccstr {
-                    if (it.type != GODECL_FUNC) return NULL;
-                    if (!it.gotype) return NULL;
-                    if (it.gotype->type != GOTYPE_FUNC) return NULL;
+// @Write
+void Go_Indexer::rebuild_decl_table(Go_Package *pkg) {
+    retire_pool(pkg->decl_table_pool);
+    pkg->decl_table = NULL;
+    pkg->decl_table_pool = NULL;
+    snapshot_dirty = true;
 
-                    auto recv = it.gotype->func_recv;
-                    if (!recv) return NULL;
+    load_package_files(pkg);
+    if (!pkg->files) return;
 
-                    recv = unpointer_type(recv);
-                    if (!recv) return NULL;
-                    if (recv->type == GOTYPE_GENERIC) recv = recv->base;
-                    if (recv->type != GOTYPE_ID) return NULL;
+    auto pool = new_index_pool("go_package_decl_table");
+    SCOPED_MEM(pool);
 
-                    return recv->id_name;
-                };
+    pkg->decl_table = new_decl_table(pkg->files);
+    pkg->decl_table_pool = pool;
+}
 
-                ccstr name = NULL;
-                auto recvname = getrecv();
-                if (recvname)
-                    name = cp_sprintf("%s.%s", recvname, it.name);
-                else
-                    name = cp_sprintf("%s", it.name);
+List<Go_Decl_Slot> *new_decl_table(List<Go_File> *files) {
+    int count = 0;
+    For (files)
+        if (it.decls)
+            For (it.decls)
+                if (goes_in_decl_table(&it))
+                    count++;
 
-                Go_Symbol sym;
-                sym.pkgname = pkgname;
-                sym.filepath = filepath;
-                sym.name = name;
-                sym.decl = make_goresult(&it, ctx);
-                sym.filehash = 0; // ???
-                out->append(&sym);
+    int cap = 2;
+    while (cap < count * 2) cap *= 2;
+
+    auto table = new_list(Go_Decl_Slot, cap);
+    for (int i = 0; i < cap; i++)
+        table->append()->file = -1;
+
+    for (int i = 0; i < files->len; i++) {
+        auto decls = files->at(i).decls;
+        if (!decls) continue;
+
+        for (int j = 0; j < decls->len; j++) {
+            auto decl = &decls->at(j);
+            if (!goes_in_decl_table(decl)) continue;
+
+            // first one wins, like the linear search did
+            auto slot = find_decl_slot(table, decl->name);
+            if (slot->file != -1) continue;
+
+            slot->name = go_intern(decl->name);
+            slot->hash = hash_decl_name(decl->name);
+            slot->file = i;
+            slot->decl = j;
+        }
+    }
+    return table;
+}
+
+// Returns NULL without a decl_table, let the caller fall back to a search.
+Godecl *Go_Package::find_decl(ccstr name, ccstr *filename) {
+    if (!decl_table || !files) return NULL;
+
+    auto slot = find_decl_slot(decl_table, name);
+    if (slot->file == -1) return NULL;
+    if (slot->file >= files->len) return NULL;
+
+    auto &file = files->at(slot->file);
+    if (!file.decls || slot->decl >= file.decls->len) return NULL;
+
+    *filename = file.filename;
+    return &file.decls->at(slot->decl);
+}
+
+bool Go_Package::has_decl(ccstr name) {
+    if (!decl_table) return false;
+    return find_decl_slot(decl_table, name)->file != -1;
+}
+
+// Everything the package's pools have taken, for Index_Metrics. Can be off
+// by a bit if something's reading files in at the same time.
+u64 Go_Package::mem_allocated() {
+    u64 ret = 0;
+
+    auto add = [&](Pool *pool) {
+        if (pool) ret += pool->mem_allocated;
+    };
+
+    if (use_pool) add(pool);
+
+    auto files = loaded_files();
+    if (files)
+        For (files)
+            if (it.use_pool)
+                add(it.pool);
+
+    if (lazy_files) add(lazy_files->pool);
+    add(reference_names_pool);
+    add(method_sets_pool);
+    add(call_edges_pool);
+    add(symbols_pool);
+    add(decl_table_pool);
+    return ret;
+}
+
+// @Write
+void Go_Indexer::rebuild_symbols(Go_Package *pkg) {
+    auto old_pool = pkg->symbols_pool;
+    defer { retire_pool(old_pool); };
+
+    pkg->symbols = NULL;
+    pkg->symbols_pool = NULL;
+    snapshot_dirty = true;
+
+    if (!index_has_module_containing(pkg->import_path)) return;
+
+    load_package_files(pkg);
+    if (!pkg->files) return;
+
+    auto pool = new_index_pool("go_package_symbols");
+    SCOPED_MEM(pool);
+
+    int count = 0;
+    For (pkg->files)
+        if (it.decls)
+            count += it.decls->len;
+
+    auto symbols = new_list(Go_Symbol_Entry, max(count, 1));
+
+    For (pkg->files) {
+        if (!it.decls) continue;
+
+        auto filename = go_intern(it.filename);
+
+        For (it.decls) {
+            if (!it.name) continue;
+            if (streq(it.name, "_")) continue;
+
+            ccstr recvname = NULL;
+            if (it.type == GODECL_FUNC && it.gotype && it.gotype->type == GOTYPE_FUNC) {
+                auto recv = unpointer_type(it.gotype->func_recv);
+                if (recv && recv->type == GOTYPE_GENERIC) recv = recv->base;
+                if (recv && recv->type == GOTYPE_ID) recvname = recv->id_name;
+            }
+
+            ccstr name = it.name;
+
+            {
+                SCOPED_FRAME();
+                if (recvname) name = cp_sprintf("%s.%s", recvname, name);
+                name = go_intern(name);
             }
+
+            auto sym = symbols->append();
+            sym->name = name;
+            sym->filename = filename;
+            sym->name_start = it.name_start;
+            sym->decl_type = it.type;
+            sym->mask = symbol_char_mask(name);
+        }
+    }
+
+    pkg->symbols = symbols;
+    pkg->symbols_pool = pool;
+}
+
+// @Read
+// Just copies the lists the indexer keeps, see Go_Package::symbols.
+void Go_Indexer::fill_goto_symbol(List<Go_Symbol_Entry> *out) {
+    auto index = get_index();
+
+    int count = 0;
+    For (index->packages)
+        if (it.status == GPS_READY && it.symbols)
+            count += it.symbols->len;
+
+    out->ensure_cap(count);
+
+    For (index->packages) {
+        if (it.status != GPS_READY) continue;
+        if (!it.symbols || !it.symbols->len) continue;
+        if (!index->workspace->find_module_containing(it.import_path)) continue;
+
+        auto package_path = get_package_path(it.import_path);
+        if (!package_path) continue;
+        package_path = go_intern(package_path);
+
+        auto package_name = it.package_name;
+        if (!package_name) continue;
+
+        auto extra_mask = symbol_char_mask(package_name) | symbol_char_mask(".");
+
+        auto start = out->len;
+        out->concat(it.symbols);
+
+        for (int i = start; i < out->len; i++) {
+            auto &sym = out->at(i);
+            sym.import_path = it.import_path;
+            sym.package_name = package_name;
+            sym.package_path = package_path;
+            sym.mask |= extra_mask;
         }
     }
 }
@@ -5594,7 +9294,8 @@ bool Go_Indexer::autocomplete(ccstr filepath, cur2 pos, bool triggered_by_period
 
         String_Set existing_imports; existing_imports.init();
 
-        auto gofile = find_gofile_from_ctx(ctx);
+        Go_Package *gofile_pkg = NULL;
+        auto gofile = find_gofile_from_ctx(ctx, &gofile_pkg);
         if (gofile) {
             SCOPED_FRAME_WITH_MEM(&scoped_table_mem);
             Scoped_Table<Go_Scope_Op*> table;
@@ -5604,7 +9305,8 @@ bool Go_Indexer::autocomplete(ccstr filepath, cur2 pos, bool triggered_by_period
             }
             defer { table.cleanup(); };
 
-            For (gofile->scope_ops) {
+            auto scope_ops = get_scope_ops(gofile_pkg, gofile);
+            if (scope_ops) For (scope_ops) {
                 if (it.pos > pos) break;
 
                 switch (it.type) {
@@ -5746,25 +9448,18 @@ bool Go_Indexer::autocomplete(ccstr filepath, cur2 pos, bool triggered_by_period
         }
 
         // workspace or are immediate deps?
-        For (index.packages) {
-            if (!it.import_path) continue;
-            if (existing_imports.has(it.import_path)) continue;
-            if (it.status != GPS_READY) continue;
-            if (!it.package_name) continue;
-            if (streq(it.import_path, ctx->import_path)) continue;
-            if (it.package_name[0] == '@') continue;
-
-            // gofile->imports
-            // TODO: check if import already exists in file
+        List<Go_Package> *packages = NULL;
+        auto names = get_package_names(&packages);
 
-            if (!index_has_module_containing(it.import_path))
-                if (is_import_path_internal(it.import_path))
-                    continue;
+        For (names) {
+            auto &pkg = packages->at(it.package);
+            if (existing_imports.has(pkg.import_path)) continue;
+            if (streq(pkg.import_path, ctx->import_path)) continue;
 
             auto res = ac_results->append();
-            res->name = it.package_name;
+            res->name = pkg.package_name;
             res->type = ACR_IMPORT;
-            res->import_path = it.import_path;
+            res->import_path = pkg.import_path;
         }
 
         do {
@@ -6429,6 +10124,79 @@ Go_File *Go_Indexer::find_gofile_from_ctx(Go_Ctx *ctx, Go_Package **out) {
     return ret;
 }
 
+// Returns NULL if the file can't be parsed anymore. Caller is reading the
+// index, and can use what's returned until it stops.
+List<Go_Scope_Op> *Go_Indexer::get_scope_ops(Go_Package *pkg, Go_File *file) {
+    if (file->scope_ops) return file->scope_ops;
+
+    auto &cache = scope_ops_cache;
+
+    // package_hash is folded into the key, so a changed package misses
+    auto key = Scope_Ops_Cache::make_key(pkg->import_path, file->filename, pkg->hash);
+    auto find = [&]() -> Scope_Ops_Cache::Entry* {
+        auto ret = cache.find(key, pkg->import_path, file->filename);
+        if (ret && ret->package_hash != pkg->hash) return NULL;
+        return ret;
+    };
+
+    {
+        SCOPED_LOCK(&cache.lock);
+        auto entry = find();
+        if (entry) return entry->scope_ops;
+    }
+
+    // parse outside the lock, other readers might only want what's cached
+    auto package_path = get_package_path(pkg->import_path);
+    if (!package_path) return NULL;
+
+    auto pool = (Pool*)cp_malloc(sizeof(Pool));
+    pool->init("scope_ops_cache");
+
+    List<Go_Scope_Op> *scope_ops = NULL;
+    {
+        SCOPED_FRAME();
+
+        auto pf = parse_file(path_join(package_path, file->filename), LANG_GO, false);
+        if (pf) {
+            defer { free_parsed_file(pf); };
+
+            auto ops = iterate_over_scope_ops2(pf->root, file->filename);
+
+            SCOPED_MEM(pool);
+            scope_ops = copy_list(ops);
+        }
+    }
+
+    if (!scope_ops) {
+        pool->cleanup();
+        cp_free(pool);
+        return NULL;
+    }
+
+    SCOPED_LOCK(&cache.lock);
+
+    // somebody else got to it first; nobody's seen ours yet
+    auto entry = find();
+    if (entry) {
+        pool->cleanup();
+        cp_free(pool);
+        return entry->scope_ops;
+    }
+
+    {
+        SCOPED_MEM(pool);
+
+        entry = cache.add(key);
+        entry->import_path = cp_strdup(pkg->import_path);
+        entry->filename = cp_strdup(file->filename);
+        entry->package_hash = pkg->hash;
+        entry->last_used = ++cache.clock;
+        entry->pool = pool;
+        entry->scope_ops = scope_ops;
+    }
+    return scope_ops;
+}
+
 ccstr Go_Indexer::filepath_to_import_path(ccstr path_str) {
     auto ret = module_resolver.resolved_path_to_import_path(path_str);
     if (ret) return ret;
@@ -6456,6 +10224,19 @@ void Go_Indexer::init() {
     ui_mem.init("ui_mem");
     scoped_table_mem.init("scoped_table_mem");
     package_lookup_mem.init("package_lookup_mem");
+    index_pools_mem.init("index_pools_mem");
+    index_pools_lock.init();
+    index_source_lock.init();
+    index_atom_map.init();
+    atoms.init();
+    eval_cache.init();
+    scope_ops_cache.init();
+    metrics.init();
+    write_lock.init();
+    readers_cond.init();
+    write_lock_cond.init();
+    finished_initial_index_cond.init();
+    retired.init(LIST_MALLOC, 64);
 
     SCOPED_MEM(&mem);
 
@@ -6476,6 +10257,15 @@ void Go_Indexer::init() {
     if (!init_buildenv())
         cp_exit("Please make sure Go version 1.13+ is installed and accessible through your PATH.");
 
+    build_cache.init();
+    {
+        auto tags = GHBuildEnvGetTags();
+        if (tags) {
+            build_cache.set_tags_hash(hash64((void*)tags, strlen(tags)));
+            GHFree(tags);
+        }
+    }
+
     auto copystr = [&](ccstr s) {
         auto ret = cp_strdup(s);
         GHFree((void*)s);
@@ -6506,6 +10296,8 @@ void Go_Indexer::init() {
             // This is called from main thread, so we can just call tell_user().
             tell_user(msg, "Warning");
         }
+
+        shared_cache.init(core.configdir, build_cache.tags_hash, goroot_without_src);
     }
 
     lock.init();
@@ -6513,44 +10305,352 @@ void Go_Indexer::init() {
     start_writing();
 }
 
+Go_Index *Go_Indexer::get_index() {
+    if (owns_working_index) return &index;
+    return &get_pinned_snapshot()->index;
+}
+
+Index_Snapshot *Go_Indexer::get_pinned_snapshot() {
+    if (!pinned_snapshot)
+        cp_panic("reading the index without holding a read lock on this thread");
+    return pinned_snapshot;
+}
+
+// Moves this thread's read lock (and its pin) over to another thread. The
+// caller passes the result to adopt_read_lock() on the new thread, which then
+// does the release_lock().
+Index_Snapshot *Go_Indexer::hand_off_read_lock() {
+    auto ret = pinned_snapshot;
+    cp_assert(ret && pinned_depth > 0);
+
+    if (!--pinned_depth) pinned_snapshot = NULL;
+    return ret;
+}
+
+void Go_Indexer::adopt_read_lock(Index_Snapshot *snap) {
+    cp_assert(snap);
+    cp_assert(!pinned_depth || pinned_snapshot == snap);
+
+    pinned_snapshot = snap;
+    pinned_depth++;
+}
+
+void Go_Indexer::enter_write_lock() {
+    write_lock.enter();
+    owns_working_index = true;
+}
+
+bool Go_Indexer::try_enter_write_lock() {
+    if (!write_lock.try_enter()) return false;
+    owns_working_index = true;
+    return true;
+}
+
+// For the main thread, which can't block on the background thread for as
+// long as it might hold write_lock. Asks it to let go at the next
+// yield_write_lock(), which it gets to between packages, and gives up after
+// timeout_milli.
+bool Go_Indexer::wait_for_write_lock(u32 timeout_milli) {
+    if (try_enter_write_lock()) return true;
+
+    SCOPED_LOCK(&lock);
+
+    write_lock_wanted = true;
+    defer {
+        write_lock_wanted = false;
+        write_lock_cond.broadcast();
+    };
+
+    auto deadline = current_time_milli() + timeout_milli;
+    while (!try_enter_write_lock()) {
+        auto now = current_time_milli();
+        if (now >= deadline) return false;
+        write_lock_cond.wait(&lock, deadline - now);
+    }
+    return true;
+}
+
+// Returns false if the initial index isn't done after timeout_milli.
+bool Go_Indexer::wait_for_initial_index(u32 timeout_milli) {
+    SCOPED_LOCK(&lock);
+
+    auto deadline = current_time_milli() + timeout_milli;
+    while (!finished_initial_index) {
+        auto now = current_time_milli();
+        if (now >= deadline) return false;
+        finished_initial_index_cond.wait(&lock, deadline - now);
+    }
+    return true;
+}
+
+// @Write
+// For the background thread, between steps that leave the index in one
+// piece. If the main thread is in wait_for_write_lock(), hands it write_lock
+// and takes it back once it's done.
+void Go_Indexer::yield_write_lock() {
+    lock.enter();
+    if (!write_lock_wanted) {
+        lock.leave();
+        return;
+    }
+
+    leave_write_lock();
+    write_lock_cond.broadcast();
+    while (write_lock_wanted)
+        write_lock_cond.wait(&lock);
+    lock.leave();
+
+    // the main thread might still be in there, and it takes `lock` too
+    enter_write_lock();
+}
+
+void Go_Indexer::leave_write_lock() {
+    owns_working_index = false;
+    write_lock.leave();
+}
+
+// Copies the package table, but not what the packages point to. Needs
+// write_lock.
+Index_Snapshot *Go_Indexer::build_snapshot() {
+    auto snap = (Index_Snapshot*)cp_malloc(sizeof(Index_Snapshot));
+    ptr0(snap);
+    snap->mem.init("index_snapshot");
+
+    SCOPED_MEM(&snap->mem);
+
+    auto len = index.packages ? index.packages->len : 0;
+    snap->index.workspace = index.workspace;
+    snap->index.packages = new_list(Go_Package, len);
+    snap->package_lookup.init();
+
+    if (index.packages) {
+        Fori (index.packages) {
+            snap->index.packages->append(&it);
+            snap->package_lookup.set(it.import_path, i);
+        }
+    }
+
+    snap->package_names = build_package_names(&snap->index);
+    return snap;
+}
+
+// Nothing retired so far is in the new snapshot, so it can all go once the
+// readers still looking at older ones are done. Caller holds `lock`.
+void Go_Indexer::install_snapshot(Index_Snapshot *snap) {
+    if (snapshot) {
+        Index_Retiree r; ptr0(&r);
+        r.snapshot = snapshot;
+        retired.append(&r);
+    }
+
+    retired_published = retired.len;
+    snapshot = snap;
+}
+
+void Go_Indexer::publish_snapshot() {
+    auto snap = build_snapshot();
+    {
+        SCOPED_LOCK(&lock);
+        install_snapshot(snap);
+
+        // A reader that published (e.g. by reloading editors) should see
+        // what it published; what it had pinned stays around as long as it
+        // holds the read lock.
+        if (pinned_depth > 0)
+            pinned_snapshot = snap;
+    }
+
+    snapshot_dirty = false;
+    last_publish_milli = current_time_milli();
+}
+
+// For things the current snapshot might still point to. Needs write_lock.
+void Go_Indexer::retire(Index_Retiree *retiree) {
+    SCOPED_LOCK(&lock);
+    retired.append(retiree);
+    snapshot_dirty = true;
+}
+
+void Go_Indexer::retire_pool(Pool *pool) {
+    if (!pool) return;
+
+    Index_Retiree r; ptr0(&r);
+    r.pool = pool;
+    retire(&r);
+}
+
+// Instead of Go_Package::cleanup(), for a package in `index` that's about to
+// be replaced or removed.
+void Go_Indexer::retire_package(Go_Package *pkg) {
+    auto lazy = pkg->lazy_files;
+
+    if (pkg->use_pool) {
+        retire_pool(pkg->pool);
+    } else if (pkg->files) {
+        For (pkg->files)
+            if (it.use_pool && (!lazy || !lazy->owns(&it)))
+                retire_pool(it.pool);
+    }
+
+    retire_pool(pkg->reference_names_pool);
+    retire_pool(pkg->method_sets_pool);
+    retire_pool(pkg->call_edges_pool);
+    retire_pool(pkg->symbols_pool);
+    retire_pool(pkg->decl_table_pool);
+
+    // older copies of the package can still read the files in, so these go
+    // as a whole, along with whatever got read in by then; older copies also
+    // still stamp last_used_milli
+    if (lazy || pkg->last_used_milli) {
+        Index_Retiree r; ptr0(&r);
+        r.lazy_files = lazy;
+        r.last_used_milli = pkg->last_used_milli;
+        retire(&r);
+    }
+}
+
+void Index_Retiree::cleanup() {
+    if (pool) pool->cleanup();
+    if (lazy_files) {
+        lazy_files->cleanup();
+        cp_free(lazy_files);
+    }
+    if (last_used_milli) cp_free(last_used_milli);
+    if (snapshot) {
+        snapshot->mem.cleanup();
+        cp_free(snapshot);
+    }
+}
+
+// Frees what's been retired if nobody's reading. Called by the background
+// thread, which gets woken up when the last reader leaves.
+void Go_Indexer::reclaim_retired() {
+    List<Index_Retiree> garbage;
+
+    {
+        SCOPED_LOCK(&lock);
+        if (readers > 0) return;
+
+        // nobody's evaluating anything, good time to start eval_cache over
+        if (eval_cache.full) {
+            index_print("eval cache full: %llu hits, %llu misses, %llu stale", eval_cache.hits, eval_cache.misses, eval_cache.stale);
+            eval_cache.clear();
+        }
+
+        scope_ops_cache.free_evicted();
+
+        if (!retired_published) return;
+
+        // new readers only see the current snapshot, so the actual freeing
+        // can happen outside the lock
+        garbage.init(LIST_MALLOC, retired_published);
+        for (int i = 0; i < retired_published; i++)
+            garbage.append(&retired[i]);
+
+        auto rest = retired.len - retired_published;
+        memmove(retired.items, retired.items + retired_published, sizeof(Index_Retiree) * rest);
+        retired.len = rest;
+        retired_published = 0;
+    }
+
+    For (&garbage) it.cleanup();
+    garbage.cleanup();
+}
+
+// For the few changes that can't be made without pulling the rug out from
+// under readers: replacing module_resolver or the workspace, or throwing out
+// the whole index. Waits for current readers to finish and turns new ones
+// away until leave_exclusive(). Needs write_lock.
+void Go_Indexer::enter_exclusive() {
+    SCOPED_LOCK(&lock);
+
+    exclusive = true;
+    while (readers > 0)
+        readers_cond.wait(&lock);
+}
+
+void Go_Indexer::leave_exclusive() {
+    publish_snapshot();
+    {
+        SCOPED_LOCK(&lock);
+        exclusive = false;
+    }
+    reclaim_retired();
+}
+
+// Caller holds `lock`.
+void Go_Indexer::update_status() {
+    if (reacquires > 0)
+        status = IND_WRITING;
+    else if (readers > 0)
+        status = IND_READING;
+    else
+        status = IND_READY;
+}
+
+// IND_WRITING only marks that the background thread is in the middle of
+// indexing, it doesn't keep anyone from reading. IND_READING keeps whatever
+// the reader sees (see get_index()) from being freed until it's released,
+// and can be held by any number of readers on any threads at once. Readers
+// are only turned away before the first snapshot is published and during
+// enter_exclusive(), so just_try doesn't change anything anymore.
 bool Go_Indexer::acquire_lock(Indexer_Status new_status, bool just_try) {
     go_print("[acquire] %s", indexer_status_str(new_status));
 
-    if (status == new_status) {
-        // read lock can only be acquired once
-        if (status == IND_READING)
-            return false;
+    SCOPED_LOCK(&lock);
 
+    if (new_status == IND_WRITING) {
+        if (!reacquires)
+            time_started_writing_milli = current_time_milli();
         reacquires++;
-        return true;
-    }
-
-    if (just_try) {
-        if (!lock.try_enter())
-            return false;
     } else {
-        lock.enter();
+        if (!snapshot || exclusive)
+            return false;
+        readers++;
+
+        if (!pinned_depth++)
+            pinned_snapshot = snapshot;
     }
 
-    time_started_writing_milli = current_time_milli();
-    status = new_status;
-    reacquires++;
-    return true;
-}
+    update_status();
+    return true;
+}
+
+void Go_Indexer::release_lock(Indexer_Status expected_status) {
+    go_print("[release] %s", indexer_status_str(expected_status));
+
+    bool wake_up_indexer = false;
+
+    {
+        SCOPED_LOCK(&lock);
+
+        auto &count = (expected_status == IND_WRITING ? reacquires : readers);
+        if (count <= 0) {
+            auto msg = "Go_Indexer::release_lock() called without holding lock (want %d, got %d)";
+            msg = cp_sprintf(msg, expected_status, status);
+            cp_panic(msg);
+        }
+
+        count--;
+        update_status();
+
+        // a handed-off lock gets released on a thread with nothing pinned
+        if (expected_status == IND_READING && pinned_depth > 0)
+            if (!--pinned_depth)
+                pinned_snapshot = NULL;
 
-void Go_Indexer::release_lock(Indexer_Status expected_status) {
-    go_print("[release] %s", indexer_status_str(expected_status));
+        if (expected_status == IND_WRITING && !reacquires)
+            metrics.add_writing(current_time_milli() - time_started_writing_milli);
 
-    if (status != expected_status) {
-        auto msg = "Go_Indexer::release_lock() called with status mismatch (want %d, got %d)";
-        msg = cp_sprintf(msg, expected_status, status);
-        cp_panic(msg);
+        if (!readers) {
+            readers_cond.broadcast();
+            wake_up_indexer = (retired_published > 0);
+        }
     }
 
-    if (--reacquires == 0) {
-        status = IND_READY;
-        lock.leave();
-    }
+    // so it can free what got retired while we were reading
+    if (wake_up_indexer)
+        message_queue.wake();
 }
 
 void Go_Indexer::start_writing(bool skip_if_already_started) {
@@ -6574,14 +10674,39 @@ void Go_Indexer::cleanup() {
         bgthread = NULL;
     }
 
+    workers.cleanup();
+    close_index_source();
+    index_atom_map.cleanup();
+    build_cache.cleanup();
+    shared_cache.cleanup();
+    metrics.cleanup();
+
+    For (&retired) it.cleanup();
+    retired.cleanup();
+    if (snapshot) {
+        snapshot->mem.cleanup();
+        cp_free(snapshot);
+        snapshot = NULL;
+    }
+
     mem.cleanup();
     final_mem.cleanup();
     ui_mem.cleanup();
     scoped_table_mem.cleanup();
     package_lookup_mem.cleanup();
+    index_pools_mem.cleanup();
     lock.cleanup();
+    write_lock.cleanup();
+    readers_cond.cleanup();
+    write_lock_cond.cleanup();
+    finished_initial_index_cond.cleanup();
 
     For (index.packages) it.cleanup();
+
+    // after everything that might point at them
+    atoms.cleanup();
+    eval_cache.cleanup();
+    scope_ops_cache.cleanup();
 }
 
 List<Godecl> *Go_Indexer::parameter_list_to_fields(Ast_Node *params) {
@@ -7767,6 +11892,20 @@ List<Goresult> *Go_Indexer::list_package_decls(ccstr import_path, int flags) {
 }
 
 Goresult *Go_Indexer::find_decl_in_package(ccstr id, ccstr import_path) {
+    auto pkg = find_up_to_date_package(import_path);
+    if (!pkg) return NULL;
+
+    if (pkg->decl_table) {
+        ccstr filename = NULL;
+        auto decl = pkg->find_decl(id, &filename);
+        if (!decl) return NULL;
+
+        auto ctx = new_object(Go_Ctx);
+        ctx->import_path = import_path;
+        ctx->filename = filename;
+        return make_goresult(decl, ctx);
+    }
+
     auto results = list_package_decls(import_path, LISTDECLS_EXCLUDE_METHODS);
     if (!results) return NULL;
 
@@ -7994,9 +12133,228 @@ Goresult *Go_Indexer::_evaluate_type(Goresult *res, Godecl** outdecl) {
     return _evaluate_type(res->gotype, res->ctx, outdecl);
 }
 
+// Writes out what identifies a type for Go_Eval_Cache. Returns false for
+// types that aren't worth the trouble (funcs, structs, interfaces...).
+static bool append_gotype_key(Gotype *t, List<char> *out) {
+    auto put = [&](ccstr s) {
+        if (s) out->concat((char*)s, strlen(s));
+        out->append('\x1f');
+    };
+
+    auto putnum = [&](int n) { put(cp_sprintf("%d", n)); };
+    auto putpos = [&](cur2 pos) { put(cp_sprintf("%d,%d", pos.x, pos.y)); };
+
+    auto putlist = [&](List<Gotype*> *list) -> bool {
+        if (!list) {
+            put("-");
+            return true;
+        }
+        putnum(list->len);
+        For (list)
+            if (!append_gotype_key(it, out))
+                return false;
+        return true;
+    };
+
+    if (!t) {
+        put("nil");
+        return true;
+    }
+
+    putnum(t->type);
+
+    switch (t->type) {
+    case GOTYPE_ID:
+        put(t->id_name);
+        putpos(t->id_pos);
+        return true;
+    case GOTYPE_SEL:
+        put(t->sel_name);
+        put(t->sel_sel);
+        return true;
+    case GOTYPE_BUILTIN:
+        putnum(t->builtin_type);
+        return true;
+    case GOTYPE_MAP:
+        return append_gotype_key(t->map_key, out) && append_gotype_key(t->map_value, out);
+    case GOTYPE_SLICE:
+        putnum(t->slice_is_variadic);
+        return append_gotype_key(t->slice_base, out);
+    case GOTYPE_CHAN:
+        putnum(t->chan_direction);
+        return append_gotype_key(t->chan_base, out);
+    case GOTYPE_RANGE:
+        putnum(t->range_type);
+        return append_gotype_key(t->range_base, out);
+    case GOTYPE_POINTER:
+    case GOTYPE_ARRAY:
+    case GOTYPE_ASSERTION:
+    case GOTYPE_RECEIVE:
+    case GOTYPE_LAZY_DEREFERENCE:
+    case GOTYPE_LAZY_REFERENCE:
+    case GOTYPE_LAZY_ARROW:
+        return append_gotype_key(t->base, out);
+    case GOTYPE_GENERIC:
+        return append_gotype_key(t->generic_base, out) && putlist(t->generic_args);
+    case GOTYPE_OVERRIDE_CTX:
+        if (!t->override_ctx_ctx) return false;
+        put(t->override_ctx_ctx->import_path);
+        put(t->override_ctx_ctx->filename);
+        return append_gotype_key(t->override_ctx_base, out);
+    case GOTYPE_LAZY_INSTANCE:
+        return append_gotype_key(t->lazy_instance_base, out) && putlist(t->lazy_instance_args);
+    case GOTYPE_LAZY_ID:
+        put(t->lazy_id_name);
+        putpos(t->lazy_id_pos);
+        return true;
+    case GOTYPE_LAZY_SEL:
+        put(t->lazy_sel_sel);
+        return append_gotype_key(t->lazy_sel_base, out);
+    case GOTYPE_LAZY_INDEX:
+        return append_gotype_key(t->lazy_index_base, out) && append_gotype_key(t->lazy_index_key, out);
+    case GOTYPE_LAZY_CALL:
+        return append_gotype_key(t->lazy_call_base, out) && putlist(t->lazy_call_args);
+    case GOTYPE_LAZY_RANGE:
+        putnum(t->lazy_range_is_index);
+        return append_gotype_key(t->lazy_range_base, out);
+    case GOTYPE_LAZY_ONE_OF_MULTI:
+        putnum(t->lazy_one_of_multi_index);
+        putnum(t->lazy_one_of_multi_is_single);
+        return append_gotype_key(t->lazy_one_of_multi_base, out);
+    }
+    return false;
+}
+
+// @Write
+void Go_Indexer::bump_package_generation(Go_Package *pkg) {
+    pkg->generation = ++last_package_generation;
+}
+
+// Looks gotype up in eval_cache, or computes it and puts it there. Either
+// way, whatever evaluation called this gets the packages it depends on.
+Goresult *Go_Indexer::cached_eval(char kind, Gotype *gotype, Go_Ctx *ctx, fn<Goresult*()> compute) {
+    if (!ctx) return compute();
+
+    ccstr key = NULL;
+    {
+        List<char> buf; buf.init(LIST_MALLOC, 128);
+        defer { buf.cleanup(); };
+
+        buf.append(kind);
+        buf.append(dont_resolve_builtin ? '1' : '0');
+        buf.concat((char*)ctx->import_path, strlen(ctx->import_path));
+        buf.append('\x1f');
+        buf.concat((char*)ctx->filename, strlen(ctx->filename));
+        buf.append('\x1f');
+
+        // the key has to outlive frames the caller might be in
+        Frame frame;
+        bool ok = append_gotype_key(gotype, &buf);
+        frame.restore();
+
+        if (!ok) return compute();
+
+        buf.append('\0');
+        key = cp_strdup(buf.items);
+    }
+
+    auto parent = eval_deps;
+
+    // Entries don't change once they're in the table and only get freed
+    // when there are no readers, so the lock is just for the lookup. The
+    // deps get checked without it, so readers don't line up behind each
+    // other on every hit.
+    Go_Eval_Cache::Entry *entry = NULL;
+    {
+        SCOPED_LOCK(&eval_cache.lock);
+        entry = eval_cache.table.get(key);
+    }
+
+    if (entry) {
+        bool ok = true;
+        {
+            // looking up deps shouldn't count as one
+            eval_deps = NULL;
+            defer { eval_deps = parent; };
+
+            For (entry->deps) {
+                auto pkg = find_package_in_index(it.import_path);
+                if ((pkg ? pkg->generation : 0) != it.generation) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+
+        if (ok) {
+            {
+                SCOPED_LOCK(&eval_cache.lock);
+                eval_cache.hits++;
+            }
+
+            if (parent)
+                For (entry->deps)
+                    add_eval_dep(parent, it.import_path, it.generation);
+            // copy out, the cache can be cleared once this request is done
+            return entry->result ? entry->result->copy_gotype() : NULL;
+        }
+    }
+
+    {
+        SCOPED_LOCK(&eval_cache.lock);
+
+        if (entry) {
+            // someone else might have put a fresh one in already
+            if (eval_cache.table.get(key) == entry)
+                eval_cache.table.remove(key);
+            eval_cache.stale++;
+        }
+        eval_cache.misses++;
+    }
+
+    List<Go_Eval_Dep> deps;
+    deps.init(LIST_MALLOC, 16);
+    defer { deps.cleanup(); };
+
+    eval_deps = &deps;
+    auto ret = compute();
+    eval_deps = parent;
+
+    if (parent)
+        For (&deps)
+            add_eval_dep(parent, it.import_path, it.generation);
+
+    SCOPED_LOCK(&eval_cache.lock);
+
+    if (eval_cache.full) return ret;
+    if (eval_cache.mem.mem_allocated > EVAL_CACHE_MAX_BYTES) {
+        eval_cache.full = true;
+        return ret;
+    }
+
+    SCOPED_MEM(&eval_cache.mem);
+
+    entry = new_object(Go_Eval_Cache::Entry);
+    entry->result = ret ? ret->copy_gotype() : NULL;
+    entry->deps = new_list(Go_Eval_Dep, max(deps.len, 1));
+    entry->deps->concat(&deps);
+    eval_cache.table.set(cp_strdup(key), entry);
+    return ret;
+}
+
 Goresult *Go_Indexer::_evaluate_type(Gotype *gotype, Go_Ctx *ctx, Godecl** outdecl) {
     if (!gotype) return NULL;
 
+    // callers that want the decl don't get the cache
+    if (outdecl || gotype->type < _GOTYPE_LAZY_MARKER_)
+        return actually_evaluate_type(gotype, ctx, outdecl);
+
+    return cached_eval('e', gotype, ctx, [&]() { return actually_evaluate_type(gotype, ctx); });
+}
+
+Goresult *Go_Indexer::actually_evaluate_type(Gotype *gotype, Go_Ctx *ctx, Godecl** outdecl) {
+    if (!gotype) return NULL;
+
     enum {
         U_EVAL = 1 << 0,
         U_RESOLVE = 1 << 1,
@@ -9349,8 +13707,22 @@ Goresult *Go_Indexer::resolve_type(Goresult *res) {
 }
 
 Goresult *Go_Indexer::resolve_type(Gotype *type, Go_Ctx *ctx) {
-    String_Set seen; seen.init();
-    return resolve_type(type, ctx, &seen);
+    auto compute = [&]() -> Goresult* {
+        String_Set seen; seen.init();
+        return resolve_type(type, ctx, &seen);
+    };
+
+    if (!type) return NULL;
+
+    switch (type->type) {
+    case GOTYPE_ID:
+    case GOTYPE_SEL:
+    case GOTYPE_POINTER:
+    case GOTYPE_ASSERTION:
+    case GOTYPE_RECEIVE:
+        return cached_eval('r', type, ctx, compute);
+    }
+    return compute();
 }
 
 Goresult *Go_Indexer::resolve_type(Gotype *type, Go_Ctx *ctx, String_Set *seen) {
@@ -9657,6 +14029,7 @@ void Gotype::read(Index_Stream *s) {
         break;
     case GOTYPE_ID:
         READ_STR(id_name);
+        id_pos = s->readpos();
         break;
     case GOTYPE_SEL:
         READ_STR(sel_name);
@@ -9682,12 +14055,14 @@ void Gotype::read(Index_Stream *s) {
         break;
     case GOTYPE_SLICE:
         READ_OBJ(slice_base);
+        slice_is_variadic = s->read1();
         break;
     case GOTYPE_ARRAY:
         READ_OBJ(array_base);
         break;
     case GOTYPE_CHAN:
         READ_OBJ(chan_base);
+        chan_direction = (Chan_Direction)s->read1();
         break;
     case GOTYPE_MULTI: {
         // can't use READ_LIST here because multi_types contains pointers
@@ -9708,9 +14083,11 @@ void Gotype::read(Index_Stream *s) {
         break;
     case GOTYPE_RANGE:
         READ_OBJ(range_base);
+        range_type = (Range_Type)s->read1();
         break;
     case GOTYPE_BUILTIN:
         READ_OBJ(builtin_underlying_base);
+        builtin_type = (Gotype_Builtin_Type)s->read1();
         break;
     case GOTYPE_LAZY_INDEX:
         READ_OBJ(lazy_index_base);
@@ -9731,6 +14108,7 @@ void Gotype::read(Index_Stream *s) {
         break;
     case GOTYPE_LAZY_ID:
         READ_STR(lazy_id_name);
+        lazy_id_pos = s->readpos();
         break;
     case GOTYPE_LAZY_SEL:
         READ_OBJ(lazy_sel_base);
@@ -9738,9 +14116,12 @@ void Gotype::read(Index_Stream *s) {
         break;
     case GOTYPE_LAZY_ONE_OF_MULTI:
         READ_OBJ(lazy_one_of_multi_base);
+        lazy_one_of_multi_index = s->read1();
+        lazy_one_of_multi_is_single = s->read1();
         break;
     case GOTYPE_LAZY_RANGE:
         READ_OBJ(lazy_range_base);
+        lazy_range_is_index = s->read1();
         break;
     case GOTYPE_OVERRIDE_CTX:
         cp_panic("invalid type GOTYPE_OVERRIDE_CTX");
@@ -9754,12 +14135,20 @@ void Go_Scope_Op::read(Index_Stream *s) {
 }
 
 void Go_File::read(Index_Stream *s) {
+    Gotype_Handles handles;
+    handles.init();
+    defer { handles.cleanup(); };
+
+    s->gotype_handles = &handles;
+    defer { s->gotype_handles = NULL; };
+
     auto read = [&]() {
         READ_STR(filename);
         READ_LIST(scope_ops);
         READ_LIST(decls);
         READ_LIST(imports);
         READ_LIST(references);
+        READ_LIST(reference_postings);
     };
 
     if (use_pool) {
@@ -9773,11 +14162,57 @@ void Go_File::read(Index_Stream *s) {
     }
 }
 
+void Go_Reference_Posting::read(Index_Stream *s) {
+    READ_STR(name);
+}
+
+void Go_Reference_Name::read(Index_Stream *s) {
+    READ_STR(name);
+}
+
+void Go_Method_Set::read(Index_Stream *s) {
+    READ_STR(type_name);
+}
+
+void Go_Method_Posting::read(Index_Stream *s) {}
+
+void Go_Decl_Slot::read(Index_Stream *s) {
+    READ_STR(name);
+}
+
+void Go_Symbol_Entry::read(Index_Stream *s) {
+    READ_STR(name);
+    READ_STR(filename);
+    import_path = NULL;
+    package_name = NULL;
+    package_path = NULL;
+}
+
+void Go_Call_Edge::read(Index_Stream *s) {
+    READ_STR(filename);
+    READ_STR(callee_import_path);
+    READ_STR(callee_recv);
+    READ_STR(callee_name);
+}
+
+// files are read separately, see Index_Stream::read_index()
 void Go_Package::read(Index_Stream *s) {
+    last_used_milli = NULL;
+    reference_names_pool = NULL;
+    method_sets_pool = NULL;
+    call_edges_pool = NULL;
+    symbols_pool = NULL;
+    decl_table_pool = NULL;
+
     auto read = [&]() {
         READ_STR(import_path);
         READ_STR(package_name);
-        READ_LIST(files);
+        READ_LIST(reference_names);
+        READ_LIST(method_sets);
+        READ_LIST(method_postings);
+        READ_LIST(call_edges);
+        READ_LIST(symbols);
+        READ_LIST(decl_table);
     };
 
     if (use_pool) {
@@ -9873,6 +14308,7 @@ void Gotype::write(Index_Stream *s) {
         break;
     case GOTYPE_ID:
         WRITE_STR(id_name);
+        s->writepos(id_pos);
         break;
     case GOTYPE_SEL:
         WRITE_STR(sel_name);
@@ -9898,12 +14334,14 @@ void Gotype::write(Index_Stream *s) {
         break;
     case GOTYPE_SLICE:
         WRITE_OBJ(slice_base);
+        s->write1(slice_is_variadic);
         break;
     case GOTYPE_ARRAY:
         WRITE_OBJ(array_base);
         break;
     case GOTYPE_CHAN:
         WRITE_OBJ(chan_base);
+        s->write1(chan_direction);
         break;
     case GOTYPE_MULTI:
         WRITE_LISTP(multi_types);
@@ -9916,9 +14354,11 @@ void Gotype::write(Index_Stream *s) {
         break;
     case GOTYPE_RANGE:
         WRITE_OBJ(range_base);
+        s->write1(range_type);
         break;
     case GOTYPE_BUILTIN:
         WRITE_OBJ(builtin_underlying_base);
+        s->write1(builtin_type);
         break;
     case GOTYPE_LAZY_INDEX:
         WRITE_OBJ(lazy_index_base);
@@ -9939,6 +14379,7 @@ void Gotype::write(Index_Stream *s) {
         break;
     case GOTYPE_LAZY_ID:
         WRITE_STR(lazy_id_name);
+        s->writepos(lazy_id_pos);
         break;
     case GOTYPE_LAZY_SEL:
         WRITE_OBJ(lazy_sel_base);
@@ -9946,9 +14387,12 @@ void Gotype::write(Index_Stream *s) {
         break;
     case GOTYPE_LAZY_ONE_OF_MULTI:
         WRITE_OBJ(lazy_one_of_multi_base);
+        s->write1(lazy_one_of_multi_index);
+        s->write1(lazy_one_of_multi_is_single);
         break;
     case GOTYPE_LAZY_RANGE:
         WRITE_OBJ(lazy_range_base);
+        s->write1(lazy_range_is_index);
         break;
     case GOTYPE_OVERRIDE_CTX:
         cp_panic("invalid type GOTYPE_OVERRIDE_CTX");
@@ -9956,23 +14400,270 @@ void Gotype::write(Index_Stream *s) {
     }
 }
 
+// Calls child() on each gotype t points to and put() on everything else
+// that makes it t. Returns false if t can't be shared with another gotype
+// that looks the same, because it has decls of its own.
+template<typename Child, typename Put>
+static bool walk_gotype_key(Gotype *t, Child child, Put put) {
+    auto putnum = [&](i64 n) { put(&n, sizeof(n)); };
+    auto putpos = [&](cur2 pos) { putnum(pos.x); putnum(pos.y); };
+
+    auto putstr = [&](ccstr str) {
+        if (!str) {
+            putnum(-1);
+            return;
+        }
+        auto len = strlen(str);
+        putnum(len);
+        put((void*)str, len);
+    };
+
+    auto putlist = [&](List<Gotype*> *list) {
+        if (!list) {
+            putnum(-1);
+            return;
+        }
+        putnum(list->len);
+        For (list) child(it);
+    };
+
+    putnum(t->type);
+
+    switch (t->type) {
+    case GOTYPE_GENERIC:
+        child(t->generic_base);
+        putlist(t->generic_args);
+        return true;
+    case GOTYPE_LAZY_INSTANCE:
+        child(t->lazy_instance_base);
+        putlist(t->lazy_instance_args);
+        return true;
+    case GOTYPE_CONSTRAINT:
+        putlist(t->constraint_terms);
+        return true;
+    case GOTYPE_MULTI:
+        putlist(t->multi_types);
+        return true;
+    case GOTYPE_ID:
+        putstr(t->id_name);
+        putpos(t->id_pos);
+        return true;
+    case GOTYPE_SEL:
+        putstr(t->sel_name);
+        putstr(t->sel_sel);
+        return true;
+    case GOTYPE_MAP:
+        child(t->map_key);
+        child(t->map_value);
+        return true;
+    case GOTYPE_SLICE:
+        putnum(t->slice_is_variadic);
+        child(t->slice_base);
+        return true;
+    case GOTYPE_CHAN:
+        putnum(t->chan_direction);
+        child(t->chan_base);
+        return true;
+    case GOTYPE_RANGE:
+        putnum(t->range_type);
+        child(t->range_base);
+        return true;
+    case GOTYPE_BUILTIN:
+        putnum(t->builtin_type);
+        child(t->builtin_underlying_base);
+        return true;
+    case GOTYPE_CONSTRAINT_UNDERLYING:
+    case GOTYPE_POINTER:
+    case GOTYPE_ARRAY:
+    case GOTYPE_ASSERTION:
+    case GOTYPE_RECEIVE:
+    case GOTYPE_LAZY_DEREFERENCE:
+    case GOTYPE_LAZY_REFERENCE:
+    case GOTYPE_LAZY_ARROW:
+        child(t->base);
+        return true;
+    case GOTYPE_LAZY_INDEX:
+        child(t->lazy_index_base);
+        child(t->lazy_index_key);
+        return true;
+    case GOTYPE_LAZY_CALL:
+        child(t->lazy_call_base);
+        putlist(t->lazy_call_args);
+        return true;
+    case GOTYPE_LAZY_ID:
+        putstr(t->lazy_id_name);
+        putpos(t->lazy_id_pos);
+        return true;
+    case GOTYPE_LAZY_SEL:
+        child(t->lazy_sel_base);
+        putstr(t->lazy_sel_sel);
+        return true;
+    case GOTYPE_LAZY_ONE_OF_MULTI:
+        putnum(t->lazy_one_of_multi_index);
+        putnum(t->lazy_one_of_multi_is_single);
+        child(t->lazy_one_of_multi_base);
+        return true;
+    case GOTYPE_LAZY_RANGE:
+        putnum(t->lazy_range_is_index);
+        child(t->lazy_range_base);
+        return true;
+    }
+    return false;
+}
+
+// Makes sure t has a handle, writing it (and any gotypes under it that
+// don't have one yet) if it doesn't.
+static u32 define_gotype(Gotype *t, Index_Stream *s) {
+    if (!t) return 0;
+
+    auto h = s->gotype_handles;
+    auto ptr_hash = hash64(&t, sizeof(t));
+
+    auto existing = h->by_ptr.find(ptr_hash);
+    if (existing->handle) return existing->handle;
+
+    auto noop = [&](void*, s32) {};
+    bool shareable = walk_gotype_key(t, [&](Gotype *it) { define_gotype(it, s); }, noop);
+
+    u64 key_hash = 0;
+    u32 key_start = 0;
+
+    if (shareable) {
+        // everything under t has a handle now, so the key is just t itself
+        h->key.len = 0;
+        walk_gotype_key(
+            t,
+            [&](Gotype *it) {
+                u32 handle = it ? h->by_ptr.find(hash64(&it, sizeof(it)))->handle : 0;
+                h->key.concat((char*)&handle, sizeof(handle));
+            },
+            [&](void *data, s32 len) {
+                h->key.concat((char*)data, len);
+            }
+        );
+
+        key_hash = hash64(h->key.items, h->key.len);
+
+        auto slot = h->by_key.find(key_hash, &h->keys, h->key.items, h->key.len);
+        if (slot->handle) {
+            auto handle = slot->handle;
+            h->by_ptr.insert(ptr_hash)->handle = handle;
+            return handle;
+        }
+
+        key_start = h->keys.len;
+        h->keys.concat(h->key.items, h->key.len);
+    }
+
+    s->write4((i32)GOTYPE_HANDLE_DEF);
+    s->write1(t->type);
+    t->write(s);
+
+    // after the body, since it can define gotypes of its own (fields of a
+    // struct, say), the same as when reading
+    auto handle = ++h->count;
+    h->by_ptr.insert(ptr_hash)->handle = handle;
+
+    if (shareable) {
+        auto slot = h->by_key.insert(key_hash);
+        slot->handle = handle;
+        slot->key_start = key_start;
+        slot->key_len = h->keys.len - key_start;
+    }
+    return handle;
+}
+
+template<> void write_object<Gotype>(Gotype *obj, Index_Stream *s) {
+    cp_assert(s->gotype_handles);
+    s->write4(define_gotype(obj, s));
+}
+
+template<> Gotype *read_object<Gotype>(Index_Stream *s) {
+    auto h = s->gotype_handles;
+    cp_assert(h);
+
+    while (true) {
+        auto handle = (u32)s->read4();
+        if (!s->ok || !handle) return NULL;
+
+        if (handle != GOTYPE_HANDLE_DEF) {
+            if (handle > h->gotypes.len) {
+                // make the rest of the read fail too
+                s->offset = s->fm->len;
+                s->ok = false;
+                return NULL;
+            }
+            return h->gotypes[handle - 1];
+        }
+
+        auto t = new_object(Gotype);
+        t->type = (Gotype_Type)s->read1();
+        t->read(s);
+        h->gotypes.append(t);
+    }
+}
+
 void Go_Scope_Op::write(Index_Stream *s) {
     if (type == GSOP_DECL)
         WRITE_OBJ(decl);
 }
 
 void Go_File::write(Index_Stream *s) {
+    Gotype_Handles handles;
+    handles.init();
+    defer { handles.cleanup(); };
+
+    s->gotype_handles = &handles;
+    defer { s->gotype_handles = NULL; };
+
     WRITE_STR(filename);
     WRITE_LIST(scope_ops);
     WRITE_LIST(decls);
     WRITE_LIST(imports);
     WRITE_LIST(references);
+    WRITE_LIST(reference_postings);
+}
+
+void Go_Reference_Posting::write(Index_Stream *s) {
+    WRITE_STR(name);
+}
+
+void Go_Reference_Name::write(Index_Stream *s) {
+    WRITE_STR(name);
+}
+
+void Go_Method_Set::write(Index_Stream *s) {
+    WRITE_STR(type_name);
+}
+
+void Go_Method_Posting::write(Index_Stream *s) {}
+
+void Go_Decl_Slot::write(Index_Stream *s) {
+    WRITE_STR(name);
+}
+
+void Go_Symbol_Entry::write(Index_Stream *s) {
+    WRITE_STR(name);
+    WRITE_STR(filename);
+}
+
+void Go_Call_Edge::write(Index_Stream *s) {
+    WRITE_STR(filename);
+    WRITE_STR(callee_import_path);
+    WRITE_STR(callee_recv);
+    WRITE_STR(callee_name);
 }
 
+// files are written separately, see Index_Stream::write_index()
 void Go_Package::write(Index_Stream *s) {
     WRITE_STR(import_path);
     WRITE_STR(package_name);
-    WRITE_LIST(files);
+    WRITE_LIST(reference_names);
+    WRITE_LIST(method_sets);
+    WRITE_LIST(method_postings);
+    WRITE_LIST(call_edges);
+    WRITE_LIST(symbols);
+    WRITE_LIST(decl_table);
 }
 
 void Go_Index::write(Index_Stream *s) {
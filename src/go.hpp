@@ -19,6 +19,7 @@ enum Parse_Lang {
     LANG_GO,
     LANG_GOMOD,
     LANG_GOWORK,
+    _LANG_COUNT_,
 };
 
 #define GO_INDEX_MAGIC_NUMBER 0x49fa98
@@ -54,7 +55,31 @@ enum Parse_Lang {
 // version 45: make enums u8
 // version 46: fix package names
 // version 47: bump index version
-#define GO_INDEX_VERSION 47
+// version 48: package directory at end of file, files read lazily
+// version 49: add Go_Package::fingerprint
+// version 50: add Go_Package::lazy_files
+// version 51: strings stored as atom ids
+// version 52: add reference postings
+// version 53: add method sets
+// version 54: add call edges
+// version 55: add symbols
+// version 56: add decl table
+// version 57: add Go_Package::in_workspace and in_goroot, names in decl table
+// version 58: gotypes stored once per file and referred to by handle
+// version 59: dependency files don't store scope ops
+// version 60: add Go_Package::last_used_milli
+#define GO_INDEX_VERSION 60
+
+// magic number, version, offset of trailer
+#define GO_INDEX_HEADER_SIZE 16
+
+#define BUILD_CACHE_VERSION 1
+
+// how long the indexer holds on to changes before publishing a snapshot
+#define INDEX_SNAPSHOT_INTERVAL_MILLI 100
+
+// how long each loop of the indexer can spend resolving call edges
+#define CALL_EDGES_BUDGET_MILLI 50
 
 enum {
     CUSTOM_HASH_BUILTINS = 1,
@@ -63,6 +88,117 @@ enum {
 
 struct Go_Index;
 
+// Index of an interned string, 0 is NULL.
+typedef u32 Go_Atom;
+
+#define GO_ATOM_SHARDS 16
+#define GO_ATOM_PAGE_SIZE 4096
+#define GO_ATOM_MAX_PAGES 16384
+
+// Names, import paths and other strings that go in the index are interned
+// here, so each one is only stored once and two interned strings are equal
+// iff they're the same pointer. Nothing is ever freed, so atoms outlive any
+// snapshot or package that points at them.
+//
+// Lookups are split across shards so workers interning at the same time
+// mostly don't wait on each other. str() doesn't lock; an atom's slot is
+// filled in before the atom is handed out.
+struct Go_Atom_Table {
+    struct Shard {
+        Lock lock;
+        Pool mem;
+        Table<Go_Atom> lookup;
+    };
+
+    Shard shards[GO_ATOM_SHARDS];
+
+    Lock pages_lock;
+    ccstr *pages[GO_ATOM_MAX_PAGES];
+    u32 count; // next atom
+
+    void init();
+    void cleanup();
+    Go_Atom atom(ccstr s);
+    ccstr str(Go_Atom atom);
+    ccstr intern(ccstr s) { return s ? str(atom(s)) : NULL; }
+};
+
+// Strings in a .cpdb are stored as the file's own atom ids, which are given
+// out as strings are first written to it. The strings themselves are in
+// chunks that get appended along with everything else, each pointing at the
+// one before it, so appending never renumbers what's already in the file.
+struct Go_Atom_Map {
+    List<Go_Atom> to_atom; // file id -> atom
+    List<u32> to_file;     // atom -> file id, 0 if it's not in the file
+    i64 last_chunk;        // offset of newest chunk
+    i64 chunk_bytes;       // size of all the chunks
+    u32 written;           // file ids below this are in a chunk already
+
+    void init();
+    void cleanup();
+    void copy_from(Go_Atom_Map *other);
+    u32 file_id(Go_Atom atom);
+};
+
+// Interns s in core.indexer.atoms.
+ccstr go_intern(ccstr s);
+
+// Set while copying parsed data into the index. The Godecl, Gotype,
+// Go_Reference, Go_Import and Go_Package copy()s intern their strings then,
+// and otherwise copy them into MEM, so copies made for the UI and for
+// queries don't grow the atom table.
+extern thread_local bool copy_into_index;
+
+// go_intern() or cp_strdup(), see copy_into_index.
+ccstr copy_go_string(ccstr s);
+
+struct Gotype;
+
+// Each file in a .cpdb stores a gotype once and refers to it by a 32-bit
+// handle after that, see read_object<Gotype>(). Writing dedups gotypes that
+// are the same all the way down, so lots of them (every *http.Request or
+// []string, say) end up shared once they're read back in. Handles start
+// over for every file, since each one can be in its own pool, and so a
+// package's files can be copied from one .cpdb to another as is.
+struct Gotype_Handles {
+    // open addressing, cap is a power of two
+    struct Slot {
+        u64 hash; // by_ptr uses the pointer itself
+        u32 handle; // 0 means empty
+        u32 key_start;
+        u32 key_len;
+    };
+
+    struct Map {
+        Slot *slots;
+        u32 cap;
+        u32 len;
+
+        void init();
+        void cleanup();
+        // returns the slot with the key, or the empty slot it would go in
+        Slot *find(u64 hash, List<char> *keys = NULL, char *key = NULL, u32 key_len = 0);
+        Slot *insert(u64 hash);
+    };
+
+    // reading: handle - 1 -> gotype
+    List<Gotype*> gotypes;
+
+    // writing
+    u32 count;
+    Map by_ptr;
+    Map by_key;
+    List<char> keys; // every key in by_key, back to back
+    List<char> key;
+
+    void init();
+    void cleanup();
+};
+
+// comes where a handle would, followed by a gotype the handles after it
+// can refer to
+#define GOTYPE_HANDLE_DEF 0xffffffff
+
 struct Index_Stream {
     // File f;
     i64 offset;
@@ -70,26 +206,48 @@ struct Index_Stream {
     bool ok;
     File_Mapping *fm;
 
-    bool open(ccstr _path, bool write = false);
+    // strings are read and written as ids through this if it's set
+    Go_Atom_Map *atom_map;
+
+    // set while a Go_File is read or written
+    Gotype_Handles *gotype_handles;
+
+    // bytes of the file still pointed to by the directory, and bytes the
+    // last write_index() actually wrote
+    i64 live_bytes;
+    i64 bytes_written;
+
+    bool open(ccstr _path, bool write = false, bool append = false);
     void cleanup();
 
     bool writen(void* buf, int n);
     bool write1(i8 x);
     bool write2(i16 x);
     bool write4(i32 x);
+    bool write8(i64 x);
     bool writestr(ccstr s);
+    bool writepos(cur2 pos);
     void finish_writing();
 
     void readn(void* buf, s32 n);
     char read1();
     i16 read2();
     i32 read4();
+    i64 read8();
     ccstr readstr();
+    cur2 readpos();
+
+    bool read_atoms(i64 last_chunk, i64 limit);
+    bool write_atoms();
 
     Go_Index *read_index();
-    void write_index(Go_Index *index);
+    bool write_index(Go_Index *index, Index_Stream *lazy_source, i64 *offsets, i64 *lens);
 };
 
+// Whether a .cpdb that's file_len long with live_bytes of it still in use
+// (see Index_Stream::live_bytes) should be rewritten instead of appended to.
+bool index_file_needs_compaction(i64 file_len, i64 live_bytes);
+
 enum It_Type {
     IT_INVALID = 0,
     IT_MMAP,
@@ -805,15 +963,126 @@ struct Go_Reference {
     cur2 true_start() { return is_sel ? x_start : start; }
 };
 
+// A reference in Go_File::references, by the name it refers to (the sel for
+// x.sel). A file's postings are sorted by name, then index, so find
+// references can go straight to the references it cares about.
+struct Go_Reference_Posting {
+    ccstr name;
+    int index;
+
+    Go_Reference_Posting *copy();
+    void read(Index_Stream *s);
+    void write(Index_Stream *s);
+};
+
+// A name that something in a package refers to, see
+// Go_Package::reference_names.
+struct Go_Reference_Name {
+    ccstr name;
+
+    Go_Reference_Name *copy();
+    void read(Index_Stream *s);
+    void write(Index_Stream *s);
+};
+
+// A named type in a package and what methods it has, see
+// Go_Package::method_sets. A method is just a hash of its name and arity,
+// which is as much of the signature as can be compared without resolving
+// types, so anything found through these still has to be checked.
+struct Go_Method_Set {
+    ccstr type_name;
+    bool is_interface;
+    bool has_embeds; // interface embeds something, so methods is incomplete
+    int methods;     // how many postings are for this set
+
+    Go_Method_Set *copy();
+    void read(Index_Stream *s);
+    void write(Index_Stream *s);
+};
+
+struct Go_Method_Posting {
+    u64 hash;
+    int set; // index into Go_Package::method_sets
+
+    Go_Method_Posting *copy();
+    void read(Index_Stream *s);
+    void write(Index_Stream *s);
+};
+
+// A reference from one of a package's toplevel decls to a func or method,
+// see Go_Package::call_edges. The callee is by name rather than position,
+// so it stays put when the callee's file is edited.
+struct Go_Call_Edge {
+    ccstr filename;  // of the caller
+    int caller;      // index into the file's decls
+    int reference;   // index into the file's references
+    ccstr callee_import_path;
+    ccstr callee_recv; // NULL if it's not a method
+    ccstr callee_name;
+
+    Go_Call_Edge *copy();
+    void read(Index_Stream *s);
+    void write(Index_Stream *s);
+};
+
+// A toplevel decl in a workspace package, see Go_Package::symbols. The
+// strings are interned, so a copy of one doesn't need the package around.
+struct Go_Symbol_Entry {
+    ccstr name; // Recv.Method if it's a method
+    ccstr filename;
+    cur2 name_start;
+    Godecl_Type decl_type;
+    u64 mask; // see symbol_char_mask()
+
+    // filled in by Go_Indexer::fill_goto_symbol()
+    ccstr import_path;
+    ccstr package_name;
+    ccstr package_path;
+
+    ccstr full_name() { return cp_sprintf("%s.%s", package_name, name); }
+
+    Go_Symbol_Entry *copy();
+    void read(Index_Stream *s);
+    void write(Index_Stream *s);
+};
+
+// A slot in Go_Package::decl_table, an open-addressed hash table of the
+// package's toplevel decls (not methods) by name. file and decl index into
+// Go_Package::files and Go_File::decls; file is -1 if the slot is empty.
+// name is there so Go_Package::has_decl() doesn't need the files.
+struct Go_Decl_Slot {
+    ccstr name;
+    u64 hash;
+    s32 file;
+    s32 decl;
+
+    Go_Decl_Slot *copy();
+    void read(Index_Stream *s);
+    void write(Index_Stream *s);
+};
+
+// Go To Symbol checks this before doing a real fuzzy match: every character
+// in the query has to be in the symbol. One bit per letter (ignoring case),
+// digit, '_' and '.', plus one for everything else.
+u64 symbol_char_mask(ccstr s);
+
+// how many symbols Go To Symbol ORs together into each block mask
+#define GOTO_SYMBOL_BLOCK_SIZE 64
+
+// One mask per GOTO_SYMBOL_BLOCK_SIZE symbols, so Go To Symbol can skip a
+// whole block when the query has a character none of them do.
+List<u64> *symbol_block_masks(List<Go_Symbol_Entry> *symbols);
+
 struct Go_File {
     Pool *pool;
     bool use_pool;
 
     ccstr filename;
-    List<Go_Scope_Op> *scope_ops;
+    List<Go_Scope_Op> *scope_ops; // NULL for dependencies, see Scope_Ops_Cache
     List<Godecl> *decls;
     List<Go_Import> *imports;
     List<Go_Reference> *references;
+    List<Go_Reference_Posting> *reference_postings;
     u64 hash;
 
     void cleanup() {
@@ -828,6 +1097,35 @@ struct Go_File {
     void write(Index_Stream *s);
 };
 
+// A Go_Package::decl_table for files, allocated in the current pool.
+List<Go_Decl_Slot> *new_decl_table(List<Go_File> *files);
+
+// A package's files in the .cpdb, read in the first time somebody needs
+// them (see Go_Indexer::load_package_files()). Every copy of the package
+// points at the same one, so they only get read in once no matter which
+// snapshot asks.
+struct Go_Package_Lazy_Files {
+    i64 offset;
+    i64 len;
+    u32 generation;       // of Go_Indexer::index_source that offset is in
+    Pool *pool;           // what the files got read into
+    List<Go_File> *files; // NULL until read in
+
+    // whether file came from here, and gets freed along with it
+    bool owns(Go_File *file) {
+        return pool && file->use_pool && pool->owns_address(file->pool);
+    }
+
+    void cleanup() {
+        if (files) For (files) it.cleanup();
+        if (pool) pool->cleanup();
+    }
+};
+
+// Malloced, since a package goes through any number of these as it's
+// evicted and reloaded. Freed by retire_package().
+Go_Package_Lazy_Files *new_lazy_files();
+
 struct Go_Package {
     Pool *pool;
     bool use_pool;
@@ -837,17 +1135,98 @@ struct Go_Package {
     ccstr package_name;
     List<Go_File> *files;
     u64 hash;
+    u64 fingerprint; // see Go_Indexer::fingerprint_package()
+    u32 generation;  // see Go_Indexer::last_package_generation
     bool checked_for_outdated_hash;
 
+    // Set when the package is published, for find_best_import() and import
+    // autocomplete. A workspace change resets the index, so these don't go
+    // stale.
+    bool in_workspace;
+    bool in_goroot;
+
+    // Where files are in the .cpdb, or 0 if they've changed since the index
+    // was last written.
+    i64 disk_offset;
+    i64 disk_len;
+
+    // Set if the package was read from the .cpdb. If files is NULL they
+    // haven't been read in yet, see Go_Indexer::load_package_files().
+    Go_Package_Lazy_Files *lazy_files;
+
+    // When a query last needed the files, for evict_cold_packages(). Every
+    // copy of the package points at the same one, so readers can update it
+    // through whatever snapshot they have. NULL until the background thread
+    // gets around to it.
+    u64 *last_used_milli;
+
+    // Every name the files' references refer to, sorted. It's in the
+    // directory, so find references can skip a package without reading its
+    // files in. Editing a file only ever adds names, so until the package
+    // is processed again this can have a few that aren't used anymore.
+    List<Go_Reference_Name> *reference_names;
+    Pool *reference_names_pool; // if reference_names doesn't live in pool
+
+    // The package's named types, sorted by name, and every method they
+    // have, sorted by hash and then set, so find implementations and find
+    // interfaces only have to read in packages that could have a match.
+    // Like reference_names, editing a file only ever adds to these.
+    List<Go_Method_Set> *method_sets;
+    List<Go_Method_Posting> *method_postings;
+    Pool *method_sets_pool; // if method_sets doesn't live in pool
+
+    // What each toplevel decl in a workspace package refers to, sorted by
+    // filename, then caller and reference. Resolving these takes the whole
+    // index, so it's NULL until the indexer gets to it when it's idle. After
+    // that, a file that changes just gets its own edges redone, see
+    // update_call_edges().
+    List<Go_Call_Edge> *call_edges;
+    Pool *call_edges_pool; // if call_edges doesn't live in pool
+
+    // Toplevel decls, for Go To Symbol, so it doesn't have to read in and
+    // walk every file. Only workspace packages have them; rebuilt whenever
+    // a file changes.
+    List<Go_Symbol_Entry> *symbols;
+    Pool *symbols_pool;
+
+    // So find_decl_in_package() doesn't have to go through every decl. Its
+    // length is a power of two. Indexes into files, so it's NULL whenever
+    // files changes until the package is rebuilt, see find_decl().
+    List<Go_Decl_Slot> *decl_table;
+    Pool *decl_table_pool;
+
+    bool needs_loading() { return !files && lazy_files; }
+
+    List<Go_File> *loaded_files() {
+        if (files) return files;
+        return lazy_files ? lazy_files->files : NULL;
+    }
+
     void cleanup() {
         if (use_pool) {
             cp_assert(pool);
             pool->cleanup();
-        } else {
-            For (files) it.cleanup();
+        } else if (files) {
+            For (files)
+                if (!lazy_files || !lazy_files->owns(&it))
+                    it.cleanup();
         }
+
+        if (lazy_files) lazy_files->cleanup();
+        if (reference_names_pool) reference_names_pool->cleanup();
+        if (method_sets_pool) method_sets_pool->cleanup();
+        if (call_edges_pool) call_edges_pool->cleanup();
+        if (symbols_pool) symbols_pool->cleanup();
+        if (decl_table_pool) decl_table_pool->cleanup();
     }
 
+    bool has_reference_to(ccstr name);
+    int find_method_set(ccstr type_name);
+    bool has_method(int set, u64 hash);
+    Godecl *find_decl(ccstr name, ccstr *filename);
+    bool has_decl(ccstr name);
+    u64 mem_allocated();
+
     Go_Package *copy();
     void read(Index_Stream *s);
     void write(Index_Stream *s);
@@ -931,6 +1310,9 @@ struct Jump_To_Definition_Result {
 
 typedef fn<Godecl*()> New_Godecl_Func;
 
+// how many results Module_Resolver caches before starting over
+#define RESOLVER_CACHE_MAX 16384
+
 // Go_Workspace is essentially a collection of modules and their dependency trees,
 // and various data structures and methods to edit/query it. It can be copied
 // around so that various subsystems can answer question about import paths and
@@ -938,12 +1320,26 @@ typedef fn<Godecl*()> New_Godecl_Func;
 // filesystem) database of workspace info.
 struct Module_Resolver {
     struct Trie_Node {
-        ccstr name;
-        Trie_Node *children;
-        Trie_Node *next;
-        ccstr value; // only leaves have values
+        ccstr name;          // lowercased, paths are matched case-insensitively
+        Trie_Node *children; // hash table, by name
+        ccstr value;         // only leaves have values
+        UT_hash_handle hh;
+    };
 
-        // Trie_Node *copy();
+    // What resolve_import() and resolved_path_to_import_path() came up
+    // with, misses included. Readers call those all the time, so this has
+    // its own lock. A change to go.mod or go.work gets the whole resolver
+    // rebuilt, cache and all.
+    struct Cache {
+        Lock lock;
+        Pool mem;
+        Table<ccstr> import_to_resolved;
+        Table<ccstr> resolved_to_import;
+        int len;
+
+        void init();
+        void cleanup();
+        void reset();
     };
 
     Pool mem;
@@ -951,42 +1347,18 @@ struct Module_Resolver {
     Go_Workspace workspace;
     Trie_Node *root_import_to_resolved;
     Trie_Node *root_resolved_to_import;
+    Cache cache;
 
     void init(ccstr root_filepath, ccstr _gomodcache);
-    void cleanup() { mem.cleanup(); }
-
-    Trie_Node *goto_child(Trie_Node *node, ccstr name, bool create_if_not_found) {
-        for (auto it = node->children; it; it = it->next)
-            if (streqi(it->name, name))
-                return it;
-
-        if (create_if_not_found) {
-            SCOPED_MEM(&mem);
-            auto ret = new_object(Trie_Node);
-            ret->next = node->children;
-            ret->name = cp_strdup(name);
-            node->children = ret;
-            return ret;
-        }
-
-        return NULL;
+    void cleanup() {
+        cache.cleanup();
+        mem.cleanup();
     }
 
-    void add_path(ccstr import_path, ccstr resolved_path) {
-        resolved_path = normalize_path_sep(cp_strdup(resolved_path));
-
-        auto add_to_root = [&](Trie_Node *root, ccstr key, ccstr value) {
-            //print("adding %s -> %s", key, value);
-
-            auto path = make_path(key);
-            auto curr = root;
-            For (path->parts) curr = goto_child(curr, it, true);
-            curr->value = value;
-        };
-
-        add_to_root(root_import_to_resolved, import_path, resolved_path);
-        add_to_root(root_resolved_to_import, resolved_path, import_path);
-    }
+    Trie_Node *goto_child(Trie_Node *node, ccstr name, int len, bool create_if_not_found);
+    void add_path(ccstr import_path, ccstr resolved_path);
+    ccstr convert_path(Trie_Node *root, ccstr path, char sep);
+    ccstr cached_convert_path(Table<ccstr> *table, Trie_Node *root, ccstr path, char sep);
 
     ccstr normalize_path_in_module_cache(ccstr import_path) {
         u32 len = 0;
@@ -1009,51 +1381,18 @@ struct Module_Resolver {
         return new_filepath;
     }
 
-    ccstr convert_path(Trie_Node *root, ccstr path, char sep) {
-        auto parts = make_path(path)->parts;
-
-        Trie_Node *curr = root;
-        if (!curr) return NULL;
-
-        ccstr last_value = NULL;
-        i32 last_index = -1;
-
-        for (u32 i = 0; i < parts->len; i++) {
-            auto part = parts->at(i);
-
-            curr = goto_child(curr, part, false);
-            if (!curr) break;
-
-            if (curr->value) {
-                last_value = curr->value;
-                last_index = i + 1;
-            }
-        }
-
-        if (!last_value) return NULL;
-
-        auto ret = new_list(ccstr, parts->len - last_index + 1);
-        ret->append(last_value);
-        for (u32 i = last_index; i < parts->len; i++)
-            ret->append(parts->at(i));
-
-        Path p;
-        p.init(ret);
-        return normalize_path_sep(p.str(), sep);
-    }
-
     ccstr resolve_import(ccstr import_path) {
         if (streq(import_path, "@builtins"))
             return import_path;
 
-        return convert_path(root_import_to_resolved, import_path, PATH_SEP);
+        return cached_convert_path(&cache.import_to_resolved, root_import_to_resolved, import_path, PATH_SEP);
     }
 
     ccstr resolved_path_to_import_path(ccstr resolved_path) {
         if (streq(resolved_path, "@builtins"))
             return resolved_path;
 
-        return convert_path(root_resolved_to_import, resolved_path, '/');
+        return cached_convert_path(&cache.resolved_to_import, root_resolved_to_import, resolved_path, '/');
     }
 };
 
@@ -1084,6 +1423,7 @@ enum Go_Message_Type : u8 {
     GOMSG_OBLITERATE_AND_RECREATE_INDEX,
     GOMSG_CLEANUP_UNUSED_MEMORY,
     GOMSG_FSEVENT,
+    GOMSG_EDITORS_CHANGED,
 };
 
 struct Go_Message {
@@ -1091,6 +1431,7 @@ struct Go_Message {
 
     union {
         ccstr fsevent_filepath; // for GOMSG_FSEVENT
+        List<ccstr> *editor_filepaths; // for GOMSG_EDITORS_CHANGED, current one first
     };
 };
 
@@ -1134,18 +1475,42 @@ struct Go_Symbol {
     Go_Symbol* copy();
 };
 
+// Every node for the same function shares its children, so the hierarchy
+// is really a graph (with cycles, if there's recursion) that the tree view
+// expands as far as the user wants. Copy it with copy_call_hierarchy().
+//
+// The caller hierarchy is built as it's expanded instead: a node's children
+// stay NULL until it's opened, then come from Go_Indexer::list_callers()
+// with callers_key.
 struct Call_Hier_Node {
     Find_Decl *decl;
     Go_Reference *ref;
-    // TODO: what else
     List<Call_Hier_Node> *children;
+    ccstr callers_key; // NULL if it isn't a function
 
     Call_Hier_Node *copy();
 };
 
-struct Seen_Callee_Entry {
-    Goresult *declres;
-    Call_Hier_Node node;
+List<Call_Hier_Node> *copy_call_hierarchy(List<Call_Hier_Node> *nodes);
+
+// A call found while building a Caller_Map. It points at the caller by
+// index rather than by pointer, so the map can outlive the read lock it was
+// built under; generation says whether the indexes still hold.
+struct Caller_Edge {
+    ccstr import_path;
+    ccstr filename;
+    u32 generation; // of the package
+    int caller;     // index into the file's decls
+    int reference;  // index into the file's references
+};
+
+// Who calls what in the workspace, keyed by call_graph_key() of the callee.
+// Built once per caller hierarchy query.
+struct Caller_Map {
+    Table<List<Caller_Edge>*> table;
+    bool incomplete; // some packages' call edges weren't resolved yet
+
+    Caller_Map *copy();
 };
 
 struct Actually_List_Dotprops_Opts {
@@ -1195,6 +1560,339 @@ struct Generate_Struct_Tags_Result {
     cur2 highlight_end;
 };
 
+// What the indexer gets to first. Whatever the user is looking at should
+// work as soon as possible, the rest can wait.
+enum Package_Priority {
+    PKGPRI_CURRENT_EDITOR, // package of the editor the user is in
+    PKGPRI_OPEN_EDITOR,
+    PKGPRI_EDITOR_IMPORT,  // imported by one of the above
+    PKGPRI_WORKSPACE,
+    PKGPRI_OTHER,
+    _PKGPRI_COUNT_,
+};
+
+// The packages the indexer hasn't gotten to. Within a priority it's LIFO,
+// so dependencies still get done depth first. Owned by the background
+// thread; lives in whatever MEM init() was called in.
+struct Package_Queue {
+    List<ccstr> buckets[_PKGPRI_COUNT_];
+    String_Set enqueued;
+    int len;
+
+    void init();
+    bool has(ccstr import_path) { return enqueued.has(import_path); }
+    void push(ccstr import_path, Package_Priority priority);
+    ccstr pop();
+    void clear();
+    void rerank(fn<Package_Priority(ccstr)> get_priority);
+};
+
+// What a package's time in the indexer goes to, see Index_Metrics.
+enum Index_Phase {
+    IPHASE_LIST_DIR,          // fingerprint_package()
+    IPHASE_BUILD_CONSTRAINTS, // list_source_files()
+    IPHASE_SHARED_CACHE,      // Shared_Package_Cache read and write
+    IPHASE_PARSE,
+    IPHASE_PROCESS_TREE,      // process_tree_into_gofile(), minus hashing
+    IPHASE_HASH,
+    IPHASE_WRITE,             // writing the .cpdb; per write, not per package
+    _IPHASE_COUNT_,
+};
+
+ccstr index_phase_str(Index_Phase x);
+
+// A package handed off to an indexer worker. The worker does everything that
+// doesn't touch the index (listing, parsing, processing, hashing) into pools
+// the job owns, and the background thread publishes the result.
+struct Index_Job {
+    Pool mem; // strings and lists that only live as long as the job
+
+    ccstr import_path;
+    ccstr resolved_path;
+    bool use_pool;
+
+    // filled in by worker
+    bool empty; // no source files, package should be removed
+    ccstr package_name;
+    Pool *pool; // only if use_pool
+    List<Go_File> *files;
+    u64 hash;
+    u64 fingerprint;
+    u64 time_taken;
+    u64 phase_nanos[_IPHASE_COUNT_];
+    bool from_shared_cache; // see Shared_Package_Cache
+};
+
+struct Index_Worker_Pool {
+    Go_Indexer *indexer;
+    List<Thread_Handle> threads;
+
+    Lock lock;
+    Cond cond;          // workers wait on this for jobs
+    Cond finished_cond; // background thread waits on this for results
+    List<Index_Job*> pending;
+    List<Index_Job*> finished;
+    int outstanding; // submitted but not yet collected
+    bool stopping;
+
+    void init(Go_Indexer *_indexer, int num_threads);
+    void cleanup();
+    void run_thread();
+
+    void submit(Index_Job *job);
+    bool can_take_more() { return outstanding < threads.len * 4; }
+    bool busy() { return outstanding > 0; }
+    List<Index_Job*> *collect_finished();
+    void wait_for_finished(u32 timeout_milli);
+    List<Index_Job*> *drain();
+};
+
+// Which .go files in each directory are included in the build, so we don't
+// have to go through cgo for every file on every rescan. An entry is good as
+// long as the directory's fingerprint (see Go_Indexer::fingerprint_package())
+// hasn't changed; if the build tags change, everything is thrown out. Used
+// by indexer workers too, hence the lock.
+struct Build_Constraint_Cache {
+    struct Entry {
+        u64 fingerprint;
+        List<ccstr> *files;
+    };
+
+    Pool mem;
+    Lock lock;
+    Table<Entry*> table;
+    u64 tags_hash;
+    bool dirty; // changed since last write()
+
+    void init();
+    void cleanup();
+    void clear();
+    void set_tags_hash(u64 hash);
+    List<ccstr> *get(ccstr dirpath, u64 fingerprint);
+    void set(ccstr dirpath, u64 fingerprint, List<ccstr> *files);
+    bool read(ccstr path);
+    bool write(ccstr path);
+};
+
+// Packages under GOMODCACHE and GOROOT don't change for a given
+// module@version or Go version, so once one project has indexed one, other
+// projects (and other worktrees of the same one) can read its files in
+// instead of parsing it all over again. Each package is a file in the config
+// dir, keyed by its resolved path, which has the module@version in it, and
+// its fingerprint, plus the build tags and Go version. Workers read and write
+// these on their own, which is fine since files are only ever moved into
+// place whole.
+//
+// Nothing ever invalidates an entry (a new version of a module is just a
+// different key), so init() sweeps it: once it's over
+// SHARED_CACHE_MAX_BYTES the oldest entries go, along with any .tmp files
+// left behind by writers that didn't finish.
+struct Shared_Package_Cache {
+    Pool mem;
+    ccstr dir; // NULL if there's nowhere to put it
+    u64 env_hash;
+
+    void init(ccstr configdir, u64 tags_hash, ccstr goroot);
+    void cleanup();
+    void sweep();
+    ccstr get_path(ccstr resolved_path, u64 fingerprint);
+    bool read(Index_Job *job);
+    bool write(Index_Job *job);
+};
+
+#define SHARED_CACHE_MAX_BYTES (2048ull * 1024 * 1024)
+#define SHARED_CACHE_TMP_MAX_AGE_SECS (60 * 60) // younger ones might still be in use
+
+// A package that can be imported, by its name. A list of these is sorted
+// by package_name, which is interned, so all the packages with a given name
+// are next to each other, see Go_Indexer::find_package_names().
+struct Go_Package_Name {
+    ccstr package_name;
+    int package; // index into Go_Index::packages
+};
+
+// What readers see instead of Go_Indexer::index. The background thread
+// publishes a new one after it's changed the index, and never changes
+// anything a published one points at: packages and files that it replaces
+// are retired instead, and only freed once nobody's reading.
+struct Index_Snapshot {
+    Pool mem;
+    Go_Index index;
+    Table<int> package_lookup;
+    List<Go_Package_Name> *package_names;
+};
+
+// Something that got replaced in the index, to be freed once no reader can
+// be looking at it anymore. Only one field is set.
+struct Index_Retiree {
+    Pool *pool;
+    Go_Package_Lazy_Files *lazy_files;
+    u64 *last_used_milli;
+    Index_Snapshot *snapshot;
+
+    void cleanup();
+};
+
+// A package some cached evaluation looked at, and which version of it.
+// Generation 0 means it wasn't in the index.
+struct Go_Eval_Dep {
+    ccstr import_path; // interned
+    u32 generation;
+};
+
+// Results of _evaluate_type() and resolve_type(), shared by every thread.
+// An entry is keyed on the type's structure (see append_gotype_key()) and
+// the ctx, and remembers every package looked up while computing it. It's
+// only used while all of those are at the same generation, which also means
+// whatever it points into hasn't been freed.
+//
+// Entries that go stale are just dropped from the table. The memory is all
+// freed at once, by reclaim_retired() when the cache is full and no one
+// can be holding on to a result.
+struct Go_Eval_Cache {
+    struct Entry {
+        Goresult *result;
+        List<Go_Eval_Dep> *deps;
+    };
+
+    Lock lock;
+    Pool mem;
+    Table<Entry*> table;
+    bool full;
+
+    u64 hits;
+    u64 misses;
+    u64 stale;
+
+    void init();
+    void cleanup();
+    void clear();
+};
+
+// most the cache can hold before it stops taking new entries
+#define EVAL_CACHE_MAX_BYTES (64 * 1024 * 1024)
+
+// How long the main thread waits for the background thread to let go of
+// write_lock before it reloads editors.
+#define EDITOR_RELOAD_WAIT_MILLI 250
+
+#define SCOPE_OPS_CACHE_MAX 64
+#define SCOPE_OPS_CACHE_BUCKETS 128 // power of two
+
+// Files in packages outside the workspace don't keep their scope ops. Those
+// are only needed to resolve names inside function bodies, which is rare
+// for code nobody's editing, and they're most of what a dependency's files
+// take up. Go_Indexer::get_scope_ops() parses the file again when they're
+// needed and keeps the last SCOPE_OPS_CACHE_MAX files' worth here.
+//
+// A reader can still be using an entry after it's evicted, so its pool
+// waits in `evicted` until reclaim_retired() sees there are no readers.
+struct Scope_Ops_Cache {
+    struct Entry {
+        u64 key; // see make_key()
+        ccstr import_path;
+        ccstr filename;
+        u64 package_hash; // Go_Package::hash, so a changed package misses
+        u64 last_used;
+        Pool *pool;
+        List<Go_Scope_Op> *scope_ops;
+        int next; // next entry in the same bucket, or -1
+    };
+
+    Lock lock;
+    Entry entries[SCOPE_OPS_CACHE_MAX];
+    int num_entries;
+    int buckets[SCOPE_OPS_CACHE_BUCKETS]; // first entry in each, or -1
+    List<Pool*> evicted;
+    u64 clock;
+
+    void init();
+    void cleanup();
+    void free_evicted();
+
+    static u64 make_key(ccstr import_path, ccstr filename, u64 package_hash);
+    Entry *find(u64 key, ccstr import_path, ccstr filename);
+    Entry *add(u64 key);
+};
+
+// How often evict_cold_packages() checks the index against
+// options.index_memory_budget_mb, and how long a package has to go unused
+// before it can be evicted.
+#define INDEX_EVICTION_CHECK_MILLI 10000
+#define INDEX_EVICTION_MIN_IDLE_MILLI 60000
+
+#define INDEX_METRICS_HISTORY 240     // queue depth samples kept
+#define INDEX_METRICS_SAMPLE_MILLI 500
+#define INDEX_METRICS_SLOWEST 10
+#define INDEX_METRICS_MAX_POOLS 16
+
+// Where the indexer's time and memory go, so that when indexing is slow we
+// can tell why. Shown in the Index Metrics window, and dumped as JSON by
+// to_json(). Workers' numbers come in through their jobs, but the main
+// thread reads it while the background thread writes it, hence the lock.
+struct Index_Metrics {
+    struct Phase {
+        u64 count; // packages that went through it, or writes for IPHASE_WRITE
+        u64 total_nanos;
+        u64 max_nanos;
+    };
+
+    struct Package {
+        char import_path[256];
+        u64 nanos;
+        u64 phase_nanos[_IPHASE_COUNT_];
+    };
+
+    struct Queue_Sample {
+        u64 time_milli;
+        int queued;    // in Package_Queue
+        int in_flight; // handed off to workers
+    };
+
+    struct Pool_Usage {
+        ccstr name; // string literal
+        u64 bytes;
+    };
+
+    Lock lock;
+    u64 start_milli;
+
+    u64 packages;
+    u64 packages_from_shared_cache;
+    u64 package_nanos;
+    Phase phases[_IPHASE_COUNT_];
+    Package slowest[INDEX_METRICS_SLOWEST]; // slowest first
+    int num_slowest;
+
+    // ring buffer
+    Queue_Sample queue_samples[INDEX_METRICS_HISTORY];
+    int queue_start;
+    int queue_len;
+
+    // from start_writing() until the matching stop_writing()
+    u64 writing_count;
+    u64 writing_total_milli;
+    u64 writing_max_milli;
+    u64 writing_last_milli;
+
+    // as of the last sample
+    Pool_Usage pools[INDEX_METRICS_MAX_POOLS];
+    int num_pools;
+    u64 eval_cache_hits;
+    u64 eval_cache_misses;
+    u64 eval_cache_stale;
+    u64 last_sample_milli;
+
+    void init();
+    void cleanup();
+    void add_job(Index_Job *job);
+    void add_write(u64 nanos);
+    void add_writing(u64 milli);
+    void add_queue_sample(int queued, int in_flight);
+    Queue_Sample *get_queue_sample(int i) { return &queue_samples[(queue_start + i) % INDEX_METRICS_HISTORY]; }
+    ccstr to_json();
+};
+
 struct Go_Indexer {
     ccstr goroot;
     ccstr gomodcache;
@@ -1211,6 +1909,34 @@ struct Go_Indexer {
     Pool package_lookup_mem;
     Pool scoped_table_mem;
 
+    // Pool structs handed out to workers. They have to stay put once lists
+    // have been allocated out of them, so they can't be moved over from a
+    // job's own memory when it gets published.
+    Pool index_pools_mem;
+    Lock index_pools_lock;
+    Index_Worker_Pool workers;
+
+    // The .cpdb we read the index from. It stays mapped so that packages'
+    // files can be read in the first time something looks at them, instead
+    // of all at startup.
+    Index_Stream index_source;
+    bool index_source_open;
+    u32 index_source_generation; // bumped whenever offsets into it change
+    Go_Atom_Map index_atom_map;  // atom ids in index_source
+    Lock index_source_lock;
+
+    Go_Atom_Table atoms;
+    Go_Eval_Cache eval_cache;
+    Scope_Ops_Cache scope_ops_cache;
+    Index_Metrics metrics;
+
+    // Bumped every time a package's files change, so Go_Eval_Cache can
+    // tell when an entry is out of date. Belongs to write_lock.
+    u32 last_package_generation;
+
+    Build_Constraint_Cache build_cache;
+    Shared_Package_Cache shared_cache;
+
     Module_Resolver module_resolver;
     Go_Index index;
 
@@ -1222,12 +1948,44 @@ struct Go_Indexer {
 
     Message_Queue<Go_Message> message_queue;
 
+    // `index` and `package_lookup` belong to whoever holds write_lock: the
+    // background thread, or the main thread when it's pushing editors in.
+    // Readers (acquire_lock(IND_READING)) never wait on it, they look at
+    // `snapshot` instead.
+    Lock write_lock;
+    bool snapshot_dirty;
+    u64 last_publish_milli;
+    u64 last_eviction_check_milli;
+    bool over_memory_budget; // as of the last evict_cold_packages()
+
+    // Protects everything below. The first retired_published things in
+    // `retired` aren't in `snapshot` anymore, and get freed once readers
+    // hits 0; the rest got retired since the last publish.
     Lock lock;
+    Cond readers_cond;
+    Index_Snapshot *snapshot;
+    List<Index_Retiree> retired;
+    int retired_published;
+    int readers;
+    bool exclusive;
+    bool write_lock_wanted; // see wait_for_write_lock()
+    Cond write_lock_cond;   // signaled when write_lock_wanted changes or the background thread yields
+
+    // The last reload of open editors couldn't get write_lock, so queries
+    // are running against what was indexed before. Main thread only.
+    bool editor_reload_skipped;
+
     Indexer_Status status;
     int reacquires;
     bool dont_resolve_builtin;
     u64 time_started_writing_milli;
 
+    // Set once the background thread first runs out of things to do, i.e.
+    // everything's been indexed, written out, and had its call edges
+    // resolved. Under `lock`, see wait_for_initial_index().
+    bool finished_initial_index;
+    Cond finished_initial_index_cond;
+
     // ---
 
     void background_thread();
@@ -1242,14 +2000,25 @@ struct Go_Indexer {
     Parameter_Hint *parameter_hint(ccstr filepath, cur2 pos);
     List<Go_Import> *optimize_imports(ccstr filepath);
     ccstr find_best_import(ccstr package_name, List<ccstr> *identifiers);
+    List<Go_Package_Name> *build_package_names(Go_Index *index);
+    List<Go_Package_Name> *get_package_names(List<Go_Package> **packages);
+    List<Go_Package_Name> *find_package_names(ccstr package_name, List<Go_Package> **packages);
 
     ccstr filepath_to_import_path(ccstr filepath);
     bool process_package(ccstr import_path, Go_Package *pkg);
+    Pool *new_index_pool(ccstr name);
+    Index_Job *new_index_job(ccstr import_path, ccstr resolved_path, bool use_pool);
+    void free_index_job(Index_Job *job, bool published);
+    void run_index_job(Index_Job *job);
+    bool is_package_shareable(ccstr resolved_path);
+    void editors_changed();
     List<ccstr>* list_source_files(ccstr dirpath, bool include_tests);
+    List<ccstr>* list_included_files(ccstr dirpath);
     ccstr get_package_path(ccstr import_path);
     void free_parsed_file(Parsed_File *file);
     void handle_error(ccstr err);
     u64 hash_package(ccstr resolved_package_path);
+    u64 fingerprint_package(ccstr resolved_package_path);
     ccstr ctx_to_filepath(Go_Ctx *ctx);
     Go_Ctx *filepath_to_ctx(ccstr filepath);
     Goresult *resolve_type(Goresult *res);
@@ -1279,6 +2048,29 @@ struct Go_Indexer {
     ccstr find_import_path_referred_to_by_id(ccstr id, Go_Ctx *ctx);
     Pool *get_final_mem();
     Go_Package *find_up_to_date_package(ccstr import_path);
+    void load_package_files(Go_Package *pkg);
+    void evict_cold_packages();
+    bool can_evict_package(Go_Package *pkg);
+    void evict_package(Go_Package *pkg);
+    void close_index_source();
+    bool reopen_index_source();
+    Go_Index *get_index();
+    void enter_write_lock();
+    bool try_enter_write_lock();
+    bool wait_for_write_lock(u32 timeout_milli);
+    bool wait_for_initial_index(u32 timeout_milli);
+    void yield_write_lock();
+    void leave_write_lock();
+    Index_Snapshot *build_snapshot();
+    void install_snapshot(Index_Snapshot *snap);
+    void publish_snapshot();
+    void retire(Index_Retiree *retiree);
+    void retire_pool(Pool *pool);
+    void retire_package(Go_Package *pkg);
+    void reclaim_retired();
+    void enter_exclusive();
+    void leave_exclusive();
+    void update_status();
     void import_spec_to_decl(Ast_Node *spec_node, Godecl *decl);
     List<Postfix_Completion_Type> *get_postfix_completions(Ast_Node *operand_node, Go_Ctx *ctx);
     List<Goresult> *get_node_dotprops(Ast_Node *operand_node, bool *was_package, Go_Ctx *ctx);
@@ -1287,6 +2079,9 @@ struct Go_Indexer {
     Goresult *evaluate_type(Goresult *res, Godecl** outdecl = NULL);
     Goresult *_evaluate_type(Goresult *res, Godecl** outdecl = NULL);
     Goresult *_evaluate_type(Gotype *gotype, Go_Ctx *ctx, Godecl** outdecl = NULL);
+    Goresult *actually_evaluate_type(Gotype *gotype, Go_Ctx *ctx, Godecl** outdecl = NULL);
+    Goresult *cached_eval(char kind, Gotype *gotype, Go_Ctx *ctx, fn<Goresult*()> compute);
+    void bump_package_generation(Go_Package *pkg);
     Gotype *expr_to_gotype(Ast_Node *expr);
     void process_tree_into_gofile(
         Go_File *file,
@@ -1304,17 +2099,25 @@ struct Go_Indexer {
     void reload_single_file(ccstr path);
     Go_Package_Status get_package_status(ccstr import_path);
     void replace_package_name(Go_Package *pkg, ccstr package_name);
+    void rebuild_reference_names(Go_Package *pkg);
+    void add_reference_names(Go_Package *pkg, Go_File *file);
+    void rebuild_method_sets(Go_Package *pkg);
+    void add_method_sets(Go_Package *pkg, Go_File *file);
     u64 hash_file(ccstr filepath);
     void start_writing(bool skip_if_already_started = false);
     void stop_writing();
     bool truncate_parsed_file(Parsed_File *pf, cur2 end_pos, ccstr chars_to_append);
     Gotype *get_closest_function(ccstr filepath, cur2 pos);
 
-    void fill_goto_symbol(List<Go_Symbol> *out);
+    void rebuild_symbols(Go_Package *pkg);
+    void rebuild_decl_table(Go_Package *pkg);
+    void invalidate_decl_table(Go_Package *pkg);
+    void fill_goto_symbol(List<Go_Symbol_Entry> *out);
     void init_builtins(Go_Package *pkg);
     void import_decl_to_goimports(Ast_Node *decl_node, List<Go_Import> *out);
     bool check_if_still_in_parameter_hint(ccstr filepath, cur2 cur, cur2 hint_start);
     Go_File *find_gofile_from_ctx(Go_Ctx *ctx, Go_Package **out = NULL);
+    List<Go_Scope_Op> *get_scope_ops(Go_Package *pkg, Go_File *file);
 
     List<Find_References_File>* find_references(ccstr filepath, cur2 pos, bool include_self);
     List<Find_References_File>* find_references(Goresult *declres, bool include_self);
@@ -1328,6 +2131,10 @@ struct Go_Indexer {
         return acquire_lock(new_status, true);
     }
 
+    Index_Snapshot *get_pinned_snapshot();
+    Index_Snapshot *hand_off_read_lock();
+    void adopt_read_lock(Index_Snapshot *snap);
+
     bool are_gotypes_equal(Goresult *ra, Goresult *rb);
     bool are_decls_equal(Goresult *adecl, Goresult *bdecl);
     bool are_ctxs_equal(Go_Ctx *a, Go_Ctx *b);
@@ -1342,11 +2149,14 @@ struct Go_Indexer {
     bool is_gotype_error(Goresult *res);
     bool is_import_path_internal(ccstr import_path);
 
-    List<Call_Hier_Node>* generate_caller_hierarchy(Goresult *declres);
-    void actually_generate_caller_hierarchy(Goresult *declres, List<Call_Hier_Node> *out);
-
+    List<Call_Hier_Node>* generate_caller_hierarchy(Goresult *declres, Caller_Map **callers);
+    List<Call_Hier_Node>* list_callers(Caller_Map *callers, ccstr key);
     List<Call_Hier_Node>* generate_callee_hierarchy(Goresult *declres);
-    void actually_generate_callee_hierarchy(Goresult *declres, List<Call_Hier_Node> *out, List<Seen_Callee_Entry> *seen = NULL);
+    void compute_call_edges(Go_Package *pkg, List<Go_Call_Edge> *out);
+    void compute_file_call_edges(ccstr import_path, Go_File *file, int only_caller, List<Go_Call_Edge> *out);
+    void update_call_edges(Go_Package *pkg, ccstr filename);
+    bool resolve_call_edges(u64 budget_milli);
+    Goresult *find_call_edge_callee(Go_Call_Edge *edge);
     ccstr get_godecl_recvname(Godecl *it);
     Goresult *get_reference_decl(Go_Reference *it, Go_Ctx *ctx);
     Godecl *find_toplevel_containing(Go_File *file, cur2 start, cur2 end);
@@ -1381,6 +2191,8 @@ Goresult *make_goresult(Gotype *gotype, Go_Ctx *ctx);
 Goresult *make_goresult(Godecl *decl, Go_Ctx *ctx);
 
 TSParser *new_ts_parser(Parse_Lang lang);
+TSParser *get_thread_ts_parser(Parse_Lang lang);
+void cleanup_thread_ts_parsers();
 
 template<typename T>
 T *read_object(Index_Stream *s) {
@@ -1433,6 +2245,10 @@ void write_object(T *obj, Index_Stream *s) {
     obj->write(s);
 }
 
+// Gotypes go through Index_Stream::gotype_handles instead.
+template<> Gotype *read_object<Gotype>(Index_Stream *s);
+template<> void write_object<Gotype>(Gotype *obj, Index_Stream *s);
+
 template<typename L>
 void write_list(L arr, Index_Stream *s) {
     if (!arr) {
@@ -1472,6 +2288,7 @@ struct Type_Renderer : public Text_Renderer {
 };
 
 bool is_name_special_function(ccstr name);
+bool is_goident_empty(ccstr name);
 
 typedef fn<Gotype*(Gotype*)> walk_gotype_and_replace_cb;
 Gotype* walk_gotype_and_replace(Gotype *gotype, walk_gotype_and_replace_cb cb);
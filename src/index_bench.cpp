@@ -0,0 +1,369 @@
+// Runs the indexer without a window, for benchmarking and profiling it on
+// build machines. It's its own binary, built with `make index_bench`:
+//
+//     index_bench [--queries <file>] [--metrics-json <file>] [--timeout <secs>] <folder>
+//
+// Indexes the folder, replays the queries if there are any, and prints how
+// long everything took, peak memory and Index_Metrics. Each line of the
+// queries file is
+//
+//     <definition|autocomplete|references> <file> <line> <col>
+//
+// with file relative to the folder, line and col starting at 1, and col in
+// bytes. Blank lines and lines starting with # are skipped.
+//
+// It only links the indexer and what it sits on (see core.hpp), not main.cpp,
+// world.cpp or ui.cpp, so this file brings its own `core`, main(), and
+// stand-ins for what the UI and the platform layer normally provide. It's
+// always built optimized, into obj/index_bench/; sh/index_bench builds and
+// runs it.
+
+#include "core.hpp"
+#include "go.hpp"
+#include "os.hpp"
+#include "utils.hpp"
+#include "defer.hpp"
+
+enum Bench_Query_Type {
+    BQ_DEFINITION,
+    BQ_AUTOCOMPLETE,
+    BQ_REFERENCES,
+    _BQ_COUNT_,
+};
+
+static ccstr bench_query_type_str(int type) {
+    switch (type) {
+    case BQ_DEFINITION: return "definition";
+    case BQ_AUTOCOMPLETE: return "autocomplete";
+    case BQ_REFERENCES: return "references";
+    }
+    return NULL;
+}
+
+struct Bench_Query {
+    Bench_Query_Type type;
+    ccstr filepath;
+    cur2 pos;
+};
+
+static List<Bench_Query> *read_bench_queries(ccstr path) {
+    auto data = read_file(path);
+    if (!data) {
+        print("unable to read %s", path);
+        return NULL;
+    }
+
+    auto ret = new_list(Bench_Query);
+    int lineno = 0;
+
+    For (split_string(data, '\n')) {
+        lineno++;
+
+        auto parts = split_string(it, [&](char ch) { return isspace(ch); });
+        parts->filter([&](auto it) { return **it != '\0'; });
+        if (!parts->len || parts->at(0)[0] == '#') continue;
+
+        int type = 0;
+        for (; type < _BQ_COUNT_; type++)
+            if (streq(parts->at(0), bench_query_type_str(type)))
+                break;
+
+        if (type == _BQ_COUNT_ || parts->len != 4) {
+            print("%s:%d: expected <definition|autocomplete|references> <file> <line> <col>", path, lineno);
+            return NULL;
+        }
+
+        auto filepath = parts->at(1);
+        if (filepath[0] != '/')
+            filepath = path_join(core.current_path, filepath);
+
+        auto q = ret->append();
+        q->type = (Bench_Query_Type)type;
+        q->filepath = filepath;
+        q->pos = new_cur2(atoi(parts->at(3)) - 1, atoi(parts->at(2)) - 1);
+    }
+
+    return ret;
+}
+
+static void print_index_metrics(Index_Metrics *metrics) {
+    SCOPED_LOCK(&metrics->lock);
+
+    auto ms = [&](u64 nanos) { return nanos / 1000000.0; };
+
+    print(
+        "%llu packages (%llu from shared cache), %.0fms of worker time",
+        metrics->packages,
+        metrics->packages_from_shared_cache,
+        ms(metrics->package_nanos)
+    );
+
+    print("%-20s %10s %12s %10s %10s", "phase", "count", "total (ms)", "avg (ms)", "max (ms)");
+    for (int i = 0; i < _IPHASE_COUNT_; i++) {
+        auto &it = metrics->phases[i];
+        print(
+            "%-20s %10llu %12.1f %10.2f %10.1f",
+            index_phase_str((Index_Phase)i),
+            it.count,
+            ms(it.total_nanos),
+            it.count ? ms(it.total_nanos) / it.count : 0.0,
+            ms(it.max_nanos)
+        );
+    }
+
+    print(
+        "start_writing(): held %llu times, %llums total, %llums max",
+        metrics->writing_count,
+        metrics->writing_total_milli,
+        metrics->writing_max_milli
+    );
+
+    int max_queued = 0;
+    for (int i = 0; i < metrics->queue_len; i++)
+        max_queued = max(max_queued, metrics->get_queue_sample(i)->queued);
+    print("queue depth: %d max", max_queued);
+
+    for (int i = 0; i < metrics->num_pools; i++) {
+        auto &it = metrics->pools[i];
+        print("%-20s %10.1f MB", it.name, it.bytes / 1024.0 / 1024.0);
+    }
+
+    if (metrics->num_slowest) {
+        print("slowest packages:");
+        for (int i = 0; i < metrics->num_slowest; i++) {
+            auto &it = metrics->slowest[i];
+            print("%10.1fms  %s", ms(it.nanos), it.import_path);
+        }
+    }
+}
+
+// Nobody else reads the main thread's messages. The background thread posts
+// MTM_EXIT when it dies (see cp_exit()), so that's a failure.
+static bool handle_main_thread_messages() {
+    auto messages = core.message_queue.start();
+    defer { core.message_queue.end(); };
+
+    For (messages) {
+        switch (it.type) {
+        case MTM_TELL_USER:
+            print("%s: %s", it.tell_user_title, it.tell_user_text);
+            break;
+        case MTM_EXIT:
+            if (it.exit_message) print("%s", it.exit_message);
+            return false;
+        }
+    }
+    return true;
+}
+
+static int run_index_bench(ccstr queries_path, ccstr metrics_json_path, u32 timeout_secs) {
+    auto &ind = core.indexer;
+
+    List<Bench_Query> *queries = NULL;
+    if (queries_path) {
+        queries = read_bench_queries(queries_path);
+        if (!queries) return EXIT_FAILURE;
+    }
+
+    print("indexing %s", core.current_path);
+
+    auto start = current_time_nano();
+
+    if (!ind.start_background_thread()) {
+        print("unable to start indexer");
+        return EXIT_FAILURE;
+    }
+
+    auto deadline = current_time_milli() + (u64)timeout_secs * 1000;
+    while (!ind.wait_for_initial_index(1000)) {
+        if (!handle_main_thread_messages()) {
+            print("indexer exited");
+            return EXIT_FAILURE;
+        }
+        if (current_time_milli() >= deadline) {
+            print("initial index didn't finish in %us", timeout_secs);
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto index_nanos = current_time_nano() - start;
+
+    print("");
+    print_index_metrics(&ind.metrics);
+
+    if (queries) {
+        print("");
+
+        u64 total[_BQ_COUNT_] = {0};
+        u64 slowest[_BQ_COUNT_] = {0};
+        int count[_BQ_COUNT_] = {0};
+
+        Pool query_mem;
+        query_mem.init("index_bench_query_mem");
+        defer { query_mem.cleanup(); };
+
+        For (queries) {
+            query_mem.reset();
+            SCOPED_MEM(&query_mem);
+
+            if (!ind.acquire_lock(IND_READING)) {
+                print("unable to read index");
+                return EXIT_FAILURE;
+            }
+            defer { ind.release_lock(IND_READING); };
+
+            auto query_start = current_time_nano();
+            int results = 0;
+
+            switch (it.type) {
+            case BQ_DEFINITION: {
+                auto res = ind.jump_to_definition(it.filepath, it.pos);
+                if (res && res->decl) results = 1;
+                break;
+            }
+            case BQ_AUTOCOMPLETE: {
+                Autocomplete ac; ptr0(&ac);
+                if (ind.autocomplete(it.filepath, it.pos, false, &ac) && ac.results)
+                    results = ac.results->len;
+                break;
+            }
+            case BQ_REFERENCES: {
+                auto res = ind.jump_to_definition(it.filepath, it.pos);
+                if (!res || !res->decl) break;
+
+                auto files = ind.find_references(res->decl, false);
+                if (files)
+                    for (int i = 0; i < files->len; i++)
+                        results += files->at(i).results->len;
+                break;
+            }
+            }
+
+            auto nanos = current_time_nano() - query_start;
+            total[it.type] += nanos;
+            slowest[it.type] = max(slowest[it.type], nanos);
+            count[it.type]++;
+
+            print(
+                "%-12s %s:%d:%d  %d results, %.2fms",
+                bench_query_type_str(it.type),
+                get_path_relative_to(it.filepath, core.current_path),
+                it.pos.y + 1,
+                it.pos.x + 1,
+                results,
+                nanos / 1000000.0
+            );
+        }
+
+        print("");
+        for (int i = 0; i < _BQ_COUNT_; i++) {
+            if (!count[i]) continue;
+            print(
+                "%-12s %d queries, %.2fms avg, %.2fms max",
+                bench_query_type_str(i),
+                count[i],
+                total[i] / 1000000.0 / count[i],
+                slowest[i] / 1000000.0
+            );
+        }
+    }
+
+    if (metrics_json_path) {
+        if (!write_file(metrics_json_path, ind.metrics.to_json())) {
+            print("unable to write %s", metrics_json_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    print("");
+    print("index: %.2fs", index_nanos / 1000000000.0);
+    print("wall time: %.2fs", (current_time_nano() - start) / 1000000000.0);
+    print("peak memory: %.1f MB", get_peak_memory_usage() / 1024.0 / 1024.0);
+    return 0;
+}
+
+// ---
+// stand-ins for the UI and the platform layer
+
+static World_Core headless_core;
+World_Core &core = headless_core;
+
+List<Editor*> *get_all_editors() { return new_list(Editor*); }
+Editor* get_current_editor() { return NULL; }
+Editor* find_editor_by_filepath(ccstr filepath) { return NULL; }
+void update_search_results_after_edit(Buffer *buf, cur2 start, cur2 newend) {}
+
+void os_tell_user(ccstr text, ccstr title) {
+    print("%s: %s", title, text);
+}
+
+Ask_User_Result os_ask_user_yes_no(ccstr text, ccstr title, ccstr yeslabel, ccstr nolabel, bool cancel) {
+    print("%s: %s (answering %s)", title, text, cancel ? "cancel" : nolabel);
+    return cancel ? ASKUSER_CANCEL : ASKUSER_NO;
+}
+
+bool os_let_user_select_file(Select_File_Opts *opts) {
+    return false;
+}
+
+#define INDEX_BENCH_DEFAULT_TIMEOUT_SECS 3600
+
+int main(int argc, char **argv) {
+    is_main_thread = true;
+
+    gargc = argc;
+    gargv = argv;
+
+    Pool main_mem;
+    main_mem.init("index_bench_main_mem");
+    SCOPED_MEM(&main_mem);
+
+    ccstr folder = NULL;
+    ccstr queries_path = NULL;
+    ccstr metrics_json_path = NULL;
+    u32 timeout_secs = INDEX_BENCH_DEFAULT_TIMEOUT_SECS;
+
+    for (int i = 1; i < argc; i++) {
+        auto it = argv[i];
+
+        if (streq(it, "--queries") || streq(it, "--metrics-json") || streq(it, "--timeout")) {
+            if (i+1 >= argc) {
+                print("missing argument to %s", it);
+                return EXIT_FAILURE;
+            }
+            auto val = argv[++i];
+
+            if (streq(it, "--queries"))
+                queries_path = val;
+            else if (streq(it, "--metrics-json"))
+                metrics_json_path = val;
+            else
+                timeout_secs = atoi(val);
+        } else if (!folder) {
+            folder = it;
+        } else {
+            print("unexpected argument %s", it);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!folder) {
+        print("usage: index_bench [--queries <file>] [--metrics-json <file>] [--timeout <secs>] <folder>");
+        return EXIT_FAILURE;
+    }
+
+    core.init_core();
+    core.print_index_log = true;
+
+    cp_strcpy_fixed(core.current_path, rel_to_abs_path(folder));
+    if (check_path(core.current_path) != CPR_DIRECTORY) {
+        print("%s is not a directory", core.current_path);
+        return EXIT_FAILURE;
+    }
+
+    GHGitIgnoreInit(core.current_path);
+    cp_chdir(core.current_path);
+
+    core.indexer.init();
+    return run_index_bench(queries_path, metrics_json_path, timeout_secs);
+}
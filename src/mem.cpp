@@ -1,5 +1,5 @@
 #include "mem.hpp"
-#include "world.hpp"
+#include "core.hpp"
 #include "common.hpp"
 
 thread_local Pool *MEM;
@@ -59,14 +59,14 @@ uchar* alloc_chunk(s32 needed, s32* new_size) {
 
         *new_size = size;
         switch (size) {
-            case CHUNK0: return (uchar*)world.chunk0_fridge.alloc();
-            case CHUNK1: return (uchar*)world.chunk1_fridge.alloc();
-            case CHUNK2: return (uchar*)world.chunk2_fridge.alloc();
-            case CHUNK3: return (uchar*)world.chunk3_fridge.alloc();
-            case CHUNK4: return (uchar*)world.chunk4_fridge.alloc();
-            case CHUNK5: return (uchar*)world.chunk5_fridge.alloc();
-            case CHUNK6: return (uchar*)world.chunk6_fridge.alloc();
-            case CHUNK7: return (uchar*)world.chunk7_fridge.alloc();
+            case CHUNK0: return (uchar*)core.chunk0_fridge.alloc();
+            case CHUNK1: return (uchar*)core.chunk1_fridge.alloc();
+            case CHUNK2: return (uchar*)core.chunk2_fridge.alloc();
+            case CHUNK3: return (uchar*)core.chunk3_fridge.alloc();
+            case CHUNK4: return (uchar*)core.chunk4_fridge.alloc();
+            case CHUNK5: return (uchar*)core.chunk5_fridge.alloc();
+            case CHUNK6: return (uchar*)core.chunk6_fridge.alloc();
+            case CHUNK7: return (uchar*)core.chunk7_fridge.alloc();
         }
     }
 
@@ -82,14 +82,14 @@ uchar* alloc_chunk(s32 needed, s32* new_size) {
 
 void free_chunk(uchar* buf, s32 cap) {
     switch (cap) {
-        case CHUNK0: world.chunk0_fridge.free((Chunk0*)buf); break;
-        case CHUNK1: world.chunk1_fridge.free((Chunk1*)buf); break;
-        case CHUNK2: world.chunk2_fridge.free((Chunk2*)buf); break;
-        case CHUNK3: world.chunk3_fridge.free((Chunk3*)buf); break;
-        case CHUNK4: world.chunk4_fridge.free((Chunk4*)buf); break;
-        case CHUNK5: world.chunk5_fridge.free((Chunk5*)buf); break;
-        case CHUNK6: world.chunk6_fridge.free((Chunk6*)buf); break;
-        case CHUNK7: world.chunk7_fridge.free((Chunk7*)buf); break;
+        case CHUNK0: core.chunk0_fridge.free((Chunk0*)buf); break;
+        case CHUNK1: core.chunk1_fridge.free((Chunk1*)buf); break;
+        case CHUNK2: core.chunk2_fridge.free((Chunk2*)buf); break;
+        case CHUNK3: core.chunk3_fridge.free((Chunk3*)buf); break;
+        case CHUNK4: core.chunk4_fridge.free((Chunk4*)buf); break;
+        case CHUNK5: core.chunk5_fridge.free((Chunk5*)buf); break;
+        case CHUNK6: core.chunk6_fridge.free((Chunk6*)buf); break;
+        case CHUNK7: core.chunk7_fridge.free((Chunk7*)buf); break;
         default: cp_free(buf); break;
     }
 }
@@ -1,5 +1,5 @@
 #include "os.hpp"
-#include "world.hpp"
+#include "core.hpp"
 #include "cwalk.h"
 #include "defer.hpp"
 #include <unistd.h>
@@ -57,7 +57,7 @@ Ask_User_Result ask_user_yes_no_cancel(ccstr text, ccstr title, ccstr yeslabel,
 
 Ask_User_Result ask_user_yes_no(ccstr text, ccstr title, ccstr yeslabel, ccstr nolabel, bool cancel) {
     auto ret = os_ask_user_yes_no(text, title, yeslabel, nolabel, cancel);
-    world.message_queue.try_add([&](auto msg) {
+    core.message_queue.try_add([&](auto msg) {
         msg->type = MTM_RESET_AFTER_DEFOCUS;
     });
     return ret;
@@ -65,14 +65,14 @@ Ask_User_Result ask_user_yes_no(ccstr text, ccstr title, ccstr yeslabel, ccstr n
 
 void tell_user(ccstr text, ccstr title) {
     os_tell_user(text, title);
-    world.message_queue.try_add([&](auto msg) {
+    core.message_queue.try_add([&](auto msg) {
         msg->type = MTM_RESET_AFTER_DEFOCUS;
     });
 }
 
 bool let_user_select_file(Select_File_Opts* opts) {
     auto ret = os_let_user_select_file(opts);
-    world.message_queue.try_add([&](auto msg) {
+    core.message_queue.try_add([&](auto msg) {
         msg->type = MTM_RESET_AFTER_DEFOCUS;
     });
     return ret;
@@ -187,7 +187,7 @@ NORETURN void cp_exit(ccstr s) {
         tell_user(s, "An error has occurred");
         exit(1);
     } else {
-        world.message_queue.try_add([&](auto msg) {
+        core.message_queue.try_add([&](auto msg) {
             msg->type = MTM_EXIT;
             msg->exit_message = cp_strdup(s);
             msg->exit_code = 1;
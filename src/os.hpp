@@ -138,6 +138,16 @@ struct Scoped_Lock {
 
 #define SCOPED_LOCK(lock) Scoped_Lock GENSYM(SCOPED_LOCk)(lock)
 
+struct Cond {
+    pthread_cond_t cond;
+    void init();
+    void cleanup();
+    void wait(Lock *lock);
+    bool wait(Lock *lock, u32 timeout_milli); // returns false on timeout
+    void signal();
+    void broadcast();
+};
+
 ccstr get_normalized_path(ccstr path);
 
 enum Check_Path_Result {
@@ -148,6 +158,14 @@ enum Check_Path_Result {
 
 Check_Path_Result check_path(ccstr path);
 
+struct File_Stat {
+    u64 size;
+    u64 mtime_nano;
+    u64 inode;
+};
+
+bool stat_file(ccstr path, File_Stat *out);
+
 #define get_last_error() cp_sprintf("(%d) %s", errno, strerror(errno))
 #define get_socket_error() strerror(errno)
 
@@ -174,8 +192,11 @@ typedef void* Thread_Handle;
 typedef void (*Thread_Callback)(void*);
 Thread_Handle create_thread(Thread_Callback callback, void* param = NULL);
 void close_thread_handle(Thread_Handle h);
+void join_thread(Thread_Handle h);
 void kill_thread(Thread_Handle h);
 NORETURN void exit_thread(int retval);
+int get_cpu_count();
+u64 get_peak_memory_usage(); // in bytes
 
 enum {
     FILE_MODE_READ = 1 << 0,
@@ -243,6 +264,7 @@ u64 get_file_size(ccstr file);
 
 struct File_Mapping_Opts {
     bool write;
+    bool append; // with write, map existing file as is instead of truncating it
     // File_Open_Mode open_mode;
     i64 initial_size;
 };
@@ -29,7 +29,7 @@
 
 #include "utils.hpp"
 #include "defer.hpp"
-#include "world.hpp"
+#include "core.hpp"
 
 u64 current_time_nano() {
     static uint64_t start_mach;
@@ -12,6 +12,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/param.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <ftw.h>
 #include <libgen.h>
@@ -19,7 +20,7 @@
 
 #include "utils.hpp"
 #include "defer.hpp"
-#include "world.hpp"
+#include "core.hpp"
 
 struct Thread_Ctx {
     Thread_Callback callback;
@@ -48,6 +49,10 @@ void close_thread_handle(Thread_Handle h) {
     return; // win32's CloseHandle isn't really a thing
 }
 
+void join_thread(Thread_Handle h) {
+    pthread_join((pthread_t)h, NULL);
+}
+
 void kill_thread(Thread_Handle h) {
     pthread_cancel((pthread_t)h);
 }
@@ -56,6 +61,22 @@ NORETURN void exit_thread(int retval) {
     pthread_exit((void*)(uptr)retval);
 }
 
+int get_cpu_count() {
+    auto ret = sysconf(_SC_NPROCESSORS_ONLN);
+    return ret < 1 ? 1 : (int)ret;
+}
+
+u64 get_peak_memory_usage() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+
+#ifdef __APPLE__
+    return (u64)usage.ru_maxrss;
+#else
+    return (u64)usage.ru_maxrss * 1024; // linux gives kilobytes
+#endif
+}
+
 void Lock::init() {
     pthread_mutex_init(&lock, NULL);
 }
@@ -76,6 +97,39 @@ void Lock::leave() {
     pthread_mutex_unlock(&lock);
 }
 
+void Cond::init() {
+    pthread_cond_init(&cond, NULL);
+}
+
+void Cond::cleanup() {
+    pthread_cond_destroy(&cond);
+}
+
+void Cond::wait(Lock *lock) {
+    pthread_cond_wait(&cond, &lock->lock);
+}
+
+bool Cond::wait(Lock *lock, u32 timeout_milli) {
+    // macos doesn't have pthread_condattr_setclock, so this has to be realtime
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_milli / 1000;
+    ts.tv_nsec += (long)(timeout_milli % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait(&cond, &lock->lock, &ts) != ETIMEDOUT;
+}
+
+void Cond::signal() {
+    pthread_cond_signal(&cond);
+}
+
+void Cond::broadcast() {
+    pthread_cond_broadcast(&cond);
+}
+
 File_Result File::init(ccstr path, int access, File_Open_Mode open_mode) {
     char open_mode_str[5] = {0};
 
@@ -249,8 +303,12 @@ bool touch_file(ccstr path) {
 
 bool File_Mapping::create_actual_file_mapping(i64 size) {
     if (opts.write) {
-        lseek(fd, size-1, SEEK_SET);
-        write(fd, "", 1);
+        // grow the file if needed, without clobbering anything already there
+        struct stat statbuf;
+        if (fstat(fd, &statbuf) != 0 || statbuf.st_size < size) {
+            lseek(fd, size-1, SEEK_SET);
+            write(fd, "", 1);
+        }
         data = (u8*)mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     } else {
         data = (u8*)mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
@@ -272,14 +330,17 @@ bool File_Mapping::init(ccstr path, File_Mapping_Opts *_opts) {
 
     memcpy(&opts, _opts, sizeof(opts));
 
-    fd = opts.write ? open(path, O_CREAT|O_RDWR|O_TRUNC, 0644) : open(path, O_RDONLY);
+    if (opts.write)
+        fd = opts.append ? open(path, O_RDWR) : open(path, O_CREAT|O_RDWR|O_TRUNC, 0644);
+    else
+        fd = open(path, O_RDONLY);
     if (fd == -1) {
         error("file_mapping::init > open: %s", get_last_error());
         return false;
     }
     defer { if (!ok) { close(fd); fd = -1; } };
 
-    if (opts.write) {
+    if (opts.write && !opts.append) {
         len = opts.initial_size;
     } else {
         struct stat statbuf;
@@ -380,6 +441,20 @@ Check_Path_Result check_path(ccstr path) {
     return S_ISDIR(st.st_mode) ? CPR_DIRECTORY : CPR_FILE;
 }
 
+bool stat_file(ccstr path, File_Stat *out) {
+    struct stat st;
+    if (stat(path, &st) == -1) return false;
+
+    out->size = st.st_size;
+    out->inode = st.st_ino;
+#ifdef __APPLE__
+    out->mtime_nano = (u64)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    out->mtime_nano = (u64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
 bool list_directory(ccstr folder, list_directory_cb cb) {
     auto dir = opendir(folder);
     if (!dir) return false;
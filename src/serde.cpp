@@ -201,6 +201,7 @@ void Serde::write_type(void* val, int type) {
         WRITE(12, open_last_folder, SERDE_BOOL);
         WRITE(13, vim_use_clipboard, SERDE_BOOL);
         WRITE(14, format_with_gofumpt, SERDE_BOOL);
+        WRITE(15, index_memory_budget_mb, SERDE_INT);
         write_int(0);
         break;
     }
@@ -286,6 +287,7 @@ bool Serde::read_type_field(void* out, int type, int field_id) {
         FIELD(12, open_last_folder, SERDE_BOOL);
         FIELD(13, vim_use_clipboard, SERDE_BOOL);
         FIELD(14, format_with_gofumpt, SERDE_BOOL);
+        FIELD(15, index_memory_budget_mb, SERDE_INT);
         }
         break;
     }
@@ -46,6 +46,7 @@ struct Options {
     serde_bool open_last_folder = true; // serde(12)
     serde_bool vim_use_clipboard = false; // serde(13)
     serde_bool format_with_gofumpt = false; // serde(14)
+    serde_int index_memory_budget_mb = 2048; // serde(15)
 };
 
 struct Build_Profile {
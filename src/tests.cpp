@@ -10,6 +10,7 @@
 #include "diff.hpp"
 #include "defer.hpp"
 #include "mtwist_shim.hpp"
+#include "fzy_match.h"
 
 void test_mark_tree() {
     Buffer buf;
@@ -350,6 +351,542 @@ void test_bytecounts() {
     }
 }
 
+void test_convert_path() {
+    Module_Resolver r;
+    ptr0(&r);
+    r.mem.init("test_convert_path");
+    defer { r.mem.cleanup(); };
+
+    SCOPED_MEM(&r.mem);
+    r.root_import_to_resolved = new_object(Module_Resolver::Trie_Node);
+    r.root_resolved_to_import = new_object(Module_Resolver::Trie_Node);
+
+    r.add_path("github.com/foo/bar", "/gopath/pkg/mod/github.com/foo/bar@v1.2.3");
+    r.add_path("github.com/foo/bar/v2", "/elsewhere/v2");
+    r.add_path("example.com/mod", "/src/mod");
+
+    auto check = [&](Module_Resolver::Trie_Node *root, ccstr path, ccstr want) {
+        auto got = r.convert_path(root, path, '/');
+        if (!want ? !got : (got && streq(got, want))) return;
+
+        print("convert_path(%s): got %s, want %s", path, got ? got : "NULL", want ? want : "NULL");
+        cp_assert(false);
+    };
+
+    auto imp = r.root_import_to_resolved;
+    auto res = r.root_resolved_to_import;
+
+    check(imp, "github.com/foo/bar", "/gopath/pkg/mod/github.com/foo/bar@v1.2.3");
+    check(imp, "github.com/foo/bar/baz/qux", "/gopath/pkg/mod/github.com/foo/bar@v1.2.3/baz/qux");
+
+    // separators at the end don't make it through
+    check(imp, "github.com/foo/bar/", "/gopath/pkg/mod/github.com/foo/bar@v1.2.3");
+    check(imp, "github.com/foo/bar/baz//", "/gopath/pkg/mod/github.com/foo/bar@v1.2.3/baz");
+
+    // the match is case-insensitive, the rest keeps its case
+    check(imp, "GitHub.com/Foo/Bar/Baz", "/gopath/pkg/mod/github.com/foo/bar@v1.2.3/Baz");
+
+    // longest match wins
+    check(imp, "github.com/foo/bar/v2", "/elsewhere/v2");
+    check(imp, "github.com/foo/bar/v2/x", "/elsewhere/v2/x");
+
+    // only whole parts match
+    check(imp, "github.com/foo/barbaz", NULL);
+    check(imp, "github.com/foo", NULL);
+    check(imp, "other.com/x", NULL);
+
+    check(res, "/src/mod/pkg/sub", "example.com/mod/pkg/sub");
+    check(res, "/src/mod", "example.com/mod");
+    check(res, "/src/module", NULL);
+}
+
+void test_index_stream_pos() {
+    auto path = path_join(world.configdir, "test_index_stream_pos");
+    defer { delete_file(path); };
+
+    cur2 positions[] = {
+        new_cur2(0, 0),
+        new_cur2(17, 3),
+        new_cur2((1 << 11) - 1, (1 << 20) - 1),
+        // these don't fit and need the escape
+        new_cur2(1 << 11, 0),
+        new_cur2(0, 1 << 20),
+        new_cur2(-1, -1),
+    };
+
+    Index_Stream s;
+    cp_assert(s.open(path, true));
+    for (auto &&it : positions)
+        cp_assert(s.writepos(it));
+
+    // the three that fit are 4 bytes each, the rest are 12
+    cp_assert(s.offset == 3 * 4 + 3 * 12);
+    s.finish_writing();
+    s.cleanup();
+
+    cp_assert(s.open(path));
+    defer { s.cleanup(); };
+
+    for (auto &&it : positions) {
+        auto pos = s.readpos();
+        cp_assert(s.ok);
+        if (pos != it) {
+            print("readpos: got %s, want %s", pos.str(), it.str());
+            cp_assert(false);
+        }
+    }
+}
+
+void test_gotype_handles() {
+    auto path = path_join(world.configdir, "test_gotype_handles");
+    defer { delete_file(path); };
+
+    Pool mem;
+    mem.init("test_gotype_handles");
+    defer { mem.cleanup(); };
+    SCOPED_MEM(&mem);
+
+    auto new_ptr_type = [&](ccstr name, cur2 pos) {
+        auto base = new_primitive_type(name);
+        base->id_pos = pos;
+        auto ret = new_gotype(GOTYPE_POINTER);
+        ret->pointer_base = base;
+        return ret;
+    };
+
+    // a and b are the same all the way down, c isn't
+    auto a = new_ptr_type("int", new_cur2(3, 4));
+    auto b = new_ptr_type("int", new_cur2(3, 4));
+    auto c = new_ptr_type("int", new_cur2(5, 4));
+
+    auto with_handles = [&](Index_Stream *s, fn<void()> f) {
+        Gotype_Handles handles;
+        handles.init();
+        defer { handles.cleanup(); };
+
+        s->gotype_handles = &handles;
+        defer { s->gotype_handles = NULL; };
+        f();
+    };
+
+    Index_Stream s;
+    cp_assert(s.open(path, true));
+
+    // each file gets its own handles, so the second one has to define
+    // everything again
+    i64 file_offsets[2];
+    for (int i = 0; i < 2; i++) {
+        file_offsets[i] = s.offset;
+        with_handles(&s, [&]() {
+            write_object<Gotype>(a, &s);
+            write_object<Gotype>(b, &s);
+            write_object<Gotype>(c, &s);
+            write_object<Gotype>(a, &s);
+            write_object<Gotype>(NULL, &s);
+        });
+    }
+    cp_assert(s.offset - file_offsets[1] == file_offsets[1] - file_offsets[0]);
+    s.finish_writing();
+    s.cleanup();
+
+    cp_assert(s.open(path));
+    defer { s.cleanup(); };
+
+    Gotype *files[2][5];
+    for (int i = 0; i < 2; i++) {
+        with_handles(&s, [&]() {
+            for (int j = 0; j < 5; j++) {
+                files[i][j] = read_object<Gotype>(&s);
+                cp_assert(s.ok);
+            }
+        });
+    }
+
+    for (int i = 0; i < 2; i++) {
+        auto f = files[i];
+        cp_assert(f[0] && f[0] == f[1] && f[0] == f[3]);
+        cp_assert(f[2] && f[2] != f[0]);
+        cp_assert(!f[4]);
+
+        cp_assert(f[0]->type == GOTYPE_POINTER);
+        cp_assert(f[0]->pointer_base->type == GOTYPE_ID);
+        cp_assert(streq(f[0]->pointer_base->id_name, "int"));
+        cp_assert(f[0]->pointer_base->id_pos == new_cur2(3, 4));
+        cp_assert(f[2]->pointer_base->id_pos == new_cur2(5, 4));
+    }
+
+    // nothing's shared between files
+    cp_assert(files[0][0] != files[1][0]);
+    cp_assert(files[0][0]->pointer_base != files[1][0]->pointer_base);
+}
+
+void test_symbol_masks() {
+    cp_assert(!symbol_char_mask(""));
+    cp_assert(symbol_char_mask("FooBar") == symbol_char_mask("foobar"));
+    cp_assert(symbol_char_mask("a.b") == (symbol_char_mask("ab") | symbol_char_mask(".")));
+    cp_assert(symbol_char_mask("-") == symbol_char_mask("/"));
+    cp_assert(symbol_char_mask("a") != symbol_char_mask("b"));
+    cp_assert(symbol_char_mask("1") != symbol_char_mask("_"));
+
+    mt_seed32(0);
+
+    ccstr chars = "abcxyzABCXYZ0129_.-/";
+    auto nchars = strlen(chars);
+
+    auto random_string = [&](int maxlen) {
+        auto len = 1 + mt_lrand() % maxlen;
+        auto ret = new_array(char, len + 1);
+        for (u32 i = 0; i < len; i++)
+            ret[i] = chars[mt_lrand() % nchars];
+        ret[len] = '\0';
+        return (ccstr)ret;
+    };
+
+    Pool mem;
+    mem.init("test_symbol_masks");
+    defer { mem.cleanup(); };
+    SCOPED_MEM(&mem);
+
+    // not a multiple of the block size, so the last block is partial
+    auto symbols = new_list(Go_Symbol_Entry);
+    for (int i = 0; i < GOTO_SYMBOL_BLOCK_SIZE * 3 + 17; i++) {
+        auto sym = symbols->append();
+        sym->name = random_string(12);
+        sym->mask = symbol_char_mask(sym->name);
+    }
+
+    auto blocks = symbol_block_masks(symbols);
+    cp_assert(blocks->len == 4);
+    Fori (symbols)
+        cp_assert(!(it.mask & ~blocks->at(i / GOTO_SYMBOL_BLOCK_SIZE)));
+
+    // the masks are only a filter, anything fzy matches has to get through
+    for (int q = 0; q < 2000; q++) {
+        auto query = random_string(4);
+        auto query_mask = symbol_char_mask(query);
+
+        Fori (symbols) {
+            if (!fzy_has_match(query, it.name)) continue;
+
+            if (query_mask & ~it.mask) {
+                print("symbol mask rejected %s for query %s", it.name, query);
+                cp_assert(false);
+            }
+            cp_assert(!(query_mask & ~blocks->at(i / GOTO_SYMBOL_BLOCK_SIZE)));
+        }
+    }
+}
+
+void test_decl_table() {
+    Pool mem;
+    mem.init("test_decl_table");
+    defer { mem.cleanup(); };
+    SCOPED_MEM(&mem);
+
+    auto files = new_list(Go_File);
+    for (int i = 0; i < 3; i++) {
+        auto file = files->append();
+        file->filename = cp_sprintf("file%d.go", i);
+        file->decls = new_list(Godecl);
+    }
+    files->append()->filename = "nodecls.go";
+
+    auto add_decl = [&](int file, ccstr name) {
+        auto decl = files->at(file).decls->append();
+        decl->type = GODECL_TYPE;
+        decl->name = name;
+        decl->is_toplevel = true;
+        return decl;
+    };
+
+    // enough that some of them collide
+    int n = 300;
+    for (int i = 0; i < n; i++)
+        add_decl(i % 3, cp_sprintf("Decl%d", i));
+
+    auto first = add_decl(1, "Dup");
+    add_decl(2, "Dup");
+    add_decl(0, NULL);
+
+    auto method = add_decl(2, "Method");
+    method->type = GODECL_FUNC;
+    method->gotype = new_gotype(GOTYPE_FUNC);
+    method->gotype->func_recv = new_primitive_type("Recv");
+
+    Go_Package pkg; ptr0(&pkg);
+    pkg.files = files;
+    pkg.decl_table = new_decl_table(files);
+
+    auto cap = pkg.decl_table->len;
+    cp_assert(cap >= (n + 1) * 2);
+    cp_assert(!(cap & (cap - 1)));
+
+    auto find = [&](ccstr name, ccstr *filename) {
+        *filename = NULL;
+        auto ret = pkg.find_decl(name, filename);
+        cp_assert(!!ret == pkg.has_decl(name));
+        return ret;
+    };
+
+    ccstr filename;
+    for (int i = 0; i < n; i++) {
+        auto name = cp_sprintf("Decl%d", i);
+        auto decl = find(name, &filename);
+        cp_assert(decl && streq(decl->name, name));
+        cp_assert(streq(filename, cp_sprintf("file%d.go", i % 3)));
+    }
+
+    // first one wins
+    cp_assert(find("Dup", &filename) == first);
+    cp_assert(streq(filename, "file1.go"));
+
+    // methods don't go in
+    cp_assert(!find("Method", &filename));
+
+    cp_assert(!find("Decl", &filename));
+    cp_assert(!find("Decl300", &filename));
+    cp_assert(!find("", &filename));
+
+    // nothing to look up still gives a usable table
+    auto empty = new_list(Go_File);
+    pkg.files = empty;
+    pkg.decl_table = new_decl_table(empty);
+    cp_assert(pkg.decl_table->len == 2);
+    cp_assert(!find("Decl0", &filename));
+}
+
+void test_package_queue() {
+    Pool mem;
+    mem.init("test_package_queue");
+    defer { mem.cleanup(); };
+    SCOPED_MEM(&mem);
+
+    auto expect_pops = [&](Package_Queue *q, ccstr want) {
+        auto got = new_list(char);
+        for (ccstr it; (it = q->pop());)
+            got->concat((char*)it, strlen(it));
+        got->append('\0');
+
+        if (!streq(got->items, want)) {
+            print("package queue: popped %s, want %s", got->items, want);
+            cp_assert(false);
+        }
+        cp_assert(!q->len);
+    };
+
+    Package_Queue q;
+
+    // higher priority first, LIFO within one, and a second push is ignored
+    q.init();
+    q.push("a", PKGPRI_OTHER);
+    q.push("b", PKGPRI_OTHER);
+    q.push("c", PKGPRI_OTHER);
+    q.push("d", PKGPRI_WORKSPACE);
+    q.push("e", PKGPRI_CURRENT_EDITOR);
+    q.push("a", PKGPRI_CURRENT_EDITOR);
+    cp_assert(q.len == 5);
+    expect_pops(&q, "edcba");
+    cp_assert(!q.has("a"));
+
+    // rerank moves things between buckets and keeps the order inside them
+    q.push("a", PKGPRI_OTHER);
+    q.push("b", PKGPRI_OTHER);
+    q.push("c", PKGPRI_WORKSPACE);
+    q.push("d", PKGPRI_OTHER);
+    q.push("e", PKGPRI_OTHER);
+    q.rerank([&](ccstr it) {
+        if (streq(it, "b") || streq(it, "d")) return PKGPRI_OPEN_EDITOR;
+        if (streq(it, "c")) return PKGPRI_OTHER;
+        return PKGPRI_WORKSPACE;
+    });
+    cp_assert(q.len == 5);
+    for (auto it : {"a", "b", "c", "d", "e"})
+        cp_assert(q.has(it));
+    expect_pops(&q, "dbeac");
+
+    q.rerank([&](ccstr) { return PKGPRI_CURRENT_EDITOR; });
+    cp_assert(!q.pop());
+
+    q.push("a", PKGPRI_WORKSPACE);
+    q.push("b", PKGPRI_CURRENT_EDITOR);
+    q.clear();
+    cp_assert(!q.len && !q.has("a") && !q.has("b"));
+    cp_assert(!q.pop());
+}
+
+void test_index_append() {
+    auto path = path_join(world.configdir, "test_index_append.cpdb");
+    auto tmp_path = path_join(world.configdir, "test_index_append.cpdb.tmp");
+    defer {
+        delete_file(path);
+        delete_file(tmp_path);
+    };
+
+    Pool mem;
+    mem.init("test_index_append");
+    defer { mem.cleanup(); };
+    SCOPED_MEM(&mem);
+
+    auto new_files = [&](ccstr decl_name) {
+        auto files = new_list(Go_File);
+        auto file = files->append();
+        file->filename = "a.go";
+        file->scope_ops = new_list(Go_Scope_Op);
+        file->decls = new_list(Godecl);
+        file->imports = new_list(Go_Import);
+        file->references = new_list(Go_Reference);
+        file->reference_postings = new_list(Go_Reference_Posting);
+
+        auto decl = file->decls->append();
+        decl->type = GODECL_TYPE;
+        decl->name = decl_name;
+        decl->is_toplevel = true;
+        return files;
+    };
+
+    const int NUM_PACKAGES = 3;
+
+    auto index = new_object(Go_Index);
+    index->workspace = new_object(Go_Workspace);
+    index->workspace->modules = new_list(Go_Work_Module);
+    index->packages = new_list(Go_Package);
+    for (int i = 0; i < NUM_PACKAGES; i++) {
+        auto pkg = index->packages->append();
+        pkg->import_path = cp_sprintf("example.com/p%d", i);
+        pkg->package_name = cp_sprintf("p%d", i);
+        pkg->status = GPS_READY;
+        pkg->files = new_files(cp_sprintf("T%d", i));
+    }
+
+    // what package i's decl should be called
+    ccstr want_names[NUM_PACKAGES];
+    for (int i = 0; i < NUM_PACKAGES; i++)
+        want_names[i] = cp_sprintf("T%d", i);
+
+    // what we last read, which the next write appends to or copies from
+    Index_Stream source; ptr0(&source);
+    Go_Atom_Map source_atoms; source_atoms.init();
+    bool source_open = false;
+
+    defer {
+        if (source_open) source.cleanup();
+        source_atoms.cleanup();
+    };
+
+    auto free_lazy_files = [&](Go_Index *idx) {
+        For (idx->packages)
+            if (it.lazy_files)
+                cp_free(it.lazy_files);
+    };
+
+    auto write = [&](ccstr to, bool append) -> i64 {
+        auto offsets = new_array(i64, index->packages->len);
+        auto lens = new_array(i64, index->packages->len);
+
+        Go_Atom_Map atom_map;
+        atom_map.init();
+        defer { atom_map.cleanup(); };
+
+        // files copied over from source keep its ids
+        if (source_open) atom_map.copy_from(&source_atoms);
+
+        Index_Stream s;
+        cp_assert(s.open(to, true, append));
+        defer { s.cleanup(); };
+        s.atom_map = &atom_map;
+
+        cp_assert(s.write_index(index, source_open ? &source : NULL, offsets, lens));
+        return s.live_bytes;
+    };
+
+    // reads path back in as the new source and checks it has what we wrote
+    auto read = [&](ccstr from) {
+        if (source_open) {
+            source.cleanup();
+            free_lazy_files(index);
+        }
+        source_atoms.cleanup();
+        source_atoms.init();
+
+        cp_assert(source.open(from));
+        source_open = true;
+        source.atom_map = &source_atoms;
+
+        index = source.read_index();
+        cp_assert(source.ok && index);
+        cp_assert(index->packages->len == NUM_PACKAGES);
+
+        Fori (index->packages) {
+            cp_assert(streq(it.import_path, cp_sprintf("example.com/p%d", i)));
+            cp_assert(!it.files && it.lazy_files);
+            cp_assert(it.disk_offset >= GO_INDEX_HEADER_SIZE && it.disk_len > 0);
+
+            source.offset = it.disk_offset;
+            auto files = read_list<Go_File>(&source);
+            cp_assert(source.ok && files && files->len == 1);
+            cp_assert(source.offset == it.disk_offset + it.disk_len);
+
+            auto &file = files->at(0);
+            cp_assert(streq(file.filename, "a.go"));
+            cp_assert(file.decls && file.decls->len == 1);
+            if (!streq(file.decls->at(0).name, want_names[i])) {
+                print("package %d: got %s, want %s", i, file.decls->at(0).name, want_names[i]);
+                cp_assert(false);
+            }
+        }
+    };
+
+    // a fresh file is all live
+    auto live_bytes = write(path, false);
+    read(path);
+    cp_assert(source.fm->len == live_bytes);
+    cp_assert(source.live_bytes == live_bytes);
+
+    // change one package over and over, appending each time, until there's
+    // enough dead space that it's time to compact
+    int appends = 0;
+    while (!index_file_needs_compaction(source.fm->len, source.live_bytes)) {
+        cp_assert(appends < 100);
+
+        auto old_len = source.fm->len;
+        i64 old_offsets[NUM_PACKAGES];
+        Fori (index->packages) old_offsets[i] = it.disk_offset;
+
+        auto name = cp_sprintf("T1_%d", appends);
+        auto pkg = &index->packages->at(1);
+        pkg->files = new_files(name);
+        pkg->disk_offset = 0;
+        pkg->disk_len = 0;
+        want_names[1] = name;
+
+        live_bytes = write(path, true);
+        read(path);
+        appends++;
+
+        cp_assert(source.fm->len > old_len);
+        cp_assert(source.live_bytes == live_bytes);
+        cp_assert(source.live_bytes < source.fm->len);
+
+        // the packages that didn't change stay where they were, the one that
+        // did goes on the end
+        cp_assert(index->packages->at(0).disk_offset == old_offsets[0]);
+        cp_assert(index->packages->at(2).disk_offset == old_offsets[2]);
+        cp_assert(index->packages->at(1).disk_offset >= old_len);
+    }
+    cp_assert(appends > 0);
+
+    // the rewrite copies every package's files over from the appended file
+    auto appended_len = source.fm->len;
+    live_bytes = write(tmp_path, false);
+    read(tmp_path);
+
+    cp_assert(source.fm->len == live_bytes);
+    cp_assert(source.fm->len < appended_len);
+    cp_assert(!index_file_needs_compaction(source.fm->len, source.live_bytes));
+
+    free_lazy_files(index);
+}
+
 void run_tests(ccstr test_name) {
     bool is_all = streq(test_name, "all");
 
@@ -361,4 +898,11 @@ void run_tests(ccstr test_name) {
     if (is_test("mtf")) test_mark_tree_fuzz();
     if (is_test("mtf_replay")) test_mark_tree_fuzz_replay();
     if (is_test("bytecounts")) test_bytecounts();
+    if (is_test("convert_path")) test_convert_path();
+    if (is_test("index_stream_pos")) test_index_stream_pos();
+    if (is_test("gotype_handles")) test_gotype_handles();
+    if (is_test("symbol_masks")) test_symbol_masks();
+    if (is_test("decl_table")) test_decl_table();
+    if (is_test("package_queue")) test_package_queue();
+    if (is_test("index_append")) test_index_append();
 }
@@ -20,6 +20,7 @@
 #include "enums.hpp"
 #include "tree_sitter_crap.hpp"
 #include "binaries.h"
+#include "copy.hpp"
 
 namespace im = ImGui;
 
@@ -2609,6 +2610,7 @@ void UI::draw_everything() {
 
             menu_command(CMD_RESCAN_INDEX);
             menu_command(CMD_OBLITERATE_AND_RECREATE_INDEX);
+            im::MenuItem("Index metrics", NULL, &world.wnd_index_metrics.show);
             im::Separator();
             menu_command(CMD_OPTIONS);
 
@@ -2976,6 +2978,14 @@ void UI::draw_everything() {
                     im_small_newline();
                     im::Checkbox("Add a `(` after autocompleting a func type", &tmp.autocomplete_func_add_paren);
 
+                    im_small_newline();
+                    im::Text("Index memory budget (MB)");
+                    im::SameLine();
+                    help_marker("When the index takes up more than this, dependencies you haven't looked at in a while are dropped from memory and read back in from disk when needed. 0 means no limit.");
+                    im::InputInt("###index_memory_budget_mb", &tmp.index_memory_budget_mb);
+                    if (tmp.index_memory_budget_mb < 0)
+                        tmp.index_memory_budget_mb = 0;
+
                     // im_small_newline();
                 }
                 im_pop_font();
@@ -3069,7 +3079,13 @@ void UI::draw_everything() {
         if (recvname)
             name = cp_sprintf("%s.%s", recvname, name);
 
+        // caller hierarchy nodes don't have their children until opened
+        auto callers = world.wnd_caller_hierarchy.callers;
+
         auto has_children = [&]() {
+            if (!it->children)
+                return it->callers_key && callers && callers->table.get(it->callers_key);
+
             For (it->children)
                 if (!should_hide(&it))
                     return true;
@@ -3092,8 +3108,24 @@ void UI::draw_everything() {
         }
 
         if (open) {
-            For (it->children)
-                render_call_hier(&it, workspace, show_tests_benches);
+            if (!it->children && it->callers_key && callers) {
+                auto &ind = world.indexer;
+                if (ind.try_acquire_lock(IND_READING)) {
+                    defer { ind.release_lock(IND_READING); };
+
+                    auto children = ind.list_callers(callers, it->callers_key);
+
+                    SCOPED_MEM(&world.caller_hierarchy_mem);
+                    it->children = copy_call_hierarchy(children);
+                }
+            }
+
+            if (it->children) {
+                For (it->children)
+                    render_call_hier(&it, workspace, show_tests_benches);
+            } else {
+                im::TextDisabled("Loading...");
+            }
             im::TreePop();
         }
     };
@@ -3139,6 +3171,8 @@ void UI::draw_everything() {
         );
 
         if (wnd.done) {
+            if (wnd.callers && wnd.callers->incomplete)
+                im::TextWrapped("Still indexing calls in some packages, so this might be missing callers. Run it again in a bit.");
             im::Checkbox("Show tests, examples, and benchmarks", &wnd.show_tests_benches);
             For (wnd.results) render_call_hier(&it, wnd.workspace, wnd.show_tests_benches);
         } else {
@@ -3788,6 +3822,7 @@ void UI::draw_everything() {
 
     if (world.wnd_index_log.show) {
         auto &wnd = world.wnd_index_log;
+        auto &index_log = world.index_log;
 
         im::SetNextWindowDockID(dock_bottom_id, ImGuiCond_Once);
         begin_window("Index Log", &wnd, 0, false, true);
@@ -3795,13 +3830,13 @@ void UI::draw_everything() {
         im_push_mono_font();
 
         ImGuiListClipper clipper;
-        clipper.Begin(wnd.len);
+        clipper.Begin(index_log.len);
         while (clipper.Step())
             for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
-                im::Text("%s", wnd.buf[(wnd.start + i) % INDEX_LOG_CAP]);
+                im::Text("%s", index_log.buf[(index_log.start + i) % INDEX_LOG_CAP]);
 
-        if (wnd.cmd_scroll_to_end) {
-            wnd.cmd_scroll_to_end = false;
+        if (index_log.cmd_scroll_to_end) {
+            index_log.cmd_scroll_to_end = false;
             if (im::GetScrollY() >= im::GetScrollMaxY())
                 im::SetScrollHereY(1.0f);
         }
@@ -3812,6 +3847,157 @@ void UI::draw_everything() {
         fstlog("wnd_index_log");
     }
 
+    if (world.wnd_index_metrics.show) {
+        auto &wnd = world.wnd_index_metrics;
+        auto &metrics = world.indexer.metrics;
+
+        im::SetNextWindowDockID(dock_bottom_id, ImGuiCond_Once);
+        begin_window("Index Metrics", &wnd);
+
+        if (im::Button("Copy JSON")) {
+            SCOPED_FRAME();
+            world.window->set_clipboard_string(metrics.to_json());
+        }
+
+        im::SameLine();
+
+        if (im::Button("Save JSON")) {
+            SCOPED_FRAME();
+            auto path = path_join(world.configdir, "index_metrics.json");
+            if (write_file(path, metrics.to_json()))
+                tell_user(cp_sprintf("Wrote index metrics to %s.", path), "Index Metrics");
+            else
+                tell_user_error(cp_sprintf("Unable to write index metrics to %s.", path));
+        }
+
+        // the background thread only holds this long enough to add a number
+        SCOPED_LOCK(&metrics.lock);
+
+        int flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit;
+
+        auto ms = [&](u64 nanos) { return nanos / 1000000.0; };
+
+        im::Text(
+            "%llu packages (%llu from shared cache), %.0fms total",
+            metrics.packages,
+            metrics.packages_from_shared_cache,
+            ms(metrics.package_nanos)
+        );
+
+        if (im::BeginTable("phases", 5, flags)) {
+            im::TableSetupColumn("phase");
+            im::TableSetupColumn("count");
+            im::TableSetupColumn("total (ms)");
+            im::TableSetupColumn("avg (ms)");
+            im::TableSetupColumn("max (ms)");
+            im::TableHeadersRow();
+
+            for (int i = 0; i < _IPHASE_COUNT_; i++) {
+                auto &it = metrics.phases[i];
+
+                im::TableNextRow();
+                im::TableSetColumnIndex(0);
+                im::Text("%s", index_phase_str((Index_Phase)i));
+                im::TableSetColumnIndex(1);
+                im::Text("%llu", it.count);
+                im::TableSetColumnIndex(2);
+                im::Text("%.1f", ms(it.total_nanos));
+                im::TableSetColumnIndex(3);
+                im::Text("%.2f", it.count ? ms(it.total_nanos) / it.count : 0.0);
+                im::TableSetColumnIndex(4);
+                im::Text("%.1f", ms(it.max_nanos));
+            }
+
+            im::EndTable();
+        }
+
+        im::Text(
+            "start_writing(): held %llu times, %llums total, %llums max, %llums last",
+            metrics.writing_count,
+            metrics.writing_total_milli,
+            metrics.writing_max_milli,
+            metrics.writing_last_milli
+        );
+
+        im::Text(
+            "Eval cache: %llu hits, %llu misses, %llu stale",
+            metrics.eval_cache_hits,
+            metrics.eval_cache_misses,
+            metrics.eval_cache_stale
+        );
+
+        if (metrics.queue_len > 0) {
+            SCOPED_FRAME();
+
+            auto queued = new_array(float, metrics.queue_len);
+            auto in_flight = new_array(float, metrics.queue_len);
+            for (int i = 0; i < metrics.queue_len; i++) {
+                auto it = metrics.get_queue_sample(i);
+                queued[i] = it->queued;
+                in_flight[i] = it->in_flight;
+            }
+
+            auto last = metrics.get_queue_sample(metrics.queue_len - 1);
+            auto width = im::GetContentRegionAvail().x;
+
+            im::PlotLines("##queued", queued, metrics.queue_len, 0, cp_sprintf("queued: %d", last->queued), 0, FLT_MAX, ImVec2(width, 60));
+            im::PlotLines("##in_flight", in_flight, metrics.queue_len, 0, cp_sprintf("in flight: %d", last->in_flight), 0, FLT_MAX, ImVec2(width, 60));
+        }
+
+        if (im::BeginTable("pools", 2, flags)) {
+            im::TableSetupColumn("pool");
+            im::TableSetupColumn("MB");
+            im::TableHeadersRow();
+
+            for (int i = 0; i < metrics.num_pools; i++) {
+                auto &it = metrics.pools[i];
+
+                im::TableNextRow();
+                im::TableSetColumnIndex(0);
+                im::Text("%s", it.name);
+                im::TableSetColumnIndex(1);
+                im::Text("%.1f", it.bytes / 1024.0 / 1024.0);
+            }
+
+            im::EndTable();
+        }
+
+        if (metrics.num_slowest > 0) {
+            im::Text("Slowest packages:");
+
+            if (im::BeginTable("slowest", 2 + _IPHASE_COUNT_ - 1, flags)) {
+                im::TableSetupColumn("package");
+                im::TableSetupColumn("total (ms)");
+                for (int i = 0; i < _IPHASE_COUNT_; i++)
+                    if (i != IPHASE_WRITE)
+                        im::TableSetupColumn(index_phase_str((Index_Phase)i));
+                im::TableHeadersRow();
+
+                for (int i = 0; i < metrics.num_slowest; i++) {
+                    auto &it = metrics.slowest[i];
+
+                    im::TableNextRow();
+                    im::TableSetColumnIndex(0);
+                    im::Text("%s", it.import_path);
+                    im::TableSetColumnIndex(1);
+                    im::Text("%.1f", ms(it.nanos));
+
+                    int col = 2;
+                    for (int j = 0; j < _IPHASE_COUNT_; j++) {
+                        if (j == IPHASE_WRITE) continue;
+                        im::TableSetColumnIndex(col++);
+                        im::Text("%.1f", ms(it.phase_nanos[j]));
+                    }
+                }
+
+                im::EndTable();
+            }
+        }
+
+        im::End();
+        fstlog("wnd_index_metrics");
+    }
+
     if (world.wnd_debug_output.show) {
         auto &wnd = world.wnd_debug_output;
 
@@ -5299,8 +5485,8 @@ void UI::draw_everything() {
             begin_centered_window("Go To Symbol###goto_symbol_filling", &wnd, 0, 650);
             im::Text("Waiting for indexer to become ready.");
             im::End();
-            if (world.indexer.status == IND_READY)
-                init_goto_symbol();
+            // readers only get turned away until there's a snapshot
+            init_goto_symbol();
             break;
 
         case GOTO_SYMBOL_READY: {
@@ -5348,15 +5534,12 @@ void UI::draw_everything() {
                 do {
                     if (!wnd.filtered_results->len) break;
 
-                    if (!world.indexer.try_acquire_lock(IND_READING)) break;
-                    defer { world.indexer.release_lock(IND_READING); };
-
                     auto it = wnd.symbols->at(wnd.filtered_results->at(wnd.selection));
 
                     Jump_To_Definition_Result res;
-                    res.file = world.indexer.ctx_to_filepath(it.decl->ctx);
-                    res.pos = it.decl->decl->name_start;
-                    res.decl = it.decl;
+                    res.file = path_join(it.package_path, it.filename);
+                    res.pos = it.name_start;
+                    res.decl = NULL;
                     goto_jump_to_definition_result(&res);
 
                     wnd.filtered_results->len = 0;
@@ -5382,15 +5565,34 @@ void UI::draw_everything() {
                         break;
                 }
 
+                ccstr editor_filename = NULL, editor_dir = NULL;
+                if (editor) {
+                    editor_filename = cp_basename(editor->filepath);
+                    editor_dir = cp_dirname(editor->filepath);
+                }
+
                 Timer t;
                 t.init("filter_symbols");
 
+                // see symbol_char_mask()
+                auto query_mask = symbol_char_mask(wnd.query);
+
                 for (u32 i = 0, k = 0; i < wnd.symbols->len && k < 10000; i++) {
+                    if (i % GOTO_SYMBOL_BLOCK_SIZE == 0) {
+                        auto block_mask = wnd.block_masks->at(i / GOTO_SYMBOL_BLOCK_SIZE);
+                        if (query_mask & ~block_mask) {
+                            i += GOTO_SYMBOL_BLOCK_SIZE - 1;
+                            continue;
+                        }
+                    }
+
                     auto &it = wnd.symbols->at(i);
+                    if (query_mask & ~it.mask) continue;
 
-                    if (wnd.current_file_only)
-                        if (!are_filepaths_equal(it.filepath, editor->filepath))
-                            continue;
+                    if (wnd.current_file_only) {
+                        if (!streq(it.filename, editor_filename)) continue;
+                        if (!are_filepaths_equal(it.package_path, editor_dir)) continue;
+                    }
 
                     if (!fzy_has_match(wnd.query, it.full_name()))
                         continue;
@@ -5425,7 +5627,7 @@ void UI::draw_everything() {
                     auto it = wnd.symbols->at(wnd.filtered_results->at(i));
 
                     auto get_decl_type = [&]() {
-                        auto decl_type = it.decl->decl->type;
+                        auto decl_type = it.decl_type;
                         switch (decl_type) {
                         case GODECL_IMPORT: return "import";
                         case GODECL_VAR: return "var";
@@ -5442,7 +5644,7 @@ void UI::draw_everything() {
                     pretty_menu_text(pm, it.full_name());
                     pm->pos.x += 8;
 
-                    auto label = get_import_path_label(it.decl->ctx->import_path, wnd.workspace);
+                    auto label = get_import_path_label(it.import_path, wnd.workspace);
 
                     int rem_chars = (pm->text_br.x - pm->pos.x) / base_font->width;
 
@@ -6085,7 +6287,8 @@ void UI::draw_everything() {
                             ind.reload_all_editors(true);
 
                             auto ctx = ind.filepath_to_ctx(editor->filepath);
-                            auto gofile = ind.find_gofile_from_ctx(ctx);
+                            Go_Package *pkg = NULL;
+                            auto gofile = ind.find_gofile_from_ctx(ctx, &pkg);
                             if (!gofile) break;
 
                             wnd.pool.cleanup();
@@ -6095,6 +6298,13 @@ void UI::draw_everything() {
                                 SCOPED_MEM(&wnd.pool);
                                 wnd.gofile = gofile->copy();
                                 wnd.filepath = cp_strdup(editor->filepath);
+
+                                // dependencies don't keep them around
+                                if (!wnd.gofile->scope_ops) {
+                                    wnd.gofile->scope_ops = copy_list(ind.get_scope_ops(pkg, gofile));
+                                    if (!wnd.gofile->scope_ops)
+                                        wnd.gofile->scope_ops = new_list(Go_Scope_Op);
+                                }
                             }
                         } while (0);
                     }
@@ -7869,6 +8079,12 @@ void UI::draw_everything() {
         }
         }
 
+        // queries just ran against what was indexed before the last edits
+        if (world.indexer.editor_reload_skipped) {
+            auto flags = draw_status_piece(RIGHT, "EDITS NOT INDEXED", rgba(global_colors.status_index_indexing_background, 0.8), rgba(global_colors.status_index_indexing_foreground, 0.8));
+            index_mouse_flags |= flags;
+        }
+
         if (index_mouse_flags & MOUSE_CLICKED) {
             world.wnd_index_log.show ^= 1;
         }
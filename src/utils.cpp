@@ -1,6 +1,6 @@
 #include "utils.hpp"
 #include "os.hpp"
-#include "world.hpp"
+#include "core.hpp"
 #include <stb/stb_sprintf.h>
 #include "defer.hpp"
 
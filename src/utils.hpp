@@ -455,11 +455,15 @@ template<typename T>
 struct Message_Queue {
     Pool mem;
     Lock lock;
+    Cond cond;
     List<T> messages;
+    bool woken;
 
     void init() {
         mem.init("message_queue_mem");
         lock.init();
+        cond.init();
+        woken = false;
         {
             SCOPED_MEM(&mem);
             messages.init();
@@ -494,6 +498,7 @@ struct Message_Queue {
             T msg; ptr0(&msg);
             f(&msg);
             messages.append(&msg);
+            cond.signal();
 
             lock.leave();
         }
@@ -507,6 +512,37 @@ struct Message_Queue {
             f(&msg);
             messages.append(&msg);
         }
+        cond.signal();
+    }
+
+    // Wakes up wait() without adding a message, for when the consumer has
+    // something else to look at.
+    void wake() {
+        SCOPED_LOCK(&lock);
+        woken = true;
+        cond.signal();
+    }
+
+    // Blocks until a message is added, wake() is called, or timeout_milli
+    // passes (0 means wait forever). Returns false on timeout.
+    bool wait(u32 timeout_milli = 0) {
+        SCOPED_LOCK(&lock);
+
+        auto deadline = current_time_milli() + timeout_milli;
+        while (!messages.len && !woken) {
+            if (!timeout_milli) {
+                cond.wait(&lock);
+                continue;
+            }
+
+            auto now = current_time_milli();
+            if (now >= deadline) break;
+            cond.wait(&lock, deadline - now);
+        }
+
+        bool ret = (messages.len > 0 || woken);
+        woken = false;
+        return ret;
     }
 };
 
@@ -7,10 +7,9 @@
 #include "jblow_tests.hpp"
 
 World world = {0};
+World_Core &core = world;
 
 u64 post_insert_dotrepeat_time = 0;
-int gargc = 0;
-char **gargv = NULL;
 
 bool is_ignored_by_git(ccstr path) {
     // go-gitignore crashes when path == base path
@@ -239,6 +238,8 @@ bool exclude_from_file_tree(ccstr path) {
     if (streq(filename, ".cpproj")) return true;
     if (streq(filename, ".cpdb")) return true;
     if (streq(filename, ".cpdb.tmp")) return true;
+    if (streq(filename, ".cpdb.build")) return true;
+    if (streq(filename, ".cpdb.build.tmp")) return true;
     if (str_ends_with(filename, ".exe")) return true;
 
     return false;
@@ -364,62 +365,22 @@ void World::init() {
     init_mem(project_settings_mem);
     init_mem(fst_mem);
     init_mem(search_marks_mem);
-    init_mem(workspace_mem_1);
-    init_mem(workspace_mem_2);
 #undef init_mem
 
     t.log("init mem");
 
     MEM = &frame_mem;
 
-    init_treesitter_go_trie();
-
-    global_mark_tree_lock.init();
     build_lock.init();
 
-    mark_fridge.init(512);
-    avl_node_fridge.init(512);
-    change_fridge.init(512);
-    treap_fridge.init(512);
-
-    chunk0_fridge.init(512);
-    chunk1_fridge.init(256);
-    chunk2_fridge.init(128);
-    chunk3_fridge.init(64);
-    chunk4_fridge.init(32);
-    chunk5_fridge.init(16);
-    chunk6_fridge.init(8);
-    chunk7_fridge.init(8);
-
-    t.log("init random shit");
-
-    {
-        auto tmp = GHGetConfigDir();
-        if (!tmp) cp_panic("couldn't get config dir");
-        defer { GHFree(tmp); };
-
-        cp_strcpy_fixed(configdir, tmp);
-    }
+    init_core();
 
-    t.log("get config dir");
-
-    {
-        auto go_binary_path = GHGetGoBinaryPath();
-        if (!go_binary_path) {
-            cp_exit("Unable to find a go binary.\n\nUsually, CodePerfect searches for go by running `which go` inside `bash`, but we did that and couldn't find anything.\n\nPlease visit docs.codeperfect95.com to see how to manually tell CodePerfect where go is.");
-        }
-
-        defer { GHFree(go_binary_path); };
-        cp_strcpy_fixed(world.go_binary_path, go_binary_path);
-    }
-
-    t.log("get go binary path");
+    t.log("init core");
 
     {
         // do we need world_mem anywhere else?
         // i assume we will have other things that "orchestrate" world
         SCOPED_MEM(&world_mem);
-        message_queue.init();
         last_closed = new_list(Last_Closed);
         konami = new_list(int);
     }
@@ -752,11 +713,15 @@ void activate_pane_by_index(u32 idx) {
         pane->width = new_width;
     }
 
-    if (world.current_pane != idx)
+    bool switching = (world.current_pane != idx);
+    if (switching)
         reset_everything_when_switching_editors(get_current_editor());
 
     world.current_pane = idx;
     world.cmd_unfocus_all_windows = true;
+
+    if (switching)
+        world.indexer.editors_changed();
 }
 
 void init_goto_file() {
@@ -1405,6 +1370,8 @@ bool handle_unsaved_files() {
 
 
 void rename_identifier_thread(void *param) {
+    world.indexer.adopt_read_lock((Index_Snapshot*)param);
+
     auto &wnd = world.wnd_rename_identifier;
     wnd.thread_mem.cleanup();
     wnd.thread_mem.init("rename_identifier_thread");
@@ -1500,8 +1467,10 @@ void kick_off_rename_identifier() {
     auto &wnd = world.wnd_rename_identifier;
     wnd.running = true;
     wnd.too_late_to_cancel = false;
-    wnd.thread = create_thread(rename_identifier_thread, NULL);
+    wnd.holding_read_lock = true;
+    wnd.thread = create_thread(rename_identifier_thread, ind.hand_off_read_lock());
     if (!wnd.thread) {
+        wnd.holding_read_lock = false;
         tell_user_error("Unable to kick off Rename Identifier.");
         return;
     }
@@ -1518,9 +1487,10 @@ void cancel_find_interfaces() {
         wnd.thread = NULL;
     }
 
-    // assume it was acquired by find_interfaces
-    if (world.indexer.status == IND_READING)
+    if (wnd.holding_read_lock) {
+        wnd.holding_read_lock = false;
         world.indexer.release_lock(IND_READING);
+    }
 
     wnd.done = true;
 }
@@ -1534,9 +1504,10 @@ void cancel_find_references() {
         wnd.thread = NULL;
     }
 
-    // assume it was acquired by find_references
-    if (world.indexer.status == IND_READING)
+    if (wnd.holding_read_lock) {
+        wnd.holding_read_lock = false;
         world.indexer.release_lock(IND_READING);
+    }
 
     wnd.done = true;
 }
@@ -1550,9 +1521,10 @@ void cancel_caller_hierarchy() {
         wnd.thread = NULL;
     }
 
-    // assume it was acquired by find_implementations
-    if (world.indexer.status == IND_READING)
+    if (wnd.holding_read_lock) {
+        wnd.holding_read_lock = false;
         world.indexer.release_lock(IND_READING);
+    }
 
     wnd.done = true;
 }
@@ -1566,9 +1538,10 @@ void cancel_callee_hierarchy() {
         wnd.thread = NULL;
     }
 
-    // assume it was acquired by find_implementations
-    if (world.indexer.status == IND_READING)
+    if (wnd.holding_read_lock) {
+        wnd.holding_read_lock = false;
         world.indexer.release_lock(IND_READING);
+    }
 
     wnd.done = true;
 }
@@ -1582,9 +1555,10 @@ void cancel_find_implementations() {
         wnd.thread = NULL;
     }
 
-    // assume it was acquired by find_implementations
-    if (world.indexer.status == IND_READING)
+    if (wnd.holding_read_lock) {
+        wnd.holding_read_lock = false;
         world.indexer.release_lock(IND_READING);
+    }
 
     wnd.done = true;
 }
@@ -1598,9 +1572,10 @@ void cancel_rename_identifier() {
         wnd.thread = NULL;
     }
 
-    // assume it was acquired by rename_identifier
-    if (world.indexer.status == IND_READING)
+    if (wnd.holding_read_lock) {
+        wnd.holding_read_lock = false;
         world.indexer.release_lock(IND_READING);
+    }
 
     wnd.running = false;
 }
@@ -1786,7 +1761,7 @@ bool is_command_enabled(Command cmd) {
     }
 
     case CMD_RESCAN_INDEX:
-        return world.indexer.status == IND_READY;
+        return world.indexer.status != IND_WRITING;
 
     case CMD_START_DEBUGGING:
         return world.dbg.mt_state.state_flag == DLV_STATE_INACTIVE;
@@ -2070,6 +2045,8 @@ void do_find_interfaces() {
     ind.reload_all_editors();
 
     auto thread_proc = [](void *param) {
+        world.indexer.adopt_read_lock((Index_Snapshot*)param);
+
         auto &wnd = world.wnd_find_interfaces;
         wnd.thread_mem.cleanup();
         wnd.thread_mem.init("find_interfaces_thread");
@@ -2089,7 +2066,7 @@ void do_find_interfaces() {
             For (results) newresults->append(it.copy());
 
             wnd.results = newresults;
-            wnd.workspace = ind.index.workspace->copy();
+            wnd.workspace = ind.get_index()->workspace->copy();
         }
 
         // close the thread handle first so it doesn't try to kill the thread
@@ -2106,8 +2083,11 @@ void do_find_interfaces() {
     wnd.done = false;
     wnd.results = NULL;
 
-    wnd.thread = create_thread(thread_proc, NULL);
+    wnd.holding_read_lock = true;
+    wnd.thread = create_thread(thread_proc, ind.hand_off_read_lock());
     if (!wnd.thread) {
+        wnd.holding_read_lock = false;
+        ind.release_lock(IND_READING);
         tell_user_error("Unable to kick off Find Interfaces.");
         return;
     }
@@ -2128,28 +2108,34 @@ void init_goto_symbol() {
 
     wnd.query[0] = '\0';
     wnd.symbols = NULL;
+    wnd.block_masks = NULL;
     wnd.filtered_results = NULL;
 
     world.indexer.reload_all_editors();
 
-    auto worker = [](void*) {
+    auto worker = [](void *param) {
+        world.indexer.adopt_read_lock((Index_Snapshot*)param);
         defer { world.indexer.release_lock(IND_READING); };
 
         auto &wnd = world.wnd_goto_symbol;
 
         SCOPED_MEM(&wnd.fill_thread_pool);
 
-        auto symbols = new_list(Go_Symbol);
+        auto symbols = new_list(Go_Symbol_Entry);
         world.indexer.fill_goto_symbol(symbols);
         if (!symbols->len) return;
 
         {
             SCOPED_MEM(&world.goto_symbol_mem);
-            wnd.symbols = new_list(Go_Symbol, symbols->len);
-            For (symbols) wnd.symbols->append(it.copy());
+
+            // the strings are all interned, so no need to copy them
+            wnd.symbols = new_list(Go_Symbol_Entry, symbols->len);
+            wnd.symbols->concat(symbols);
+
+            wnd.block_masks = symbol_block_masks(wnd.symbols);
 
             wnd.filtered_results = new_list(int);
-            wnd.workspace = world.indexer.index.workspace->copy();
+            wnd.workspace = world.indexer.get_index()->workspace->copy();
         }
 
         wnd.state = GOTO_SYMBOL_READY;
@@ -2164,7 +2150,7 @@ void init_goto_symbol() {
     wnd.fill_thread_pool.init("goto_symbol_thread");
 
     wnd.fill_time_started_ms = current_time_milli();
-    wnd.fill_thread = create_thread(worker, NULL);
+    wnd.fill_thread = create_thread(worker, world.indexer.hand_off_read_lock());
 
     if (!wnd.fill_thread) {
         world.indexer.release_lock(IND_READING);
@@ -2186,6 +2172,8 @@ void do_find_implementations() {
     ind.reload_all_editors();
 
     auto thread_proc = [](void *param) {
+        world.indexer.adopt_read_lock((Index_Snapshot*)param);
+
         auto &wnd = world.wnd_find_implementations;
         wnd.thread_mem.cleanup();
         wnd.thread_mem.init("find_implementations_thread");
@@ -2204,7 +2192,7 @@ void do_find_implementations() {
             For (results) newresults->append(it.copy());
 
             wnd.results = newresults;
-            wnd.workspace = ind.index.workspace->copy();
+            wnd.workspace = ind.get_index()->workspace->copy();
         }
 
         // close the thread handle first so it doesn't try to kill the thread
@@ -2221,8 +2209,11 @@ void do_find_implementations() {
     wnd.done = false;
     wnd.results = NULL;
 
-    wnd.thread = create_thread(thread_proc, NULL);
+    wnd.holding_read_lock = true;
+    wnd.thread = create_thread(thread_proc, ind.hand_off_read_lock());
     if (!wnd.thread) {
+        wnd.holding_read_lock = false;
+        ind.release_lock(IND_READING);
         tell_user_error("Unable to kick off Find Implementations.");
         return;
     }
@@ -2276,6 +2267,8 @@ void initiate_find_references(cur2 pos) {
     ind.reload_all_editors();
 
     auto thread_proc = [](void *param) {
+        world.indexer.adopt_read_lock((Index_Snapshot*)param);
+
         auto &wnd = world.wnd_find_references;
         wnd.thread_mem.cleanup();
         wnd.thread_mem.init("find_references_thread");
@@ -2297,7 +2290,7 @@ void initiate_find_references(cur2 pos) {
             For (files) newfiles->append(it.copy());
 
             wnd.results = newfiles;
-            wnd.workspace = world.indexer.index.workspace->copy();
+            wnd.workspace = world.indexer.get_index()->workspace->copy();
         }
 
         // close the thread handle first so it doesn't try to kill the thread
@@ -2313,14 +2306,18 @@ void initiate_find_references(cur2 pos) {
         wnd.show = true;
     wnd.done = false;
     wnd.results = NULL;
-    wnd.thread = create_thread(thread_proc, NULL);
     wnd.current_file = -1;
     wnd.current_result = -1;
     wnd.scroll_to_file = -1;
     wnd.scroll_to_result = -1;
+    wnd.holding_read_lock = true;
+    wnd.thread = create_thread(thread_proc, ind.hand_off_read_lock());
 
-    if (!wnd.thread)
+    if (!wnd.thread) {
+        wnd.holding_read_lock = false;
+        ind.release_lock(IND_READING);
         tell_user_error("Unable to kick off Find References.");
+    }
 }
 
 void handle_command(Command cmd, bool from_menu) {
@@ -3071,6 +3068,14 @@ void handle_command(Command cmd, bool from_menu) {
         auto worker = [](void*) {
             auto &wnd = world.wnd_generate_implementation;
 
+            // the read lock taken below is released once this gets kicked
+            // off, so take our own
+            if (!world.indexer.acquire_lock(IND_READING, true)) {
+                wnd.fill_running = false;
+                return;
+            }
+            defer { world.indexer.release_lock(IND_READING); };
+
             SCOPED_MEM(&wnd.fill_thread_pool);
 
             auto symbols = new_list(Go_Symbol);
@@ -3111,7 +3116,7 @@ void handle_command(Command cmd, bool from_menu) {
         }
 
         bool ok = false;
-        defer { if (!ok && ind.status == IND_READING) ind.release_lock(IND_READING); };
+        defer { if (!ok) ind.release_lock(IND_READING); };
 
         auto editor = get_current_editor();
         if (!editor) break;
@@ -3141,6 +3146,8 @@ void handle_command(Command cmd, bool from_menu) {
         }
 
         auto thread_proc = [](void *param) {
+            world.indexer.adopt_read_lock((Index_Snapshot*)param);
+
             auto &wnd = world.wnd_callee_hierarchy;
             wnd.thread_mem.cleanup();
             wnd.thread_mem.init("view_callee_hierarchy_thread");
@@ -3154,11 +3161,8 @@ void handle_command(Command cmd, bool from_menu) {
             {
                 SCOPED_MEM(&world.callee_hierarchy_mem);
 
-                auto newresults = new_list(Call_Hier_Node, results->len);
-                For (results) newresults->append(it.copy());
-
-                wnd.results = newresults;
-                wnd.workspace = ind.index.workspace->copy();
+                wnd.results = copy_call_hierarchy(results);
+                wnd.workspace = ind.get_index()->workspace->copy();
             }
 
             // close the thread handle first so it doesn't try to kill the thread
@@ -3175,11 +3179,15 @@ void handle_command(Command cmd, bool from_menu) {
         wnd.done = false;
         wnd.results = NULL;
 
-        wnd.thread = create_thread(thread_proc, NULL);
+        wnd.holding_read_lock = true;
+        wnd.thread = create_thread(thread_proc, ind.hand_off_read_lock());
         if (!wnd.thread) {
+            wnd.holding_read_lock = false;
             tell_user_error("Unable to kick off View Call Hierarchy.");
             break;
         }
+
+        ok = true;
         break;
     }
 
@@ -3193,7 +3201,7 @@ void handle_command(Command cmd, bool from_menu) {
         }
 
         bool ok = false;
-        defer { if (!ok && ind.status == IND_READING) ind.release_lock(IND_READING); };
+        defer { if (!ok) ind.release_lock(IND_READING); };
 
         auto editor = get_current_editor();
         if (!editor) break;
@@ -3223,6 +3231,8 @@ void handle_command(Command cmd, bool from_menu) {
         }
 
         auto thread_proc = [](void *param) {
+            world.indexer.adopt_read_lock((Index_Snapshot*)param);
+
             auto &wnd = world.wnd_caller_hierarchy;
             wnd.thread_mem.cleanup();
             wnd.thread_mem.init("view_caller_hierarchy_thread");
@@ -3230,17 +3240,16 @@ void handle_command(Command cmd, bool from_menu) {
 
             defer { cancel_caller_hierarchy(); };
 
-            auto results = ind.generate_caller_hierarchy(wnd.declres);
+            Caller_Map *callers = NULL;
+            auto results = ind.generate_caller_hierarchy(wnd.declres, &callers);
             if (!results) return;
 
             {
                 SCOPED_MEM(&world.caller_hierarchy_mem);
 
-                auto newresults = new_list(Call_Hier_Node, results->len);
-                For (results) newresults->append(it.copy());
-
-                wnd.results = newresults;
-                wnd.workspace = ind.index.workspace->copy();
+                wnd.results = copy_call_hierarchy(results);
+                wnd.callers = callers->copy();
+                wnd.workspace = ind.get_index()->workspace->copy();
             }
 
             // close the thread handle first so it doesn't try to kill the thread
@@ -3256,9 +3265,12 @@ void handle_command(Command cmd, bool from_menu) {
             wnd.show = true;
         wnd.done = false;
         wnd.results = NULL;
+        wnd.callers = NULL;
 
-        wnd.thread = create_thread(thread_proc, NULL);
+        wnd.holding_read_lock = true;
+        wnd.thread = create_thread(thread_proc, ind.hand_off_read_lock());
         if (!wnd.thread) {
+            wnd.holding_read_lock = false;
             tell_user_error("Unable to kick off View Call Hierarchy.");
             break;
         }
@@ -3,6 +3,7 @@
 #include <math.h>
 #include "glcrap.hpp"
 #include "common.hpp"
+#include "core.hpp"
 #include "editor.hpp"
 #include "ui.hpp"
 #include "os.hpp"
@@ -48,49 +49,6 @@ struct FT_Node {
     FT_Node *next;
 };
 
-enum Main_Thread_Message_Type {
-    MTM_GOTO_FILEPOS,
-    /**/
-    MTM_FILETREE_DELETE,
-    MTM_FILETREE_CREATE,
-    /**/
-    MTM_TELL_USER,
-    /**/
-    MTM_RELOAD_EDITOR,
-    MTM_EXIT,
-    MTM_FOCUS_APP_DEBUGGER,
-    /**/
-    MTM_WRITE_LAST_FOLDER,
-    /**/
-    // for tests
-    MTM_TEST_MOVE_CURSOR,
-    MTM_RESET_AFTER_DEFOCUS,
-};
-
-struct Main_Thread_Message {
-    Main_Thread_Message_Type type;
-
-    union {
-        int focus_app_debugger_pid;
-        u32 reload_editor_id;
-        struct {
-            ccstr goto_file;
-            cur2 goto_pos;
-        };
-        struct {
-            ccstr tell_user_text;
-            ccstr tell_user_title;
-        };
-        struct {
-            ccstr exit_message;
-            int exit_code;
-        };
-        ccstr debugger_stdout_line;
-        cur2 test_move_cursor;
-        List<Mark*> *search_marks;
-    };
-};
-
 struct History_Loc {
     int editor_id;
     cur2 pos;
@@ -151,9 +109,6 @@ struct Build {
     void cleanup();
 };
 
-#define INDEX_LOG_CAP 64 // 512
-#define INDEX_LOG_MAXLEN 256
-
 /*
 enum {
     DISCARD_UNSAVED = 0,
@@ -330,7 +285,7 @@ struct Search_Marks_File {
     List<Mark*> *mark_ends;
 };
 
-struct World {
+struct World : World_Core {
     Pool world_mem;
     Pool frame_mem;
     Pool autocomplete_mem;
@@ -355,25 +310,6 @@ struct World {
     Pool fst_mem;
     Pool search_marks_mem;
 
-    Pool workspace_mem_1;
-    Pool workspace_mem_2;
-    bool which_workspace_mem;
-
-    Fridge<Mark> mark_fridge;
-    Fridge<Avl_Node> avl_node_fridge;
-    Fridge<Treap> treap_fridge;
-    Fridge<Change> change_fridge;
-    Fridge<Chunk0> chunk0_fridge;
-    Fridge<Chunk1> chunk1_fridge;
-    Fridge<Chunk2> chunk2_fridge;
-    Fridge<Chunk3> chunk3_fridge;
-    Fridge<Chunk4> chunk4_fridge;
-    Fridge<Chunk5> chunk5_fridge;
-    Fridge<Chunk6> chunk6_fridge;
-    Fridge<Chunk7> chunk7_fridge;
-
-    char configdir[MAX_PATH];
-
     bool time_type_char;
     bool test_running;
     char test_name[256];
@@ -388,8 +324,6 @@ struct World {
         u64 ms_over;
     };
 
-    Go_Workspace *workspace;
-
     List<Frameskip> frameskips;
 
     char gh_version[16];
@@ -426,14 +360,11 @@ struct World {
 
     bool dont_push_history;
 
-    Message_Queue<Main_Thread_Message> message_queue;
     Searcher searcher;
 
     List<Search_Marks_File> *search_marks;
     int search_marks_state_id;
 
-    Go_Indexer indexer;
-
     struct {
         // is vim enabled
         bool on;
@@ -494,9 +425,6 @@ struct World {
 
     u64 next_build_id;
 
-    char go_binary_path[MAX_PATH];
-    char current_path[MAX_PATH];
-
     // lol this was back before we had dynamic arrays and world_mem
     Pane _panes[MAX_PANES];
     List<Pane> panes;
@@ -508,7 +436,6 @@ struct World {
 
     bool darkmode;
 
-    Lock global_mark_tree_lock;
     Lock build_lock;
 
     bool flag_defocus_imgui;
@@ -571,6 +498,7 @@ struct World {
         char rename_to[256];
         Goresult *declres;
         Thread_Handle thread;
+        bool holding_read_lock;
     } wnd_rename_identifier;
 
 // #ifdef DEBUG_BUILD
@@ -605,6 +533,7 @@ struct World {
         bool done;
         Goresult *declres;
         Thread_Handle thread;
+        bool holding_read_lock;
         List<Find_References_File> *results;
         Go_Workspace *workspace;
         int current_file;
@@ -621,6 +550,7 @@ struct World {
         bool done;
         Goresult *declres;
         Thread_Handle thread;
+        bool holding_read_lock;
         bool include_empty;
         List<Find_Decl*> *results;
         Go_Workspace *workspace;
@@ -634,6 +564,7 @@ struct World {
         bool done;
         Goresult *declres;
         Thread_Handle thread;
+        bool holding_read_lock;
         List<Find_Decl*> *results;
         Go_Workspace *workspace;
         int selection;
@@ -648,7 +579,9 @@ struct World {
         // kill, etc logic? like we're now repeating it for find references,
         // find interfaces, find implementations, call hierarchy, etc...
         Thread_Handle thread;
+        bool holding_read_lock;
         List<Call_Hier_Node> *results;
+        Caller_Map *callers; // for expanding results
         Go_Workspace *workspace;
         bool show_tests_benches;
     } wnd_caller_hierarchy;
@@ -658,18 +591,18 @@ struct World {
         bool done;
         Goresult *declres;
         Thread_Handle thread;
+        bool holding_read_lock;
         List<Call_Hier_Node> *results;
         Go_Workspace *workspace;
     } wnd_callee_hierarchy;
 
+    // the log itself is core.index_log
     struct Wnd_Index_Log : Wnd {
-        // ring buffer
-        char buf[INDEX_LOG_CAP][INDEX_LOG_MAXLEN];
-        int start;
-        int len;
-        bool cmd_scroll_to_end;
     } wnd_index_log;
 
+    struct Wnd_Index_Metrics : Wnd {
+    } wnd_index_metrics;
+
     struct Wnd_Mouse_Pos : Wnd {
     } wnd_mouse_pos;
 
@@ -823,7 +756,8 @@ struct World {
         Go_Workspace *workspace;
         bool current_file_only;
         u32 selection;
-        List<Go_Symbol> *symbols;
+        List<Go_Symbol_Entry> *symbols;
+        List<u64> *block_masks; // symbol masks ORed together, GOTO_SYMBOL_BLOCK_SIZE at a time
         List<int> *filtered_results;
     } wnd_goto_symbol;
 
@@ -856,10 +790,8 @@ void activate_pane(Pane *pane);
 void activate_pane_by_index(u32 idx);
 
 Pane* get_current_pane();
-Editor* get_current_editor();
 Editor* find_editor(find_editor_func f);
 Editor* find_editor_by_id(u32 id);
-Editor* find_editor_by_filepath(ccstr filepath); // this is fairly expensive -- it does a stat lookup, not just string based comparison
 void fill_file_tree();
 
 Editor *focus_editor(ccstr path);
@@ -908,9 +840,6 @@ extern u64 post_insert_dotrepeat_time;
 bool move_autocomplete_cursor(Editor *editor, int direction);
 Jump_To_Definition_Result *get_current_definition(ccstr *filepath = NULL, bool display_error = false, cur2 pos = {-1, -1});
 
-extern int gargc;
-extern char **gargv;
-
 ccstr get_command_name(Command action);
 bool is_command_enabled(Command action);
 void init_command_info_table();
@@ -933,7 +862,6 @@ void recalc_display_size();
 
 void set_zoom_level(int level);
 
-List<Editor*> *get_all_editors();
 void reset_everything_when_switching_editors(Editor *old_editor);
 
 void open_current_file_search(bool replace, bool from_vim);